@@ -0,0 +1,357 @@
+/*
+ * Benchmark harness for the Chip 8 core
+ * Runs a fixed set of synthetic microbenchmarks (one per opcode class) plus any roms given on the command line
+ * headless and uncapped, then writes ns/instruction and instructions per second for each as JSON so runs can be
+ * compared over time (make bench)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "chip_8_core.h"
+#include "chip_8_jit.h"
+
+/*
+ * synthetic_rom struct
+ * Expects: N/A
+ * Does: A tiny rom that loops forever over mostly one class of opcode
+ */
+typedef struct synthetic_rom {
+    const char *name;
+    const u8 *data;
+    size_t size;
+    chip8_mode mode;
+} synthetic_rom;
+
+// Arithmetic and logic: 7XNN and the 8XY_ family in a tight loop
+static const u8 alu_rom[] = {
+    0x60, 0x00,     // 200: V0 = 0
+    0x61, 0x03,     // 202: V1 = 3
+    0x70, 0x01,     // 204: V0 += 1
+    0x80, 0x14,     // 206: V0 += V1
+    0x82, 0x03,     // 208: V2 ^= V0
+    0x83, 0x21,     // 20A: V3 |= V2
+    0x84, 0x32,     // 20C: V4 &= V3
+    0x85, 0x05,     // 20E: V5 -= V0
+    0x86, 0x06,     // 210: V6 >>= 1
+    0x87, 0x27,     // 212: V7 = V2 - V7
+    0x88, 0x0E,     // 214: V8 <<= 1
+    0x89, 0x20,     // 216: V9 = V2
+    0x12, 0x04      // 218: jump 204
+};
+
+// Sprite drawing: a font glyph walked across the screen, wrapping at the edges
+static const u8 draw_rom[] = {
+    0xA0, 0x50,     // 200: I = font 0
+    0x60, 0x00,     // 202: V0 = 0
+    0x61, 0x00,     // 204: V1 = 0
+    0xD0, 0x15,     // 206: draw 8x5 at V0, V1
+    0x70, 0x05,     // 208: V0 += 5
+    0x71, 0x03,     // 20A: V1 += 3
+    0x12, 0x06      // 20C: jump 206
+};
+
+// Subroutines: call, a little work, return, loop
+static const u8 call_rom[] = {
+    0x22, 0x06,     // 200: call 206
+    0x12, 0x00,     // 202: jump 200
+    0x00, 0x00,     // 204: unused
+    0x22, 0x0C,     // 206: call 20C
+    0x00, 0xEE,     // 208: return
+    0x00, 0x00,     // 20A: unused
+    0x70, 0x01,     // 20C: V0 += 1
+    0x00, 0xEE      // 20E: return
+};
+
+// Memory: BCD, register store and load through I (I is reset every pass as the memory quirk moves it)
+static const u8 memory_rom[] = {
+    0xA3, 0x00,     // 200: I = 300
+    0xF2, 0x33,     // 202: BCD of V2 at I
+    0xF3, 0x55,     // 204: store V0 - V3 at I
+    0xF3, 0x65,     // 206: load V0 - V3 from I
+    0x72, 0x07,     // 208: V2 += 7
+    0x12, 0x00      // 20A: jump 200
+};
+
+// Branches: every kind of register and immediate skip
+static const u8 branch_rom[] = {
+    0x60, 0x00,     // 200: V0 = 0
+    0x70, 0x01,     // 202: V0 += 1
+    0x30, 0x80,     // 204: skip if V0 == 80
+    0x40, 0x00,     // 206: skip if V0 != 0
+    0x61, 0x01,     // 208: V1 = 1
+    0x50, 0x10,     // 20A: skip if V0 == V1
+    0x90, 0x10,     // 20C: skip if V0 != V1
+    0x62, 0x02,     // 20E: V2 = 2
+    0x12, 0x02      // 210: jump 202
+};
+
+// Hires: XO-CHIP 16x16 sprites on both planes of the 128x64 display plus every scroll
+static const u8 hires_rom[] = {
+    0x00, 0xFF,     // 200: hires
+    0xF3, 0x01,     // 202: draw to both planes
+    0xA0, 0xA0,     // 204: I = big font 0
+    0x60, 0x00,     // 206: V0 = 0
+    0x61, 0x00,     // 208: V1 = 0
+    0xD0, 0x10,     // 20A: draw 16x16 at V0, V1
+    0x70, 0x07,     // 20C: V0 += 7
+    0x71, 0x05,     // 20E: V1 += 5
+    0x00, 0xC1,     // 210: scroll down 1
+    0x00, 0xFB,     // 212: scroll right 4
+    0x00, 0xFC,     // 214: scroll left 4
+    0x00, 0xD1,     // 216: scroll up 1
+    0x12, 0x0A      // 218: jump 20A
+};
+
+static const synthetic_rom synthetic_roms[] = {
+    { "alu", alu_rom, sizeof(alu_rom), CHIP8_MODE_CHIP8 },
+    { "draw", draw_rom, sizeof(draw_rom), CHIP8_MODE_CHIP8 },
+    { "call", call_rom, sizeof(call_rom), CHIP8_MODE_CHIP8 },
+    { "memory", memory_rom, sizeof(memory_rom), CHIP8_MODE_CHIP8 },
+    { "branch", branch_rom, sizeof(branch_rom), CHIP8_MODE_CHIP8 },
+    { "hires", hires_rom, sizeof(hires_rom), CHIP8_MODE_XOCHIP },
+};
+#define SYNTHETIC_ROM_COUNT (int)(sizeof(synthetic_roms) / sizeof(synthetic_roms[0]))
+
+/*
+ * bench_result struct
+ * Expects: N/A
+ * Does: The best of several timed runs of one rom on one engine
+ */
+typedef struct bench_result {
+    uint64_t executed;
+    double seconds;
+} bench_result;
+
+/*
+ * seconds_since function
+ * Expects: start to have been filled by clock_gettime(CLOCK_MONOTONIC)
+ * Does: Returns the seconds elapsed since start
+ *
+ */
+static double seconds_since(const struct timespec *start){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/*
+ * time_rom function
+ * Expects: data to hold a rom image of size bytes, jit to be NULL for the interpreter
+ * Does: Runs the rom from a fresh chip 8 in mode for up to cycles instructions repeats times and keeps the fastest run
+ *
+ */
+static bench_result time_rom(chip_8 *chip_8_object, chip8_jit *jit, const u8 *data, size_t size, chip8_mode mode,
+                             uint64_t cycles, int repeats){
+    bench_result best = { 0, 0.0 };
+    for (int i = 0; i < repeats; i++){
+        chip8_init(chip_8_object);
+        chip8_set_mode(chip_8_object, mode);
+        if (jit){
+            chip8_jit_attach(chip_8_object, jit);
+        }
+        chip8_load_rom_bytes(chip_8_object, data, size);
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        uint64_t executed = chip8_run(chip_8_object, cycles);
+        double seconds = seconds_since(&start);
+
+        if (i == 0 || seconds < best.seconds){
+            best.executed = executed;
+            best.seconds = seconds;
+        }
+    }
+    return best;
+}
+
+/*
+ * engines_for function
+ * Expects: jit to be NULL when only the interpreter is benchmarked
+ * Does: Returns how many engines a rom in mode can be timed on, chip8_run keeps XO-CHIP roms on the interpreter so
+ * they only get the one
+ *
+ */
+static int engines_for(const chip8_jit *jit, chip8_mode mode){
+    return jit && mode != CHIP8_MODE_XOCHIP ? 2 : 1;
+}
+
+/*
+ * read_rom_file function
+ * Expects: path to be a readable file
+ * Does: Reads the whole rom into a malloced buffer, returns NULL (after printing why) if it can't
+ *
+ */
+static u8 *read_rom_file(const char *path, size_t *size){
+    FILE *file = fopen(path, "rb");
+    if (!file){
+        printf("Error: Can't open ROM file %s\n", path);
+        return NULL;
+    }
+    u8 *data = malloc(MEMORY_SIZE - rom_start_address);
+    if (!data){
+        printf("Error: Out of memory reading ROM file %s\n", path);
+        fclose(file);
+        return NULL;
+    }
+    *size = fread(data, 1, MEMORY_SIZE - rom_start_address, file);
+    fclose(file);
+    return data;
+}
+
+/*
+ * write_json_string function
+ * Expects: out to be open for writing
+ * Does: Writes text as a quoted JSON string, escaping quotes, backslashes and control characters
+ *
+ */
+static void write_json_string(FILE *out, const char *text){
+    fputc('"', out);
+    for (const unsigned char *c = (const unsigned char *)text; *c; c++){
+        if (*c == '"' || *c == '\\'){
+            fprintf(out, "\\%c", *c);
+        }
+        else if (*c < 0x20){
+            fprintf(out, "\\u%04x", *c);
+        }
+        else {
+            fputc(*c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+/*
+ * write_result function
+ * Expects: out to be open for writing
+ * Does: Writes one benchmark result as a JSON object
+ *
+ */
+static void write_result(FILE *out, const char *name, const char *kind, const char *engine, chip8_mode mode,
+                         const char *profile, bench_result result, bool last){
+    double ns_per_instruction = result.executed ? result.seconds * 1e9 / result.executed : 0.0;
+    double ips = result.seconds > 0 ? result.executed / result.seconds : 0.0;
+    // Rom names are paths off the command line so they can hold anything
+    fprintf(out, "    {\"name\": ");
+    write_json_string(out, name);
+    fprintf(out, ", \"kind\": \"%s\", \"engine\": \"%s\", \"mode\": \"%s\", \"profile\": \"%s\", "
+                 "\"instructions\": %llu, \"seconds\": %.6f, \"ns_per_instruction\": %.3f, \"ips\": %.0f}%s\n",
+            kind, engine, chip8_mode_name(mode), profile, (unsigned long long)result.executed, result.seconds,
+            ns_per_instruction, ips, last ? "" : ",");
+}
+
+int main(int argc, char *argv[]){
+
+    uint64_t cycles = 20000000;
+    int repeats = 3;
+    const char *output_path = NULL;
+    bool use_jit = false;
+    int first_rom = argc;
+
+    for (int i = 1; i < argc; i++){
+        if (strncmp(argv[i], "--cycles=", 9) == 0){
+            cycles = strtoull(argv[i] + 9, NULL, 10);
+        }
+        else if (strncmp(argv[i], "--repeats=", 10) == 0){
+            repeats = atoi(argv[i] + 10);
+        }
+        else if (strncmp(argv[i], "--output=", 9) == 0){
+            output_path = argv[i] + 9;
+        }
+        else if (strcmp(argv[i], "--jit") == 0){
+            use_jit = true;
+        }
+        else if (strncmp(argv[i], "--profile=", 10) == 0){
+            if (chip8_use_quirk_profile(argv[i] + 10)){
+                return 1;
+            }
+        }
+        else if (argv[i][0] == '-'){
+            printf("Usage: %s [--cycles=int] [--repeats=int] [--output=path] [--jit] [--profile=name] [rom.ch8 ...]\n", argv[0]);
+            return 1;
+        }
+        else {
+            first_rom = i;
+            break;
+        }
+    }
+    if (cycles == 0 || repeats < 1){
+        printf("Error: --cycles and --repeats must be at least 1\n");
+        return 1;
+    }
+
+    // Draws would otherwise stall for the 60hz timer and we'd be timing the wait loop
+    display_wait_quirk = false;
+
+    chip_8 *chip_8_object = malloc(sizeof(chip_8));
+    if (!chip_8_object){
+        printf("Error: Out of memory for the chip 8\n");
+        return 1;
+    }
+    chip8_init(chip_8_object);
+    chip8_jit *jit = use_jit ? chip8_jit_create() : NULL;
+    if (use_jit && !jit){
+        printf("JIT not supported on this host, only benchmarking the interpreter\n");
+    }
+    const char *interpreter = CHIP8_DISPATCH_GOTO ? "goto" : "table";
+
+    FILE *out = output_path ? fopen(output_path, "w") : stdout;
+    if (!out){
+        printf("Error: Can't open %s for writing\n", output_path);
+        free(chip_8_object);
+        chip8_jit_destroy(jit);
+        return 1;
+    }
+
+    // Every result but the last is followed by a comma
+    int total = 0;
+    for (int i = 0; i < SYNTHETIC_ROM_COUNT; i++){
+        total += engines_for(jit, synthetic_roms[i].mode);
+    }
+    for (int i = first_rom; i < argc; i++){
+        total += engines_for(jit, chip8_mode_for_path(argv[i]));
+    }
+    int written = 0;
+
+    fprintf(out, "{\n  \"cycles\": %llu,\n  \"repeats\": %d,\n  \"results\": [\n", (unsigned long long)cycles, repeats);
+
+    // One synthetic rom per opcode class, this is the per class throughput
+    for (int i = 0; i < SYNTHETIC_ROM_COUNT; i++){
+        const synthetic_rom *rom = &synthetic_roms[i];
+        for (int engine = 0; engine < engines_for(jit, rom->mode); engine++){
+            bench_result result = time_rom(chip_8_object, engine ? jit : NULL, rom->data, rom->size, rom->mode,
+                                           cycles, repeats);
+            write_result(out, rom->name, "synthetic", engine ? "jit" : interpreter, rom->mode,
+                         chip8_profile_name(chip_8_object), result, ++written == total);
+        }
+    }
+
+    // Real roms (test suites, games) exactly as given, in the mode their extension says
+    for (int i = first_rom; i < argc; i++){
+        size_t size;
+        u8 *data = read_rom_file(argv[i], &size);
+        chip8_mode mode = chip8_mode_for_path(argv[i]);
+        for (int engine = 0; engine < engines_for(jit, mode); engine++){
+            bench_result result = { 0, 0.0 };
+            if (data){
+                result = time_rom(chip_8_object, engine ? jit : NULL, data, size, mode, cycles, repeats);
+            }
+            write_result(out, argv[i], "rom", engine ? "jit" : interpreter, mode,
+                         chip8_profile_name(chip_8_object), result, ++written == total);
+        }
+        free(data);
+    }
+
+    fprintf(out, "  ]\n}\n");
+
+    if (output_path){
+        fclose(out);
+        printf("Results written to %s\n", output_path);
+    }
+
+    free(chip_8_object);
+    chip8_jit_destroy(jit);
+    return 0;
+
+}
@@ -0,0 +1,768 @@
+#include "chip_8_analysis.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/*
+ * Layout of a C8AN analysis cache file, every multi byte value is big endian
+ *
+ *   0  "C8AN"          4  version          6  mode             7  unused
+ *   8  memory hash    16  rom end         20  block count
+ *  24  flags, 2 bytes for each address of the mode's memory
+ *      then the blocks, each [start (2)][end (2)][taken (2)][fallthrough (2)]
+ *
+ * Files are named after the memory hash so one cache directory serves every rom and mode.
+ */
+enum {
+    ANALYSIS_MAGIC = 0,
+    ANALYSIS_VERSION = 4,
+    ANALYSIS_MODE = 6,
+    ANALYSIS_MEMORY_HASH = 8,
+    ANALYSIS_ROM_END = 16,
+    ANALYSIS_BLOCK_COUNT = 20,
+    ANALYSIS_HEADER_SIZE = 24,
+    ANALYSIS_BLOCK_SIZE = 8
+};
+
+static const u8 analysis_magic[4] = { 'C', '8', 'A', 'N' };
+
+// Longest BNNN jump table followed, one entry per even value of the register
+#define JUMP_TABLE_LENGTH 128
+
+// Opcode names indexed by chip8_opcode
+#define OPCODE_NAME(name, handler) [OPCODE_##name] = #name,
+static const char *const opcode_names[OPCODE_COUNT] = {
+    CHIP8_OPCODE_LIST(OPCODE_NAME)
+};
+#undef OPCODE_NAME
+
+/* Big endian helpers so a cache file moves between hosts unchanged */
+
+static inline void put_u16(u8 *out, u16 value){
+    out[0] = value >> 8;
+    out[1] = value;
+}
+
+static inline void put_u32(u8 *out, uint32_t value){
+    put_u16(out, value >> 16);
+    put_u16(out + 2, value);
+}
+
+static inline void put_u64(u8 *out, u64 value){
+    put_u32(out, value >> 32);
+    put_u32(out + 4, value);
+}
+
+static inline u16 get_u16(const u8 *in){
+    return (in[0] << 8) | in[1];
+}
+
+static inline uint32_t get_u32(const u8 *in){
+    return ((uint32_t)get_u16(in) << 16) | get_u16(in + 2);
+}
+
+static inline u64 get_u64(const u8 *in){
+    return ((u64)get_u32(in) << 32) | get_u32(in + 4);
+}
+
+/*
+ * memory_hash function
+ * Expects: chip_8_object to be initialized
+ * Does: Returns the 64 bit FNV-1a hash of the mode's whole memory, where the rom ends and the mode, which is
+ * everything the analysis is worked out from
+ *
+ */
+static u64 memory_hash(const chip_8 *chip_8_object){
+
+    u64 hash = 0xCBF29CE484222325ull;
+    for (u32 i = 0; i <= chip_8_object->memory_mask; i++){
+        hash = (hash ^ chip_8_object->memory[i]) * 0x100000001B3ull;
+    }
+    for (int shift = 0; shift < 32; shift += 8){
+        hash = (hash ^ ((chip_8_object->rom_end >> shift) & 0xFF)) * 0x100000001B3ull;
+    }
+    return (hash ^ chip_8_object->mode) * 0x100000001B3ull;
+
+}
+
+/*
+ * instruction_length function
+ * Expects: NA
+ * Does: Returns how many bytes the instruction takes, 4 for XO-CHIP's F000 NNNN and 2 for everything else
+ *
+ */
+static inline int instruction_length(const decoded_instruction *decoded){
+    return decoded->opcode == OPCODE_LONG_INDEX ? 4 : 2;
+}
+
+/*
+ * is_skip function
+ * Expects: NA
+ * Does: Returns true for the conditional skips (LONG_SKIP included)
+ *
+ */
+static bool is_skip(u8 opcode){
+    switch (opcode){
+        case OPCODE_SKIP_IF_EQUAL_IMMEDIATE:
+        case OPCODE_SKIP_IF_NOT_EQUAL_IMMEDIATE:
+        case OPCODE_SKIP_IF_EQUAL_REGISTER:
+        case OPCODE_SKIP_IF_NOT_EQUAL_REGISTER:
+        case OPCODE_SKIP_IF_KEY:
+        case OPCODE_SKIP_IF_NOT_KEY:
+        case OPCODE_LONG_SKIP:
+            return true;
+    }
+    return false;
+}
+
+/*
+ * ends_block function
+ * Expects: NA
+ * Does: Returns true for instructions that move the PC anywhere but the next instruction
+ *
+ */
+static bool ends_block(u8 opcode){
+    switch (opcode){
+        case OPCODE_JUMP:
+        case OPCODE_JUMP_OFFSET:
+        case OPCODE_CALL:
+        case OPCODE_RETURN:
+        case OPCODE_EXIT:
+            return true;
+    }
+    return is_skip(opcode);
+}
+
+/*
+ * successors function
+ * Expects: decoded to be the instruction at address ending a block (see ends_block)
+ * Does: Sets where the instruction goes when it jumps, calls or skips and where it falls through to, either
+ * is CHIP8_ANALYSIS_NONE when it can't go there
+ *
+ */
+static void successors(const decoded_instruction *decoded, u16 address, u16 *taken, u16 *fallthrough){
+
+    *taken = CHIP8_ANALYSIS_NONE;
+    *fallthrough = CHIP8_ANALYSIS_NONE;
+    switch (decoded->opcode){
+        case OPCODE_JUMP:
+        case OPCODE_JUMP_OFFSET:
+            *taken = decoded->nnn;
+            break;
+        case OPCODE_CALL:
+            *taken = decoded->nnn;
+            *fallthrough = address + 2;
+            break;
+        case OPCODE_RETURN:
+        case OPCODE_EXIT:
+            break;
+        default:
+            // A LONG_SKIP also jumps the 2 extra bytes of the F000 NNNN after it
+            *taken = address + (decoded->opcode == OPCODE_LONG_SKIP ? 6 : 4);
+            *fallthrough = address + 2;
+            break;
+    }
+
+}
+
+/*
+ * traversal struct
+ * Expects: N/A
+ * Does: Addresses waiting to be disassembled from, each is only ever queued once
+ */
+typedef struct traversal {
+    chip8_analysis *analysis;
+    u16 *queue;
+    u32 queued;
+    u8 *seen;
+} traversal;
+
+/*
+ * add_target helper function - chip8_analyze
+ * Expects: NA
+ * Does: Marks target as a block leader (plus flag) and queues it to be disassembled from if it's inside the rom
+ *
+ */
+static void add_target(traversal *walk, u32 target, u16 flag){
+
+    chip8_analysis *analysis = walk->analysis;
+    if (target < (u32)rom_start_address || target >= analysis->rom_end){
+        return;
+    }
+    analysis->flags[target] |= CHIP8_ANALYSIS_LEADER | flag;
+    if (!walk->seen[target]){
+        walk->seen[target] = 1;
+        walk->queue[walk->queued++] = target;
+    }
+
+}
+
+/*
+ * disassemble_from helper function - chip8_analyze
+ * Expects: address to be inside the rom
+ * Does: Flags every instruction from address on until one leaves the straight line, queueing where it can go
+ *
+ */
+static void disassemble_from(traversal *walk, chip_8 *chip_8_object, u32 address){
+
+    chip8_analysis *analysis = walk->analysis;
+    u32 mask = chip_8_object->memory_mask;
+
+    // Running past the end of the rom stops the program so nothing there is code
+    while (address < analysis->rom_end && !(analysis->flags[address] & CHIP8_ANALYSIS_CODE)){
+
+        const decoded_instruction *decoded = chip8_decode_at(chip_8_object, address);
+        int length = instruction_length(decoded);
+        analysis->flags[address] |= CHIP8_ANALYSIS_CODE;
+        for (int i = 1; i < length; i++){
+            analysis->flags[(address + i) & mask] |= CHIP8_ANALYSIS_OPERAND;
+        }
+
+        if (!ends_block(decoded->opcode)){
+            address += length;
+            continue;
+        }
+
+        u16 taken;
+        u16 fallthrough;
+        successors(decoded, address, &taken, &fallthrough);
+        if (decoded->opcode == OPCODE_JUMP_OFFSET){
+            // Where BNNN lands depends on a register, a run of jumps at NNN is taken to be a table it indexes
+            analysis->flags[address] |= CHIP8_ANALYSIS_INDIRECT;
+            for (int entry = 0; entry < JUMP_TABLE_LENGTH; entry++){
+                u32 target = decoded->nnn + entry * 2;
+                if (target >= analysis->rom_end || chip8_decode_at(chip_8_object, target)->opcode != OPCODE_JUMP){
+                    break;
+                }
+                add_target(walk, target, CHIP8_ANALYSIS_JUMP_TARGET);
+            }
+        }
+        if (taken != CHIP8_ANALYSIS_NONE){
+            u16 flag = 0;
+            if (decoded->opcode == OPCODE_JUMP || decoded->opcode == OPCODE_JUMP_OFFSET){
+                flag = CHIP8_ANALYSIS_JUMP_TARGET;
+            }
+            else if (decoded->opcode == OPCODE_CALL){
+                flag = CHIP8_ANALYSIS_CALL_TARGET;
+            }
+            add_target(walk, taken, flag);
+        }
+        if (fallthrough != CHIP8_ANALYSIS_NONE){
+            add_target(walk, fallthrough, 0);
+        }
+        return;
+    }
+
+}
+
+/*
+ * build_blocks helper function - chip8_analyze
+ * Expects: every reachable instruction and leader to be flagged
+ * Does: Splits the reachable instructions into basic blocks in address order, returns 0 on success else 1
+ *
+ */
+static int build_blocks(chip8_analysis *analysis, chip_8 *chip_8_object){
+
+    u32 count = 0;
+    for (u32 address = 0; address < analysis->rom_end; address++){
+        count += (analysis->flags[address] & (CHIP8_ANALYSIS_CODE | CHIP8_ANALYSIS_LEADER)) ==
+                 (CHIP8_ANALYSIS_CODE | CHIP8_ANALYSIS_LEADER);
+    }
+    analysis->blocks = malloc((count ? count : 1) * sizeof(chip8_basic_block));
+    if (!analysis->blocks){
+        return 1;
+    }
+
+    for (u32 start = 0; start < analysis->rom_end; start++){
+        if ((analysis->flags[start] & (CHIP8_ANALYSIS_CODE | CHIP8_ANALYSIS_LEADER)) !=
+            (CHIP8_ANALYSIS_CODE | CHIP8_ANALYSIS_LEADER)){
+            continue;
+        }
+
+        chip8_basic_block *block = &analysis->blocks[analysis->block_count++];
+        block->start = start;
+        block->taken = CHIP8_ANALYSIS_NONE;
+        block->fallthrough = CHIP8_ANALYSIS_NONE;
+
+        // The walk that flagged these instructions went the same way so it stops in the same place
+        u32 address = start;
+        while (true){
+            const decoded_instruction *decoded = chip8_decode_at(chip_8_object, address);
+            u32 next = address + instruction_length(decoded);
+            if (ends_block(decoded->opcode)){
+                successors(decoded, address, &block->taken, &block->fallthrough);
+                address = next;
+                break;
+            }
+            address = next;
+            if (address >= analysis->rom_end){
+                break;
+            }
+            if (analysis->flags[address] & CHIP8_ANALYSIS_LEADER){
+                block->fallthrough = address;
+                break;
+            }
+        }
+        block->end = address;
+    }
+    return 0;
+
+}
+
+/*
+ * flag_writes helper function - chip8_analyze
+ * Expects: the basic blocks to be built
+ * Does: Follows I through each block from where it's set to flag what FX55, FX33 and 5XY2 write, and whether
+ * that's over code
+ *
+ */
+static void flag_writes(chip8_analysis *analysis, chip_8 *chip_8_object){
+
+    u32 mask = chip_8_object->memory_mask;
+    for (u32 i = 0; i < analysis->block_count; i++){
+        const chip8_basic_block *block = &analysis->blocks[i];
+
+        // Nothing is known about I coming into a block
+        bool known = false;
+        u32 index = 0;
+        for (u32 address = block->start; address < block->end;){
+            const decoded_instruction *decoded = chip8_decode_at(chip_8_object, address);
+
+            int written = 0;
+            switch (decoded->opcode){
+                case OPCODE_SET_INDEX:
+                    known = true;
+                    index = decoded->nnn;
+                    break;
+                case OPCODE_LONG_INDEX:
+                    known = true;
+                    index = (chip_8_object->memory[(address + 2) & mask] << 8) | chip_8_object->memory[(address + 3) & mask];
+                    break;
+                case OPCODE_STORE_REGISTERS:
+                    written = decoded->x + 1;
+                    break;
+                case OPCODE_BCD:
+                    written = 3;
+                    break;
+                case OPCODE_SAVE_RANGE:
+                    written = (decoded->x <= decoded->y ? decoded->y - decoded->x : decoded->x - decoded->y) + 1;
+                    break;
+            }
+
+            if (written && known){
+                for (int byte = 0; byte < written; byte++){
+                    u16 *flags = &analysis->flags[(index + byte) & mask];
+                    *flags |= CHIP8_ANALYSIS_WRITTEN;
+                    if (*flags & (CHIP8_ANALYSIS_CODE | CHIP8_ANALYSIS_OPERAND)){
+                        analysis->flags[address] |= CHIP8_ANALYSIS_SELF_MODIFYING;
+                    }
+                }
+            }
+            else if (written){
+                analysis->flags[address] |= CHIP8_ANALYSIS_UNKNOWN_WRITE;
+            }
+
+            // Whether FX55/FX65 move I is a quirk, so after them (and anything else that moves it) it isn't known
+            switch (decoded->opcode){
+                case OPCODE_ADD_INDEX:
+                case OPCODE_FONT:
+                case OPCODE_BIG_FONT:
+                case OPCODE_STORE_REGISTERS:
+                case OPCODE_LOAD_REGISTERS:
+                    known = false;
+                    break;
+            }
+            address += instruction_length(decoded);
+        }
+    }
+
+}
+
+/*
+ * chip8_analyze function
+ * Expects: chip_8_object to have a rom freshly loaded (nothing run yet)
+ * Does: Disassembles everything reachable from the rom's entry point, builds its control flow graph and flags the
+ * data, written bytes, self modifying writes and idle loop candidates, returns NULL if out of memory
+ *
+ */
+chip8_analysis *chip8_analyze(chip_8 *chip_8_object){
+
+    chip8_analysis *analysis = calloc(1, sizeof(chip8_analysis));
+    traversal walk = { analysis, malloc(MEMORY_SIZE * sizeof(u16)), 0, calloc(MEMORY_SIZE, 1) };
+    if (!analysis || !walk.queue || !walk.seen){
+        free(walk.queue);
+        free(walk.seen);
+        free(analysis);
+        return NULL;
+    }
+    analysis->memory_hash = memory_hash(chip_8_object);
+    analysis->mode = chip_8_object->mode;
+    analysis->rom_end = chip_8_object->rom_end;
+
+    // Recursive traversal from the entry point, every queued address is disassembled until it leaves the
+    // straight line and wherever it can go from there is queued in turn
+    add_target(&walk, rom_start_address, 0);
+    while (walk.queued > 0){
+        disassemble_from(&walk, chip_8_object, walk.queue[--walk.queued]);
+    }
+    free(walk.queue);
+    free(walk.seen);
+
+    // What's left of the rom is only ever read as data (or reached through a computed jump not worked out)
+    for (u32 address = rom_start_address; address < analysis->rom_end; address++){
+        if (!(analysis->flags[address] & (CHIP8_ANALYSIS_CODE | CHIP8_ANALYSIS_OPERAND))){
+            analysis->flags[address] |= CHIP8_ANALYSIS_DATA;
+        }
+    }
+
+    if (build_blocks(analysis, chip_8_object)){
+        chip8_analysis_destroy(analysis);
+        return NULL;
+    }
+    flag_writes(analysis, chip_8_object);
+
+    // Idle loops are flagged everywhere rather than just in the code found, a computed jump can still land on one
+    for (u32 address = 0; address <= chip_8_object->memory_mask; address++){
+        if (chip8_may_idle_at(chip_8_object, address)){
+            analysis->flags[address] |= CHIP8_ANALYSIS_IDLE;
+        }
+    }
+    return analysis;
+
+}
+
+/*
+ * chip8_analysis_destroy function
+ * Expects: analysis to have come from chip8_analyze or chip8_analysis_load (or be NULL) and no chip 8 to have it
+ * attached anymore
+ * Does: Frees the analysis
+ *
+ */
+void chip8_analysis_destroy(chip8_analysis *analysis){
+    if (analysis){
+        free(analysis->blocks);
+        free(analysis);
+    }
+}
+
+/*
+ * memory_size_of helper function - chip8_analysis_save/chip8_analysis_load
+ * Expects: NA
+ * Does: Returns how many addresses the mode has flags for
+ *
+ */
+static u32 memory_size_of(chip8_mode mode){
+    return mode == CHIP8_MODE_XOCHIP ? MEMORY_SIZE : CHIP8_MEMORY_SIZE;
+}
+
+/*
+ * chip8_analysis_save function
+ * Expects: NA
+ * Does: Writes analysis to path (to a file next to it then renamed, so a reader never sees half of one), returns 0
+ * on success else 1 (after printing why)
+ *
+ */
+int chip8_analysis_save(const chip8_analysis *analysis, const char *path){
+
+    u32 addresses = memory_size_of(analysis->mode);
+    size_t size = ANALYSIS_HEADER_SIZE + addresses * 2 + (size_t)analysis->block_count * ANALYSIS_BLOCK_SIZE;
+    u8 *buffer = malloc(size);
+    size_t path_length = strlen(path);
+    char *temporary_path = malloc(path_length + 5);
+    if (!buffer || !temporary_path){
+        printf("Error: Can't write analysis %s\n", path);
+        free(buffer);
+        free(temporary_path);
+        return 1;
+    }
+
+    memcpy(&buffer[ANALYSIS_MAGIC], analysis_magic, sizeof(analysis_magic));
+    put_u16(&buffer[ANALYSIS_VERSION], CHIP8_ANALYSIS_VERSION);
+    buffer[ANALYSIS_MODE] = analysis->mode;
+    buffer[ANALYSIS_MODE + 1] = 0;
+    put_u64(&buffer[ANALYSIS_MEMORY_HASH], analysis->memory_hash);
+    put_u32(&buffer[ANALYSIS_ROM_END], analysis->rom_end);
+    put_u32(&buffer[ANALYSIS_BLOCK_COUNT], analysis->block_count);
+    u8 *out = &buffer[ANALYSIS_HEADER_SIZE];
+    for (u32 i = 0; i < addresses; i++, out += 2){
+        put_u16(out, analysis->flags[i]);
+    }
+    for (u32 i = 0; i < analysis->block_count; i++, out += ANALYSIS_BLOCK_SIZE){
+        const chip8_basic_block *block = &analysis->blocks[i];
+        put_u16(out, block->start);
+        put_u16(out + 2, block->end);
+        put_u16(out + 4, block->taken);
+        put_u16(out + 6, block->fallthrough);
+    }
+
+    memcpy(temporary_path, path, path_length);
+    memcpy(temporary_path + path_length, ".tmp", 5);
+    FILE *file = fopen(temporary_path, "wb");
+    if (!file){
+        printf("Error: Can't write analysis %s\n", temporary_path);
+        free(temporary_path);
+        free(buffer);
+        return 1;
+    }
+
+    bool written = fwrite(buffer, 1, size, file) == size;
+    written = (fclose(file) == 0) && written;
+    free(buffer);
+    if (!written || rename(temporary_path, path) != 0){
+        printf("Error: Can't write analysis %s\n", path);
+        remove(temporary_path);
+        free(temporary_path);
+        return 1;
+    }
+
+    free(temporary_path);
+    return 0;
+
+}
+
+/*
+ * chip8_analysis_load function
+ * Expects: NA
+ * Does: Reads an analysis chip8_analysis_save wrote, returns NULL (silently) if there isn't one at path or it's
+ * from another version or damaged
+ *
+ */
+chip8_analysis *chip8_analysis_load(const char *path){
+
+    FILE *file = fopen(path, "rb");
+    if (!file){
+        return NULL;
+    }
+
+    u8 header[ANALYSIS_HEADER_SIZE];
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) ||
+        memcmp(&header[ANALYSIS_MAGIC], analysis_magic, sizeof(analysis_magic)) != 0 ||
+        get_u16(&header[ANALYSIS_VERSION]) != CHIP8_ANALYSIS_VERSION || header[ANALYSIS_MODE] > CHIP8_MODE_XOCHIP){
+        fclose(file);
+        return NULL;
+    }
+
+    chip8_analysis *analysis = calloc(1, sizeof(chip8_analysis));
+    chip8_mode mode = (chip8_mode)header[ANALYSIS_MODE];
+    u32 addresses = memory_size_of(mode);
+    u32 block_count = get_u32(&header[ANALYSIS_BLOCK_COUNT]);
+    size_t size = addresses * 2 + (size_t)block_count * ANALYSIS_BLOCK_SIZE;
+    u8 *buffer = block_count <= addresses ? malloc(size) : NULL;
+    if (analysis){
+        analysis->blocks = malloc((block_count ? block_count : 1) * sizeof(chip8_basic_block));
+    }
+    if (!analysis || !buffer || !analysis->blocks || fread(buffer, 1, size, file) != size){
+        fclose(file);
+        free(buffer);
+        chip8_analysis_destroy(analysis);
+        return NULL;
+    }
+    fclose(file);
+
+    analysis->memory_hash = get_u64(&header[ANALYSIS_MEMORY_HASH]);
+    analysis->mode = mode;
+    analysis->rom_end = get_u32(&header[ANALYSIS_ROM_END]);
+    analysis->block_count = block_count;
+    const u8 *in = buffer;
+    for (u32 i = 0; i < addresses; i++, in += 2){
+        analysis->flags[i] = get_u16(in);
+    }
+    for (u32 i = 0; i < block_count; i++, in += ANALYSIS_BLOCK_SIZE){
+        chip8_basic_block *block = &analysis->blocks[i];
+        block->start = get_u16(in);
+        block->end = get_u16(in + 2);
+        block->taken = get_u16(in + 4);
+        block->fallthrough = get_u16(in + 6);
+    }
+    free(buffer);
+    return analysis;
+
+}
+
+/*
+ * chip8_analysis_load_or_build function
+ * Expects: chip_8_object to have a rom freshly loaded, cache_dir to be a directory (created if missing) or NULL
+ * Does: Returns the analysis cached in cache_dir for what's in memory, or analyzes it and caches the result,
+ * returns NULL if out of memory
+ *
+ */
+chip8_analysis *chip8_analysis_load_or_build(chip_8 *chip_8_object, const char *cache_dir){
+
+    if (!cache_dir){
+        return chip8_analyze(chip_8_object);
+    }
+
+    size_t path_size = strlen(cache_dir) + 32;
+    char *path = malloc(path_size);
+    if (!path){
+        return NULL;
+    }
+    u64 hash = memory_hash(chip_8_object);
+    snprintf(path, path_size, "%s/%016llx.c8a", cache_dir, (unsigned long long)hash);
+
+    // A file with the same name but built from other memory (a hash collision) is just rebuilt over
+    chip8_analysis *analysis = chip8_analysis_load(path);
+    if (analysis && (analysis->memory_hash != hash || analysis->mode != chip_8_object->mode ||
+                     analysis->rom_end != chip_8_object->rom_end)){
+        chip8_analysis_destroy(analysis);
+        analysis = NULL;
+    }
+
+    if (!analysis){
+        analysis = chip8_analyze(chip_8_object);
+        // Failing to cache it only costs the next run the analysis again
+        if (analysis && (mkdir(cache_dir, 0777) == 0 || errno == EEXIST)){
+            chip8_analysis_save(analysis, path);
+        }
+    }
+    free(path);
+    return analysis;
+
+}
+
+/*
+ * chip8_analysis_attach function
+ * Expects: chip_8_object to have a rom freshly loaded, analysis to outlive the attachment (any number of chip 8s
+ * may share one) or be NULL to detach
+ * Does: Checks the analysis was built from what's in memory, decodes every reachable instruction up front and
+ * hands the analysis to the idle loop detector and the jit, returns 0 on success else 1 (after printing why)
+ *
+ */
+int chip8_analysis_attach(chip_8 *chip_8_object, const chip8_analysis *analysis){
+
+    chip_8_object->analysis = NULL;
+    if (!analysis){
+        return 0;
+    }
+    if (analysis->mode != chip_8_object->mode || analysis->rom_end != chip_8_object->rom_end ||
+        analysis->memory_hash != memory_hash(chip_8_object)){
+        printf("Error: Analysis was built from a different rom or mode than the one loaded\n");
+        return 1;
+    }
+
+    // Everything the analysis read is what's in memory now
+    memset(chip_8_object->analysis_stale, 0, sizeof(chip_8_object->analysis_stale));
+
+    // Decoding the code found now saves the first pass through it doing it one miss at a time
+    for (u32 address = rom_start_address; address < analysis->rom_end; address++){
+        if (analysis->flags[address] & CHIP8_ANALYSIS_CODE){
+            chip8_decode_at(chip_8_object, address);
+        }
+    }
+    chip_8_object->analysis = analysis;
+    return 0;
+
+}
+
+/*
+ * write_flags helper function - chip8_analysis_write_listing
+ * Expects: NA
+ * Does: Writes the notable flags of an instruction as a trailing comment
+ *
+ */
+static void write_flags(u16 flags, FILE *out){
+
+    if (flags & (CHIP8_ANALYSIS_INDIRECT | CHIP8_ANALYSIS_SELF_MODIFYING | CHIP8_ANALYSIS_UNKNOWN_WRITE |
+                 CHIP8_ANALYSIS_IDLE | CHIP8_ANALYSIS_WRITTEN)){
+        fprintf(out, "  ;");
+    }
+    if (flags & CHIP8_ANALYSIS_INDIRECT){
+        fprintf(out, " indirect");
+    }
+    if (flags & CHIP8_ANALYSIS_SELF_MODIFYING){
+        fprintf(out, " writes code");
+    }
+    if (flags & CHIP8_ANALYSIS_UNKNOWN_WRITE){
+        fprintf(out, " writes unknown");
+    }
+    if (flags & CHIP8_ANALYSIS_WRITTEN){
+        fprintf(out, " written");
+    }
+    if (flags & CHIP8_ANALYSIS_IDLE){
+        fprintf(out, " idle");
+    }
+
+}
+
+/*
+ * chip8_analysis_write_listing function
+ * Expects: chip_8_object to be what analysis was built from
+ * Does: Writes the disassembly of the rom to out, code with its block labels and successors, data as bytes
+ *
+ */
+void chip8_analysis_write_listing(const chip8_analysis *analysis, chip_8 *chip_8_object, FILE *out){
+
+    u32 code = 0;
+    u32 data = 0;
+    u32 self_modifying = 0;
+    u32 idle = 0;
+    for (u32 address = rom_start_address; address < analysis->rom_end; address++){
+        u16 flags = analysis->flags[address];
+        code += (flags & CHIP8_ANALYSIS_CODE) != 0;
+        data += (flags & CHIP8_ANALYSIS_DATA) != 0;
+        self_modifying += (flags & CHIP8_ANALYSIS_SELF_MODIFYING) != 0;
+        idle += (flags & (CHIP8_ANALYSIS_CODE | CHIP8_ANALYSIS_IDLE)) == (CHIP8_ANALYSIS_CODE | CHIP8_ANALYSIS_IDLE);
+    }
+    fprintf(out, "; %s rom 0x%04X - 0x%04X, hash %016llx\n", chip8_mode_name(analysis->mode), rom_start_address,
+            analysis->rom_end, (unsigned long long)analysis->memory_hash);
+    fprintf(out, "; %u instructions in %u blocks, %u data bytes, %u self modifying writes, %u idle loop candidates\n",
+            code, analysis->block_count, data, self_modifying, idle);
+
+    u32 block = 0;
+    u32 address = rom_start_address;
+    while (address < analysis->rom_end){
+        u16 flags = analysis->flags[address];
+
+        if (flags & CHIP8_ANALYSIS_CODE){
+            // Block labels go above their first instruction with where the block goes after it
+            while (block < analysis->block_count && analysis->blocks[block].start < address){
+                block++;
+            }
+            if (block < analysis->block_count && analysis->blocks[block].start == address){
+                const chip8_basic_block *current = &analysis->blocks[block];
+                fprintf(out, "\n%s_%04X:  ; ends 0x%04X", flags & CHIP8_ANALYSIS_CALL_TARGET ? "sub" : "block",
+                        address, current->end);
+                if (current->taken != CHIP8_ANALYSIS_NONE){
+                    fprintf(out, ", taken 0x%04X", current->taken);
+                }
+                if (current->fallthrough != CHIP8_ANALYSIS_NONE){
+                    fprintf(out, ", falls through to 0x%04X", current->fallthrough);
+                }
+                fprintf(out, "\n");
+            }
+
+            const decoded_instruction *decoded = chip8_decode_at(chip_8_object, address);
+            int length = instruction_length(decoded);
+            const char *name = decoded->opcode == OPCODE_LONG_SKIP ? opcode_names[decoded->skipped_opcode]
+                                                                   : opcode_names[decoded->opcode];
+            fprintf(out, "  %04X  %04X", address, decoded->instruction);
+            if (length == 4){
+                fprintf(out, " %02X%02X", chip_8_object->memory[address + 2], chip_8_object->memory[address + 3]);
+            }
+            else {
+                fprintf(out, "     ");
+            }
+            fprintf(out, "  %s", name);
+            write_flags(flags, out);
+            fprintf(out, "\n");
+            address += length;
+            continue;
+        }
+
+        if (flags & CHIP8_ANALYSIS_DATA){
+            // Up to 8 data bytes a line, stopping where code starts again
+            fprintf(out, "  %04X  db", address);
+            for (int i = 0; i < 8 && address < analysis->rom_end && (analysis->flags[address] & CHIP8_ANALYSIS_DATA); i++){
+                fprintf(out, " %02X", chip_8_object->memory[address]);
+                address++;
+            }
+            fprintf(out, "\n");
+            continue;
+        }
+
+        // The second byte of an instruction reached at an odd address from another that overlaps it
+        address++;
+    }
+
+}
@@ -0,0 +1,144 @@
+#ifndef chip8_analysis_h
+#define chip8_analysis_h
+#include <stdio.h>
+#include "chip_8_core.h"
+
+// What the analysis found out about one address, a chip8_analysis keeps these for every byte of memory
+// An instruction reachable from the rom's entry point starts here
+#define CHIP8_ANALYSIS_CODE (1u << 0)
+// Second (or later) byte of a reachable instruction
+#define CHIP8_ANALYSIS_OPERAND (1u << 1)
+// Byte of the rom no reachable instruction covers, sprites, tables and the like
+#define CHIP8_ANALYSIS_DATA (1u << 2)
+// First instruction of a basic block
+#define CHIP8_ANALYSIS_LEADER (1u << 3)
+// Target of a 1NNN or BNNN
+#define CHIP8_ANALYSIS_JUMP_TARGET (1u << 4)
+// Target of a 2NNN
+#define CHIP8_ANALYSIS_CALL_TARGET (1u << 5)
+// BNNN, where it lands depends on a register so only NNN and any jump table there are followed
+#define CHIP8_ANALYSIS_INDIRECT (1u << 6)
+// An FX55, FX33 or 5XY2 with I known statically writes this byte
+#define CHIP8_ANALYSIS_WRITTEN (1u << 7)
+// An FX55, FX33 or 5XY2 that writes over reachable code
+#define CHIP8_ANALYSIS_SELF_MODIFYING (1u << 8)
+// An FX55, FX33 or 5XY2 writing through an I the analysis couldn't work out
+#define CHIP8_ANALYSIS_UNKNOWN_WRITE (1u << 9)
+// chip8_skip_idle may fast forward with the PC here (every other address it always returns 0 at)
+#define CHIP8_ANALYSIS_IDLE (1u << 10)
+
+// Bumped whenever the flags or the cache file layout change so stale cache files are rebuilt
+#define CHIP8_ANALYSIS_VERSION 1
+
+// Successor of a block that doesn't have one
+#define CHIP8_ANALYSIS_NONE 0xFFFF
+
+/*
+ * chip8_basic_block struct
+ * Expects: N/A
+ * Does: A straight line run of reachable instructions only entered at start, with where it can go next (calls go
+ * to the routine and fall through to the return site, a BNNN only lists NNN)
+ */
+typedef struct chip8_basic_block {
+    u16 start;
+    // Address one past the block's last instruction
+    u16 end;
+    // Where a jump, call or skip that's taken goes and where the block falls through to, CHIP8_ANALYSIS_NONE if not
+    u16 taken;
+    u16 fallthrough;
+} chip8_basic_block;
+
+/*
+ * chip8_analysis struct
+ * Expects: N/A
+ * Does: Everything worked out statically about a rom as it sits in memory straight after loading: per address
+ * flags and the control flow graph as basic blocks in address order
+ */
+typedef struct chip8_analysis {
+
+    // What the analysis was built from, an analysis only attaches to a chip 8 with the same memory and mode
+    u64 memory_hash;
+    chip8_mode mode;
+    u32 rom_end;
+
+    u16 flags[MEMORY_SIZE];
+
+    chip8_basic_block *blocks;
+    u32 block_count;
+
+} chip8_analysis;
+
+/*
+ * chip8_analyze function
+ * Expects: chip_8_object to have a rom freshly loaded (nothing run yet)
+ * Does: Disassembles everything reachable from the rom's entry point, builds its control flow graph and flags the
+ * data, written bytes, self modifying writes and idle loop candidates, returns NULL if out of memory
+ *
+ */
+chip8_analysis *chip8_analyze(chip_8 *chip_8_object);
+
+/*
+ * chip8_analysis_destroy function
+ * Expects: analysis to have come from chip8_analyze or chip8_analysis_load (or be NULL) and no chip 8 to have it
+ * attached anymore
+ * Does: Frees the analysis
+ *
+ */
+void chip8_analysis_destroy(chip8_analysis *analysis);
+
+/*
+ * chip8_analysis_save function
+ * Expects: NA
+ * Does: Writes analysis to path (to a file next to it then renamed, so a reader never sees half of one), returns 0
+ * on success else 1 (after printing why)
+ *
+ */
+int chip8_analysis_save(const chip8_analysis *analysis, const char *path);
+
+/*
+ * chip8_analysis_load function
+ * Expects: NA
+ * Does: Reads an analysis chip8_analysis_save wrote, returns NULL (silently) if there isn't one at path or it's
+ * from another version or damaged
+ *
+ */
+chip8_analysis *chip8_analysis_load(const char *path);
+
+/*
+ * chip8_analysis_load_or_build function
+ * Expects: chip_8_object to have a rom freshly loaded, cache_dir to be a directory (created if missing) or NULL
+ * Does: Returns the analysis cached in cache_dir for what's in memory, or analyzes it and caches the result,
+ * returns NULL if out of memory
+ *
+ */
+chip8_analysis *chip8_analysis_load_or_build(chip_8 *chip_8_object, const char *cache_dir);
+
+/*
+ * chip8_analysis_attach function
+ * Expects: chip_8_object to have a rom freshly loaded, analysis to outlive the attachment (any number of chip 8s
+ * may share one) or be NULL to detach
+ * Does: Checks the analysis was built from what's in memory, decodes every reachable instruction up front and
+ * hands the analysis to the idle loop detector and the jit, returns 0 on success else 1 (after printing why)
+ *
+ */
+int chip8_analysis_attach(chip_8 *chip_8_object, const chip8_analysis *analysis);
+
+/*
+ * chip8_analysis_stale function
+ * Expects: chip_8_object to have an analysis attached
+ * Does: Returns true when memory the analysis read to flag address has been written since it was attached
+ *
+ */
+static inline bool chip8_analysis_stale(const chip_8 *chip_8_object, u16 address){
+    return (chip_8_object->analysis_stale[address >> 6] >> (address & 63)) & 1;
+}
+
+/*
+ * chip8_analysis_write_listing function
+ * Expects: chip_8_object to be what analysis was built from
+ * Does: Writes the disassembly of the rom to out, code with its block labels and successors, data as bytes
+ *
+ */
+void chip8_analysis_write_listing(const chip8_analysis *analysis, chip_8 *chip_8_object, FILE *out);
+
+#endif /* chip8_analysis_h */
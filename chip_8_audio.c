@@ -0,0 +1,185 @@
+#include "chip_8_audio.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Changes the ring holds, a frame pushes at most one so this is over a second of the audio thread stalling
+#define EVENT_RING_SIZE 64
+
+// Peak of the square wave, about a quarter of full scale so it isn't harsh
+#define AMPLITUDE 8000
+
+// XO-CHIP plays its 128 bit pattern at 4000 * 2^((pitch - 64) / 48) bits per second, 2^(1/48) is one step
+#define XOCHIP_BASE_RATE 4000.0
+#define XOCHIP_PITCH_STEP 1.0145453349375237
+
+/*
+ * sound_event struct
+ * Expects: N/A
+ * Does: What the beeper should be playing from now on, one is pushed each time any of it changes
+ */
+typedef struct sound_event {
+    bool on;
+    bool xochip;
+    u8 pitch;
+    u8 pattern[16];
+} sound_event;
+
+struct chip8_audio {
+
+    // Single producer (chip8_audio_update) single consumer (chip8_audio_fill) ring, head is only written by the
+    // producer and tail by the consumer, each on its own cache line
+    sound_event events[EVENT_RING_SIZE];
+    _Alignas(64) atomic_uint head;
+    _Alignas(64) atomic_uint tail;
+
+    // Producer side: the last event pushed so unchanged frames push nothing
+    _Alignas(64) sound_event pushed;
+    bool pending;
+
+    // Consumer side: what's playing, where in the waveform it is and how far it moves per sample (all 2^32 = one
+    // square wave period or one pass through the pattern)
+    _Alignas(64) sound_event playing;
+    u32 phase;
+    u32 phase_step;
+    u32 beep_step;
+    u32 pattern_steps[256];
+
+};
+
+/*
+ * chip8_audio_create function
+ * Expects: sample_rate to be the rate the output plays samples at
+ * Does: Allocates a silent synthesizer, returns NULL if out of memory
+ *
+ */
+chip8_audio *chip8_audio_create(unsigned int sample_rate){
+
+    chip8_audio *audio = calloc(1, sizeof(chip8_audio));
+    if (!audio){
+        return NULL;
+    }
+    atomic_init(&audio->head, 0);
+    atomic_init(&audio->tail, 0);
+
+    // Every phase step is worked out here so the audio thread never does floating point
+    double period = 4294967296.0 / sample_rate;
+    audio->beep_step = (u32)(CHIP8_AUDIO_BEEP_HZ * period);
+    double rate = XOCHIP_BASE_RATE;
+    for (int i = 0; i < 64; i++){
+        rate /= XOCHIP_PITCH_STEP;
+    }
+    for (int pitch = 0; pitch < 256; pitch++){
+        audio->pattern_steps[pitch] = (u32)(rate / 128 * period);
+        rate *= XOCHIP_PITCH_STEP;
+    }
+    return audio;
+
+}
+
+/*
+ * chip8_audio_destroy function
+ * Expects: audio to have come from chip8_audio_create (or be NULL) and nothing to be filling from it anymore
+ * Does: Frees the synthesizer
+ *
+ */
+void chip8_audio_destroy(chip8_audio *audio){
+    free(audio);
+}
+
+/*
+ * chip8_audio_update function
+ * Expects: to be called from the emulation thread (the only producer) once a frame after the frame ran
+ * Does: Pushes the sound timer's on/off state, XO-CHIP's pattern and pitch onto the ring when they changed (as of
+ * the end of the frame, so changes are frame granular)
+ *
+ */
+void chip8_audio_update(chip8_audio *audio, const chip_8 *chip_8_object){
+
+    sound_event event = {0};
+    event.on = chip_8_object->sound_register > 0;
+    event.xochip = chip_8_object->mode == CHIP8_MODE_XOCHIP;
+    // The pattern only matters while it's audible, so a silent rom rewriting it doesn't push anything
+    if (event.on && event.xochip){
+        event.pitch = chip_8_object->pitch;
+        memcpy(event.pattern, chip_8_object->audio_pattern, sizeof(event.pattern));
+    }
+    if (!audio->pending && memcmp(&event, &audio->pushed, sizeof(event)) == 0){
+        return;
+    }
+
+    // A full ring means the audio thread is stalled, keep the change pending and try again next frame
+    unsigned int head = atomic_load_explicit(&audio->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&audio->tail, memory_order_acquire) == EVENT_RING_SIZE){
+        audio->pushed = event;
+        audio->pending = true;
+        return;
+    }
+    audio->events[head % EVENT_RING_SIZE] = event;
+    atomic_store_explicit(&audio->head, head + 1, memory_order_release);
+    audio->pushed = event;
+    audio->pending = false;
+
+}
+
+/*
+ * play_event function
+ * Expects: to be called from the audio thread
+ * Does: Switches the synthesizer over to event, the phase carries on so changes don't click
+ *
+ */
+static void play_event(chip8_audio *audio, const sound_event *event){
+
+    audio->playing = *event;
+    // A pattern of all zeroes would be silent, XO-CHIP roms that never ran F002 get the plain beep
+    bool has_pattern = false;
+    for (int i = 0; i < 16; i++){
+        has_pattern |= event->pattern[i] != 0;
+    }
+    audio->playing.xochip = event->xochip && has_pattern;
+    audio->phase_step = audio->playing.xochip ? audio->pattern_steps[event->pitch] : audio->beep_step;
+
+}
+
+/*
+ * chip8_audio_fill function
+ * Expects: to be called from the audio thread (the only consumer), samples to hold count mono 16 bit samples
+ * Does: Takes every event pushed since the last fill then synthesizes count samples of the newest one
+ *
+ */
+void chip8_audio_fill(chip8_audio *audio, int16_t *samples, unsigned int count){
+
+    unsigned int tail = atomic_load_explicit(&audio->tail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit(&audio->head, memory_order_acquire);
+    if (tail != head){
+        // Only the newest state is audible, the ones before it were already stale
+        play_event(audio, &audio->events[(head - 1) % EVENT_RING_SIZE]);
+        atomic_store_explicit(&audio->tail, head, memory_order_release);
+    }
+
+    if (!audio->playing.on){
+        memset(samples, 0, count * sizeof(int16_t));
+        return;
+    }
+
+    u32 phase = audio->phase;
+    u32 step = audio->phase_step;
+    if (audio->playing.xochip){
+        // Top 7 bits of the phase pick the pattern bit, most significant bit of the first byte first
+        const u8 *pattern = audio->playing.pattern;
+        for (unsigned int i = 0; i < count; i++){
+            u32 bit = phase >> 25;
+            samples[i] = (pattern[bit >> 3] >> (7 - (bit & 7))) & 1 ? AMPLITUDE : -AMPLITUDE;
+            phase += step;
+        }
+    }
+    else {
+        for (unsigned int i = 0; i < count; i++){
+            samples[i] = phase < 0x80000000u ? AMPLITUDE : -AMPLITUDE;
+            phase += step;
+        }
+    }
+    audio->phase = phase;
+
+}
@@ -0,0 +1,46 @@
+#ifndef chip8_audio_h
+#define chip8_audio_h
+#include <stdint.h>
+#include "chip_8_core.h"
+
+// Frequency of the plain beeper (CHIP-8, SUPER-CHIP and XO-CHIP roms that never load a pattern)
+#define CHIP8_AUDIO_BEEP_HZ 440
+
+typedef struct chip8_audio chip8_audio;
+
+/*
+ * chip8_audio_create function
+ * Expects: sample_rate to be the rate the output plays samples at
+ * Does: Allocates a silent synthesizer, returns NULL if out of memory
+ *
+ */
+chip8_audio *chip8_audio_create(unsigned int sample_rate);
+
+/*
+ * chip8_audio_destroy function
+ * Expects: audio to have come from chip8_audio_create (or be NULL) and nothing to be filling from it anymore
+ * Does: Frees the synthesizer
+ *
+ */
+void chip8_audio_destroy(chip8_audio *audio);
+
+/*
+ * chip8_audio_update function
+ * Expects: to be called from the emulation thread (the only producer) once a frame after the frame ran
+ * Does: Passes the sound timer's on/off state, XO-CHIP's pattern and pitch to the audio thread through a lock free
+ * ring, only when one of them changed since the last update. Beeps start and stop on frame boundaries, a sound timer
+ * that goes on and back off within one frame is never heard
+ *
+ */
+void chip8_audio_update(chip8_audio *audio, const chip_8 *chip_8_object);
+
+/*
+ * chip8_audio_fill function
+ * Expects: to be called from the audio thread (the only consumer), samples to hold count mono 16 bit samples
+ * Does: Picks up every change passed in since the last fill then synthesizes count samples, a square wave at
+ * CHIP8_AUDIO_BEEP_HZ or the XO-CHIP pattern played back at its pitch (silence while the sound timer is 0)
+ *
+ */
+void chip8_audio_fill(chip8_audio *audio, int16_t *samples, unsigned int count);
+
+#endif /* chip8_audio_h */
@@ -1,13 +1,17 @@
 #include "chip_8_core.h"
 #include <stdio.h>
 #include <stdlib.h>
-#include "timing.h"
+#include <string.h>
+#include <strings.h>
+#include "chip_8_analysis.h"
+#include "chip_8_jit.h"
+#include "chip_8_profiler.h"
 
 
-// Width of the CHIP-8 display
+// Width of the CHIP-8 display (lores)
 const int chip_8_screen_width = 64;
 
-// Height of the CHIP-8 display
+// Height of the CHIP-8 display (lores)
 const int chip_8_screen_height = 32;
 
 // CHIP-8 has 4096 bytes of memory
@@ -16,6 +20,67 @@ const int memory_size = 4096;
 // Programs start at memory location 0x200 (512)
 const int rom_start_address = 0x200;
 
+// DEBUG FLAG
+bool debug = false;
+
+// Flag for flag register to be reset by 8xy1, 8xy2, 8xy3
+bool vf_reset_quirk = true;
+// Flag for Fx55 and Fx65 to increment index register
+bool memory_quirk = true;
+// Flag for capping drawing sprites to 60hz (simplification)
+bool display_wait_quirk = true;
+// Flag to enable sprites to clip instead of wrap
+bool clipping_quirk = true;
+// Flag for 8xy6 and 8xyE to shift V[y] placed into V[x] or just shift V[x] inplace
+bool shifting_quirk = false;
+// Flag for 1nnn to jump to nnn + V[n top nibble] + nnn or nnn + V[0]
+bool jumping_quirk = false;
+
+static void select_quirk_profile(chip_8 *chip_8_object);
+
+// Fonts loaded into memory at FONT_START (0x50)
+static const u8 fonts[16][5] = {
+    {0xF0, 0x90, 0x90, 0x90, 0xF0}, // 0
+    {0x20, 0x60, 0x20, 0x20, 0x70}, // 1
+    {0xF0, 0x10, 0xF0, 0x80, 0xF0}, // 2
+    {0xF0, 0x10, 0xF0, 0x10, 0xF0}, // 3
+    {0x90, 0x90, 0xF0, 0x10, 0x10}, // 4
+    {0xF0, 0x80, 0xF0, 0x10, 0xF0}, // 5
+    {0xF0, 0x80, 0xF0, 0x90, 0xF0}, // 6
+    {0xF0, 0x10, 0x20, 0x40, 0x40}, // 7
+    {0xF0, 0x90, 0xF0, 0x90, 0xF0}, // 8
+    {0xF0, 0x90, 0xF0, 0x10, 0xF0}, // 9
+    {0xF0, 0x90, 0xF0, 0x90, 0x90}, // A
+    {0xE0, 0x90, 0xE0, 0x90, 0xE0}, // B
+    {0xF0, 0x80, 0x80, 0x80, 0xF0}, // C
+    {0xE0, 0x90, 0x90, 0x90, 0xE0}, // D
+    {0xF0, 0x80, 0xF0, 0x80, 0xF0}, // E
+    {0xF0, 0x80, 0xF0, 0x80, 0x80}  // F
+};
+
+// SUPER-CHIP 8x10 fonts loaded into memory at BIG_FONT_START (0xA0) for Fx30, A - F are XO-CHIP's
+static const u8 big_fonts[16][10] = {
+    {0x3C, 0x7E, 0xE7, 0xC3, 0xC3, 0xC3, 0xC3, 0xE7, 0x7E, 0x3C}, // 0
+    {0x18, 0x38, 0x58, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C}, // 1
+    {0x3E, 0x7F, 0xC3, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xFF, 0xFF}, // 2
+    {0x3C, 0x7E, 0xC3, 0x03, 0x0E, 0x0E, 0x03, 0xC3, 0x7E, 0x3C}, // 3
+    {0x06, 0x0E, 0x1E, 0x36, 0x66, 0xC6, 0xFF, 0xFF, 0x06, 0x06}, // 4
+    {0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFE, 0x03, 0xC3, 0x7E, 0x3C}, // 5
+    {0x3E, 0x7C, 0xE0, 0xC0, 0xFC, 0xFE, 0xC3, 0xC3, 0x7E, 0x3C}, // 6
+    {0xFF, 0xFF, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x60, 0x60}, // 7
+    {0x3C, 0x7E, 0xC3, 0xC3, 0x7E, 0x7E, 0xC3, 0xC3, 0x7E, 0x3C}, // 8
+    {0x3C, 0x7E, 0xC3, 0xC3, 0x7F, 0x3F, 0x03, 0x03, 0x3E, 0x7C}, // 9
+    {0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3}, // A
+    {0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC}, // B
+    {0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C}, // C
+    {0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC}, // D
+    {0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF}, // E
+    {0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0}  // F
+};
+
+// Names of each chip8_mode as -MODE= takes them
+static const char *const mode_names[] = { "chip8", "schip", "xochip" };
+
 /*
  * push function
  * Expects: The emulated stack to be of size 16 and ONLY 16
@@ -57,26 +122,86 @@ u16 pop (stack *emulated_stack){
 
 /*
  * update_time_registers function
- * Exxpects: chip 8 object to be correctly initialized
- * Does: If a second has passed we decrement any timers above 0 by 1
- *
- */
-void update_time_registers(chip_8 *chip_8_object){
-   unsigned long now = current_ms();
-   if ((now - chip_8_object->last_update) > (1000.0f / 60.0f)){
-      if (chip_8_object->delay_register > 0){
-         chip_8_object->delay_register -= 1;
-      }
-      if (chip_8_object->sound_register > 0) {
-         chip_8_object->sound_register -= 1;
-      }
-      if (chip_8_object->display_wait_timer > 0){
-          chip_8_object->display_wait_timer -= 1;
-      }
-
-      chip_8_object->last_update = now;
+ * Exxpects: cycles to be how many instructions just ran (none of which looked at the timers after a tick was due)
+ * Does: Counts the instructions towards the next timer tick, ticking the timers for every cycles_per_tick passed
+ *
+ */
+void update_time_registers(chip_8 *chip_8_object, uint64_t cycles){
+   if (cycles < chip_8_object->cycles_until_tick){
+      chip_8_object->cycles_until_tick -= cycles;
+      return;
+   }
+
+   // Skipped idle loops can cover thousands of ticks at once so they're counted rather than looped over
+   cycles -= chip_8_object->cycles_until_tick;
+   uint64_t ticks = 1 + cycles / chip_8_object->cycles_per_tick;
+   chip_8_object->cycles_until_tick = chip_8_object->cycles_per_tick - cycles % chip_8_object->cycles_per_tick;
+
+   u8 *timers[3] = { &chip_8_object->delay_register, &chip_8_object->sound_register, &chip_8_object->display_wait_timer };
+   for (int i = 0; i < 3; i++){
+      *timers[i] = ticks < *timers[i] ? *timers[i] - ticks : 0;
    }
+}
+
+/*
+ * chip8_tick_timers function
+ * Expects: chip_8_object to be initialized
+ * Does: Counts the delay, sound and display wait timers down by one 60hz tick
+ *
+ */
+void chip8_tick_timers(chip_8 *chip_8_object){
+   if (chip_8_object->delay_register > 0){
+      chip_8_object->delay_register -= 1;
+   }
+   if (chip_8_object->sound_register > 0) {
+      chip_8_object->sound_register -= 1;
+   }
+   if (chip_8_object->display_wait_timer > 0){
+       chip_8_object->display_wait_timer -= 1;
+   }
+}
+
+/*
+ * chip8_set_cycles_per_tick function
+ * Expects: cycles_per_tick to be at least 1
+ * Does: Sets how many instructions run per 60hz timer tick and starts counting towards the next tick from zero
+ *
+ */
+void chip8_set_cycles_per_tick(chip_8 *chip_8_object, u32 cycles_per_tick){
+    chip_8_object->cycles_per_tick = cycles_per_tick > 0 ? cycles_per_tick : 1;
+    chip_8_object->cycles_until_tick = chip_8_object->cycles_per_tick;
+}
 
+// PCG32 (permuted congruential generator) multiplier and stream, any odd stream works as long as it never changes
+#define RNG_MULTIPLIER 6364136223846793005ULL
+#define RNG_INCREMENT 1442695040888963407ULL
+
+/*
+ * next_random function
+ * Expects: chip_8_object's rng to have been seeded with chip8_seed_rng
+ * Does: Steps the PCG32 state and returns its next 32 bit output
+ *
+ */
+static inline u32 next_random(chip_8 *chip_8_object){
+    u64 state = chip_8_object->rng_state;
+    chip_8_object->rng_state = state * RNG_MULTIPLIER + RNG_INCREMENT;
+    u32 xorshifted = (u32)(((state >> 18) ^ state) >> 27);
+    u32 rotation = (u32)(state >> 59);
+    return (xorshifted >> rotation) | (xorshifted << ((32 - rotation) & 31));
+}
+
+/*
+ * chip8_seed_rng function
+ * Expects: chip_8_object to be initialized
+ * Does: Restarts the random numbers 0xC draws from the sequence for seed
+ *
+ */
+void chip8_seed_rng(chip_8 *chip_8_object, u32 seed){
+    chip_8_object->rng_seed = seed;
+    chip_8_object->rng_state = 0;
+    next_random(chip_8_object);
+    chip_8_object->rng_state += seed;
+    next_random(chip_8_object);
 }
 
 /*
@@ -107,3 +232,939 @@ int print_chip_8_contents(chip_8 *chip_8_instance){
     return 0;
 
 }
+
+/*
+ * chip8_init function
+ * Expects: chip_8_object to point at writable memory, a rom to be loaded (chip8_load_rom_bytes) before it runs
+ * Does: Blanks the chip 8 (but for the decode cache, loading the rom clears that), points the PC at the rom start,
+ * loads the fonts and readies the stack, timers and keys
+ *
+ */
+void chip8_init(chip_8 *chip_8_object){
+
+    // Blank the whole struct to prevent bad data, except the decode cache which loading the rom clears for the
+    // mode's memory (clearing all of it for every instance of a batch run costs more than running them)
+    memset(chip_8_object, 0, offsetof(chip_8, decode_cache));
+
+    // Our Emulated stack requires top be init to -1
+    chip_8_object->emulated_stack.top = -1;
+    // Plain CHIP-8 with 4 KB of memory until chip8_set_mode says otherwise
+    chip_8_object->mode = CHIP8_MODE_CHIP8;
+    chip_8_object->memory_mask = CHIP8_MEMORY_SIZE - 1;
+    chip_8_object->planes = 1;
+    // Timers tick at 60hz of emulated time
+    chip8_set_cycles_per_tick(chip_8_object, CHIP8_DEFAULT_CYCLES_PER_TICK);
+    // Point out program counter to where the rom starts
+    chip_8_object->PC = rom_start_address;
+    // With nothing loaded the program ends where it starts
+    chip_8_object->rom_end = rom_start_address;
+    // Default seed for 0xC, callers wanting different runs should seed their own
+    chip8_seed_rng(chip_8_object, 1);
+    // XO-CHIP plays its audio pattern at 4000 bits per second until Fx3A picks another pitch
+    chip_8_object->pitch = 64;
+    // Handlers for the quirks as they are now (loading a rom picks again in case they've changed since)
+    select_quirk_profile(chip_8_object);
+
+    // Set the fonts to be inside our emulated chip 8s memory starting at FONT_START (0x50)
+    for (int i = 0; i < 16; i++) {
+        for (int j = 0; j < 5; j++) {
+            chip_8_object->memory[FONT_START + i * 5 + j] = fonts[i][j];
+        }
+    }
+
+}
+
+/*
+ * chip8_set_mode function
+ * Expects: chip_8_object to be initialized with chip8_init and no rom loaded yet
+ * Does: Switches chip_8_object to emulating mode, sizing its memory and loading the big fonts for SUPER-CHIP
+ * and XO-CHIP
+ *
+ */
+void chip8_set_mode(chip_8 *chip_8_object, chip8_mode mode){
+
+    chip_8_object->mode = mode;
+    chip_8_object->memory_mask = (mode == CHIP8_MODE_XOCHIP ? MEMORY_SIZE : CHIP8_MEMORY_SIZE) - 1;
+
+    // Plain CHIP-8 leaves the memory past the small fonts blank like it always has
+    u8 *big_font = &chip_8_object->memory[BIG_FONT_START];
+    if (mode == CHIP8_MODE_CHIP8){
+        memset(big_font, 0, sizeof(big_fonts));
+    }
+    else {
+        memcpy(big_font, big_fonts, sizeof(big_fonts));
+    }
+
+}
+
+/*
+ * chip8_mode_from_name function
+ * Expects: name to be chip8, schip or xochip
+ * Does: Sets *mode to the named mode, returns 0 on success else 1 (after printing why)
+ *
+ */
+int chip8_mode_from_name(const char *name, chip8_mode *mode){
+
+    for (int i = 0; i < (int)(sizeof(mode_names) / sizeof(mode_names[0])); i++){
+        if (strcasecmp(mode_names[i], name) == 0){
+            *mode = (chip8_mode)i;
+            return 0;
+        }
+    }
+
+    printf("Error: Unknown mode %s (expected chip8, schip or xochip)\n", name);
+    return 1;
+
+}
+
+/*
+ * chip8_mode_for_path function
+ * Expects: NA
+ * Does: Returns the mode a rom's file extension calls for, .sc8 SUPER-CHIP, .xo8 XO-CHIP and anything else CHIP-8
+ *
+ */
+chip8_mode chip8_mode_for_path(const char *path){
+
+    const char *extension = strrchr(path, '.');
+    if (extension && strcasecmp(extension, ".sc8") == 0){
+        return CHIP8_MODE_SCHIP;
+    }
+    if (extension && strcasecmp(extension, ".xo8") == 0){
+        return CHIP8_MODE_XOCHIP;
+    }
+    return CHIP8_MODE_CHIP8;
+
+}
+
+/*
+ * chip8_mode_name function
+ * Expects: NA
+ * Does: Returns the name of mode as chip8_mode_from_name takes it
+ *
+ */
+const char *chip8_mode_name(chip8_mode mode){
+    return mode_names[mode];
+}
+
+/*
+ * chip8_load_rom_bytes function
+ * Expects: chip_8_object to be initialized with chip8_init (and chip8_set_mode) and rom to hold size bytes of a rom
+ * Does: Copies the rom into memory at rom_start_address (truncating anything that doesn't fit) and records where it ends
+ *
+ */
+void chip8_load_rom_bytes(chip_8 *chip_8_object, const u8 *rom, size_t size){
+
+    size_t space = chip_8_object->memory_mask + 1 - rom_start_address;
+    if (size > space){
+        size = space;
+    }
+
+    memcpy(&chip_8_object->memory[rom_start_address], rom, size);
+    chip_8_object->rom_end = rom_start_address + size;
+
+    // Anything decoded or compiled before the rom was loaded is stale now and the quirks may have
+    // been set after chip8_init so this is where the profile is settled
+    select_quirk_profile(chip_8_object);
+    memset(chip_8_object->decode_cache, 0, (chip_8_object->memory_mask + 1) * sizeof(decoded_instruction));
+    if (chip_8_object->jit){
+        chip8_jit_flush(chip_8_object->jit);
+    }
+
+    // An analysis is only good for the rom it was built from (chip8_analysis_attach hands the new one over)
+    chip_8_object->analysis = NULL;
+
+}
+
+/*
+ * chip8_load_rom function
+ * Expects: chip_8_object to be initialized with chip8_init (and chip8_set_mode) and path to point at a chip 8 rom
+ * Does: Reads the rom into memory at rom_start_address and records where it ends, returns 0 on success else 1
+ *
+ */
+int chip8_load_rom(chip_8 *chip_8_object, const char *path){
+
+    FILE *rom = fopen(path, "rb");
+    if (!rom) {
+        return 1;
+    }
+
+    // Read in the rom and set how many bytes were read into this variable (XO-CHIP roms can be up to 64 KB)
+    u8 *rom_data = malloc(MEMORY_SIZE);
+    if (!rom_data) {
+        fclose(rom);
+        return 1;
+    }
+    size_t bytes_read = fread(rom_data, 1, chip_8_object->memory_mask + 1 - rom_start_address, rom);
+    fclose(rom);
+
+    chip8_load_rom_bytes(chip_8_object, rom_data, bytes_read);
+    free(rom_data);
+    return 0;
+
+}
+
+/*
+ * chip8_is_running function
+ * Expects: chip_8_object to have a rom loaded
+ * Does: Returns true while the program counter is still inside the loaded rom (and 00FD hasn't exited)
+ *
+ */
+bool chip8_is_running(const chip_8 *chip_8_object){
+    return chip_8_object->PC < chip_8_object->rom_end;
+}
+
+/*
+ * chip8_set_keys function
+ * Expects: keys to have bit N set for every key N (0x0 - 0xF) held down, called once per frame
+ * Does: Sets which keys the chip 8 sees as held until the next call and queues every key that just went down
+ * for a waiting Fx0A
+ *
+ */
+void chip8_set_keys(chip_8 *chip_8_object, u16 keys){
+
+    // Presses only matter to an Fx0A that is waiting, anything earlier would end the wait the moment it starts
+    u16 pressed = keys & ~chip_8_object->keys_down;
+    while (pressed && chip_8_object->waiting_for_key){
+        int key = __builtin_ctz(pressed);
+        pressed &= pressed - 1;
+
+        // A full queue drops its oldest press
+        if (chip_8_object->key_press_count == 16){
+            chip_8_object->key_press_head = (chip_8_object->key_press_head + 1) & 15;
+            chip_8_object->key_press_count--;
+        }
+        chip_8_object->key_presses[(chip_8_object->key_press_head + chip_8_object->key_press_count) & 15] = key;
+        chip_8_object->key_press_count++;
+    }
+
+    chip_8_object->keys_down = keys;
+
+}
+
+/*
+ * chip8_next_key_press function
+ * Expects: chip_8_object to be correctly initialized
+ * Does: Takes the oldest queued key press and returns it or 0xFF as no key has gone down
+ *
+ */
+u8 chip8_next_key_press(chip_8 *chip_8_object) {
+    if (chip_8_object->key_press_count == 0){
+        return 0xFF;
+    }
+    u8 key = chip_8_object->key_presses[chip_8_object->key_press_head];
+    chip_8_object->key_press_head = (chip_8_object->key_press_head + 1) & 15;
+    chip_8_object->key_press_count--;
+    return key;
+
+}
+
+/*
+ * invalidate_decoded_instructions function
+ * Expects: address and length to describe bytes of memory that were just written
+ * Does: Drops every cached decode that read any of those bytes so it gets decoded again on its next fetch
+ *
+ */
+static void invalidate_decoded_instructions(chip_8 *chip_8_object, int address, int length){
+
+    // The analysis worked out each address's idle flag from the 4 bytes before it up to the 7 after it
+    if (chip_8_object->analysis){
+        for (int i = address - 7; i <= address + length + 3; i++){
+            u32 stale = i & chip_8_object->memory_mask;
+            chip_8_object->analysis_stale[stale >> 6] |= 1ull << (stale & 63);
+        }
+    }
+
+    // The instruction starting one byte early also reads the first written byte, and in XO-CHIP the one three
+    // bytes early looked at it to see whether a skip has an F000 NNNN to jump over
+    int first = address - (chip_8_object->mode == CHIP8_MODE_XOCHIP ? 3 : 1);
+    int last = address + length - 1;
+    int memory_end = chip_8_object->memory_mask;
+
+    if (first < 0){
+        first = 0;
+    }
+    // Writes through I wrap round to the start of memory
+    if (last > memory_end){
+        invalidate_decoded_instructions(chip_8_object, 0, last - memory_end);
+        last = memory_end;
+    }
+
+    for (int i = first; i <= last; i++){
+        chip_8_object->decode_cache[i].handler = NULL;
+    }
+
+    // Compiled blocks read the same bytes
+    if (chip_8_object->jit){
+        chip8_jit_invalidate(chip_8_object->jit, first, last);
+    }
+
+}
+
+/*
+ * chip8_memory_written function
+ * Expects: address and length to describe bytes of memory something outside the core just wrote
+ * Does: Drops every cached decode and compiled block that read any of those bytes
+ *
+ */
+void chip8_memory_written(chip_8 *chip_8_object, int address, int length){
+    invalidate_decoded_instructions(chip_8_object, address, length);
+}
+
+/*
+ * rotate_right function
+ * Expects: shift to be 0 - 63
+ * Does: Rotates value right by shift bits, bits falling off the bottom come back in at the top
+ *
+ */
+static inline u64 rotate_right(u64 value, unsigned int shift){
+    return (value >> shift) | (value << ((64 - shift) & 63));
+}
+
+/*
+ * place_sprite_row function
+ * Expects: bits to be a sprite row left aligned in 16 bits (8 wide sprites in the top byte), x to be inside width
+ * and width to be 64 or 128
+ * Does: Lines the sprite row up with column x as the two words of a display row, anything past the right edge is
+ * dropped (clip) or wrapped round to the left
+ *
+ */
+static inline void place_sprite_row(u16 bits, int x, int width, bool clip, u64 *left, u64 *right){
+
+    u64 row = (u64)bits << 48;
+
+    // Lores only ever uses the first word
+    if (width == 64){
+        *left = clip ? row >> x : rotate_right(row, x);
+        *right = 0;
+        return;
+    }
+
+    if (x < 64){
+        *left = row >> x;
+        *right = x ? row << (64 - x) : 0;
+    }
+    else {
+        // Whatever falls off the end of the second word wraps into the top of the first
+        *left = (clip || x == 64) ? 0 : row << (128 - x);
+        *right = row >> (x - 64);
+    }
+
+}
+
+/*
+ * scroll_display_rows function
+ * Expects: rows to be positive to scroll down or negative to scroll up
+ * Does: Moves every row of the selected planes rows pixels down (or up), blanking the rows scrolled in
+ *
+ */
+static void scroll_display_rows(chip_8 *chip_8_object, int rows){
+
+    int height = chip8_display_height(chip_8_object);
+    int distance = rows < 0 ? -rows : rows;
+    if (distance > height){
+        distance = height;
+    }
+
+    for (int plane = 0; plane < CHIP8_PLANES; plane++){
+        if (!(chip_8_object->planes & (1 << plane))){
+            continue;
+        }
+        u64 (*display)[2] = chip_8_object->display[plane];
+        // Whole rows (both words) move at once
+        if (rows > 0){
+            memmove(&display[distance], &display[0], (height - distance) * sizeof(display[0]));
+            memset(&display[0], 0, distance * sizeof(display[0]));
+        }
+        else {
+            memmove(&display[0], &display[distance], (height - distance) * sizeof(display[0]));
+            memset(&display[height - distance], 0, distance * sizeof(display[0]));
+        }
+    }
+
+    chip_8_object->dirty_rows |= height == 64 ? ~(u64)0 : ((u64)1 << height) - 1;
+
+}
+
+/*
+ * scroll_display_columns function
+ * Expects: columns to be 1 - 63 to scroll right or -1 - -63 to scroll left
+ * Does: Moves every row of the selected planes columns pixels right (or left), blanking the columns scrolled in
+ *
+ */
+static void scroll_display_columns(chip_8 *chip_8_object, int columns){
+
+    int height = chip8_display_height(chip_8_object);
+    int distance = columns < 0 ? -columns : columns;
+
+    for (int plane = 0; plane < CHIP8_PLANES; plane++){
+        if (!(chip_8_object->planes & (1 << plane))){
+            continue;
+        }
+        for (int i = 0; i < height; i++){
+            u64 *row = chip_8_object->display[plane][i];
+            // Hires carries the bits crossing the middle from one word to the other, lores just drops them
+            if (columns > 0){
+                row[1] = chip_8_object->hires ? (row[1] >> distance) | (row[0] << (64 - distance)) : 0;
+                row[0] >>= distance;
+            }
+            else {
+                row[0] = (row[0] << distance) | (chip_8_object->hires ? row[1] >> (64 - distance) : 0);
+                row[1] = chip_8_object->hires ? row[1] << distance : 0;
+            }
+        }
+    }
+
+    chip_8_object->dirty_rows |= height == 64 ? ~(u64)0 : ((u64)1 << height) - 1;
+
+}
+
+/*
+ * set_resolution function
+ * Expects: NA
+ * Does: Switches between lores and hires, clearing every plane of the display like SUPER-CHIP and XO-CHIP do
+ *
+ */
+static void set_resolution(chip_8 *chip_8_object, bool hires){
+    chip_8_object->hires = hires;
+    memset(chip_8_object->display, 0, sizeof(chip_8_object->display));
+    chip_8_object->dirty_rows = ~(u64)0;
+}
+
+
+/*
+ * decode_instruction function
+ * Expects: decoded to point at the cache entry for the address instruction was fetched from
+ * Does: Picks the handler for instruction from handlers and pulls out all of its operands so they never need to
+ * be masked again
+ *
+ */
+static void decode_instruction(u16 instruction, decoded_instruction *decoded, const opcode_handler *handlers, u8 mode){
+
+    // SUPER-CHIP and XO-CHIP only instructions decode as ignored in plain CHIP-8 like they always have
+    bool extended = mode != CHIP8_MODE_CHIP8;
+    bool xochip = mode == CHIP8_MODE_XOCHIP;
+
+    decoded->instruction = instruction;
+    decoded->x = (instruction & 0x0F00) >> 8;
+    decoded->y = (instruction & 0x00F0) >> 4;
+    decoded->n = instruction & 0x000F;
+    decoded->nn = instruction & 0x00FF;
+    decoded->nnn = instruction & 0x0FFF;
+    decoded->opcode = OPCODE_IGNORED;
+
+    // Switch case for the instruction we grab the first hex value of the 2 byte instruction
+    switch ((instruction & 0xF000) >> 12){
+        case 0x0:
+            switch (decoded->nn){
+                case 0xE0: decoded->opcode = OPCODE_CLEAR_DISPLAY; break;
+                case 0xEE: decoded->opcode = OPCODE_RETURN; break;
+            }
+            if (extended){
+                switch (instruction){
+                    case 0x00FB: decoded->opcode = OPCODE_SCROLL_RIGHT; break;
+                    case 0x00FC: decoded->opcode = OPCODE_SCROLL_LEFT; break;
+                    case 0x00FD: decoded->opcode = OPCODE_EXIT; break;
+                    case 0x00FE: decoded->opcode = OPCODE_LORES; break;
+                    case 0x00FF: decoded->opcode = OPCODE_HIRES; break;
+                }
+                if ((instruction & 0xFFF0) == 0x00C0){
+                    decoded->opcode = OPCODE_SCROLL_DOWN;
+                }
+                if (xochip && (instruction & 0xFFF0) == 0x00D0){
+                    decoded->opcode = OPCODE_SCROLL_UP;
+                }
+            }
+            break;
+        case 0x1: decoded->opcode = OPCODE_JUMP; break;
+        case 0x2: decoded->opcode = OPCODE_CALL; break;
+        case 0x3: decoded->opcode = OPCODE_SKIP_IF_EQUAL_IMMEDIATE; break;
+        case 0x4: decoded->opcode = OPCODE_SKIP_IF_NOT_EQUAL_IMMEDIATE; break;
+        case 0x5:
+            decoded->opcode = OPCODE_SKIP_IF_EQUAL_REGISTER;
+            if (xochip && decoded->n == 0x2){
+                decoded->opcode = OPCODE_SAVE_RANGE;
+            }
+            if (xochip && decoded->n == 0x3){
+                decoded->opcode = OPCODE_LOAD_RANGE;
+            }
+            break;
+        case 0x6: decoded->opcode = OPCODE_SET_IMMEDIATE; break;
+        case 0x7: decoded->opcode = OPCODE_ADD_IMMEDIATE; break;
+        // 0x8 is used for a lot of logical and arthmetic instructions so we switch for each
+        case 0x8:
+            switch (decoded->n){
+                case 0x0: decoded->opcode = OPCODE_SET_REGISTER; break;
+                case 0x1: decoded->opcode = OPCODE_OR; break;
+                case 0x2: decoded->opcode = OPCODE_AND; break;
+                case 0x3: decoded->opcode = OPCODE_XOR; break;
+                case 0x4: decoded->opcode = OPCODE_ADD_REGISTER; break;
+                case 0x5: decoded->opcode = OPCODE_SUBTRACT_REGISTER; break;
+                case 0x6: decoded->opcode = OPCODE_SHIFT_RIGHT; break;
+                case 0x7: decoded->opcode = OPCODE_SUBTRACT_REVERSED; break;
+                case 0xE: decoded->opcode = OPCODE_SHIFT_LEFT; break;
+            }
+            break;
+        case 0x9: decoded->opcode = OPCODE_SKIP_IF_NOT_EQUAL_REGISTER; break;
+        case 0xA: decoded->opcode = OPCODE_SET_INDEX; break;
+        case 0xB: decoded->opcode = OPCODE_JUMP_OFFSET; break;
+        case 0xC: decoded->opcode = OPCODE_RANDOM; break;
+        // Plain CHIP-8 keeps its own 64x32 only draw so it doesn't pay for the extended modes
+        case 0xD: decoded->opcode = extended ? OPCODE_EXTENDED_DRAW : OPCODE_DRAW; break;
+        // Cases for input (that aren't blocking)
+        case 0xE:
+            switch (decoded->nn){
+                case 0x9E: decoded->opcode = OPCODE_SKIP_IF_KEY; break;
+                case 0xA1: decoded->opcode = OPCODE_SKIP_IF_NOT_KEY; break;
+            }
+            break;
+        // Opcodes for timers, setting, and reading
+        case 0xF:
+            switch (decoded->nn){
+                case 0x07: decoded->opcode = OPCODE_READ_DELAY; break;
+                case 0x0A: decoded->opcode = OPCODE_WAIT_FOR_KEY; break;
+                case 0x15: decoded->opcode = OPCODE_SET_DELAY; break;
+                case 0x18: decoded->opcode = OPCODE_SET_SOUND; break;
+                case 0x1E: decoded->opcode = OPCODE_ADD_INDEX; break;
+                case 0x29: decoded->opcode = OPCODE_FONT; break;
+                case 0x33: decoded->opcode = OPCODE_BCD; break;
+                case 0x55: decoded->opcode = OPCODE_STORE_REGISTERS; break;
+                case 0x65: decoded->opcode = OPCODE_LOAD_REGISTERS; break;
+                case 0x30: if (extended) decoded->opcode = OPCODE_BIG_FONT; break;
+                case 0x75: if (extended) decoded->opcode = OPCODE_SAVE_FLAGS; break;
+                case 0x85: if (extended) decoded->opcode = OPCODE_LOAD_FLAGS; break;
+                case 0x01: if (xochip) decoded->opcode = OPCODE_SELECT_PLANES; break;
+                case 0x3A: if (xochip) decoded->opcode = OPCODE_PITCH; break;
+            }
+            if (xochip && instruction == 0xF000){
+                decoded->opcode = OPCODE_LONG_INDEX;
+            }
+            if (xochip && instruction == 0xF002){
+                decoded->opcode = OPCODE_AUDIO_PATTERN;
+            }
+            break;
+    }
+
+    decoded->handler = handlers[decoded->opcode];
+
+}
+
+/*
+ * cached_decode function
+ * Expects: chip_8_object to be initialized, address to be inside the mode's memory
+ * Does: Returns the cache entry for address, decoding the instruction there first if it isn't cached
+ *
+ */
+static inline decoded_instruction *cached_decode(chip_8 *chip_8_object, u16 address){
+
+    // Instructions are decoded once per address and reused until something writes over them. Only a miss
+    // looks at the memory size, loading it on every fetch costs the hot loop more than the rest of the fetch
+    decoded_instruction *decoded = &chip_8_object->decode_cache[address];
+    if (!decoded->handler){
+        u32 mask = chip_8_object->memory_mask;
+        const u8 *memory = chip_8_object->memory;
+        u16 instruction = (memory[address] << 8) | memory[(address + 1) & mask];
+        decode_instruction(instruction, decoded, chip_8_object->profile->handlers, chip_8_object->mode);
+
+        // A skip in XO-CHIP jumps all of a F000 NNNN that follows it, those few are wrapped in LONG_SKIP so the
+        // plain skips can keep stepping a fixed 2 bytes
+        bool skip = decoded->opcode == OPCODE_SKIP_IF_EQUAL_IMMEDIATE || decoded->opcode == OPCODE_SKIP_IF_NOT_EQUAL_IMMEDIATE ||
+                    decoded->opcode == OPCODE_SKIP_IF_EQUAL_REGISTER || decoded->opcode == OPCODE_SKIP_IF_NOT_EQUAL_REGISTER ||
+                    decoded->opcode == OPCODE_SKIP_IF_KEY || decoded->opcode == OPCODE_SKIP_IF_NOT_KEY;
+        if (skip && chip_8_object->mode == CHIP8_MODE_XOCHIP && memory[(address + 2) & mask] == 0xF0 &&
+            memory[(address + 3) & mask] == 0x00){
+            decoded->skipped_opcode = decoded->opcode;
+            decoded->opcode = OPCODE_LONG_SKIP;
+            decoded->handler = chip_8_object->profile->handlers[OPCODE_LONG_SKIP];
+        }
+    }
+    return decoded;
+
+}
+
+/*
+ * fetch_instruction function
+ * Expects: chip_8_object to be initialized with a rom loaded and running (so the PC is inside the rom)
+ * Does: Returns the decoded instruction at the PC (decoding it if it isn't cached) and moves the PC past it,
+ * printing it when print_debug is set
+ *
+ */
+static inline decoded_instruction *fetch_instruction(chip_8 *chip_8_object, bool print_debug){
+
+    decoded_instruction *decoded = cached_decode(chip_8_object, chip_8_object->PC);
+
+    // Increment out PC by 2 (2 byte instruction size)
+    chip_8_object->PC += 2;
+
+    // Debug statements
+    if (print_debug){
+        printf("On instruction address: 0x%04X, which is: 0x%04X\n", chip_8_object->PC, decoded->instruction);
+    }
+
+    return decoded;
+
+}
+
+/*
+ * count_instruction function
+ * Expects: profiler to be attached, address to be where decoded was fetched from
+ * Does: Counts one executed instruction towards its opcode and address
+ *
+ */
+static inline void count_instruction(chip8_profiler *profiler, const decoded_instruction *decoded, u32 address){
+    profiler->opcode_counts[decoded->opcode]++;
+    profiler->address_counts[address & (MEMORY_SIZE - 1)]++;
+}
+
+/*
+ * count_draw function
+ * Expects: profiler to be attached
+ * Does: Counts one DXYN that XORed pixels sprite pixels into the display
+ *
+ */
+static inline void count_draw(chip8_profiler *profiler, int pixels, bool collision){
+    profiler->draws++;
+    profiler->draw_pixels += pixels;
+    profiler->draw_collisions += collision;
+}
+
+/* One copy of the opcode handlers and run loop per quirk profile (see chip_8_profile.h) */
+
+// CHIP-8 as the COSMAC VIP ran it, this emulator's defaults
+#define PROFILE_NAME cosmac
+#define VF_RESET_QUIRK true
+#define MEMORY_QUIRK true
+#define DISPLAY_WAIT_QUIRK true
+#define CLIPPING_QUIRK true
+#define SHIFTING_QUIRK false
+#define JUMPING_QUIRK false
+#define PROFILE_DEBUG false
+#include "chip_8_profile.h"
+
+// SUPER-CHIP (modern, as on the HP48 interpreters)
+#define PROFILE_NAME schip
+#define VF_RESET_QUIRK false
+#define MEMORY_QUIRK false
+#define DISPLAY_WAIT_QUIRK false
+#define CLIPPING_QUIRK true
+#define SHIFTING_QUIRK true
+#define JUMPING_QUIRK true
+#define PROFILE_DEBUG false
+#include "chip_8_profile.h"
+
+// XO-CHIP
+#define PROFILE_NAME xochip
+#define VF_RESET_QUIRK false
+#define MEMORY_QUIRK true
+#define DISPLAY_WAIT_QUIRK false
+#define CLIPPING_QUIRK false
+#define SHIFTING_QUIRK false
+#define JUMPING_QUIRK false
+#define PROFILE_DEBUG false
+#include "chip_8_profile.h"
+
+// Any other mix of quirks, or debug output, checks the globals on every instruction
+#define PROFILE_NAME generic
+#define PROFILE_GENERIC
+#define VF_RESET_QUIRK vf_reset_quirk
+#define MEMORY_QUIRK memory_quirk
+#define DISPLAY_WAIT_QUIRK display_wait_quirk
+#define CLIPPING_QUIRK clipping_quirk
+#define SHIFTING_QUIRK shifting_quirk
+#define JUMPING_QUIRK jumping_quirk
+#define PROFILE_DEBUG DEBUG_ENABLED
+#include "chip_8_profile.h"
+
+static const quirk_profile profile_generic = {
+    "generic",
+    false, false, false, false, false, false,
+    opcode_handlers_generic,
+    run_generic
+};
+
+// Profiles with their quirks baked in, in the order they're matched
+static const quirk_profile *const fixed_profiles[] = { &profile_cosmac, &profile_schip, &profile_xochip };
+#define FIXED_PROFILE_COUNT (int)(sizeof(fixed_profiles) / sizeof(fixed_profiles[0]))
+
+/*
+ * select_quirk_profile function
+ * Expects: the quirk globals and debug to be set how they'll stay for the run
+ * Does: Points chip_8_object at the fixed profile matching the quirk globals, or the generic one if none do or
+ * debug output is on
+ *
+ */
+static void select_quirk_profile(chip_8 *chip_8_object){
+
+    chip_8_object->profile = &profile_generic;
+    if (DEBUG_ENABLED){
+        return;
+    }
+
+    for (int i = 0; i < FIXED_PROFILE_COUNT; i++){
+        const quirk_profile *profile = fixed_profiles[i];
+        if (profile->vf_reset == vf_reset_quirk && profile->memory == memory_quirk &&
+            profile->display_wait == display_wait_quirk && profile->clipping == clipping_quirk &&
+            profile->shifting == shifting_quirk && profile->jumping == jumping_quirk){
+            chip_8_object->profile = profile;
+            return;
+        }
+    }
+
+}
+
+/*
+ * chip8_use_quirk_profile function
+ * Expects: name to be cosmac, schip or xochip
+ * Does: Sets the six quirk globals to that profile, returns 0 on success else 1 (after printing why)
+ *
+ */
+int chip8_use_quirk_profile(const char *name){
+
+    for (int i = 0; i < FIXED_PROFILE_COUNT; i++){
+        const quirk_profile *profile = fixed_profiles[i];
+        if (strcmp(profile->name, name) == 0){
+            vf_reset_quirk = profile->vf_reset;
+            memory_quirk = profile->memory;
+            display_wait_quirk = profile->display_wait;
+            clipping_quirk = profile->clipping;
+            shifting_quirk = profile->shifting;
+            jumping_quirk = profile->jumping;
+            return 0;
+        }
+    }
+
+    printf("Error: Unknown quirk profile %s (expected cosmac, schip or xochip)\n", name);
+    return 1;
+
+}
+
+/*
+ * chip8_profile_name function
+ * Expects: chip_8_object to be initialized
+ * Does: Returns the name of the profile chip_8_object is running with
+ *
+ */
+const char *chip8_profile_name(const chip_8 *chip_8_object){
+    return chip_8_object->profile->name;
+}
+
+/*
+ * chip8_decode_at function
+ * Expects: address to be inside memory
+ * Does: Returns the decoded instruction at address without executing it or touching the PC
+ *
+ */
+const decoded_instruction *chip8_decode_at(chip_8 *chip_8_object, u16 address){
+    return cached_decode(chip_8_object, address & chip_8_object->memory_mask);
+}
+
+/*
+ * key_poll_loop helper function - chip8_skip_idle
+ * Expects: start to be where a possible Ex9E/ExA1 + 1NNN loop starts
+ * Does: Returns the key check if start holds one with a jump straight back to it, else NULL
+ *
+ */
+static const decoded_instruction *key_poll_loop(chip_8 *chip_8_object, u16 start){
+
+    const decoded_instruction *check = chip8_decode_at(chip_8_object, start);
+    const decoded_instruction *jump = chip8_decode_at(chip_8_object, start + 2);
+    if ((check->opcode != OPCODE_SKIP_IF_KEY && check->opcode != OPCODE_SKIP_IF_NOT_KEY) ||
+        jump->opcode != OPCODE_JUMP || jump->nnn != start){
+        return NULL;
+    }
+    return check;
+
+}
+
+/*
+ * key_poll_cycles helper function - chip8_skip_idle
+ * Expects: start to be where a possible Ex9E/ExA1 + 1NNN loop starts with the PC inside it
+ * Does: Returns how many of budget instructions whole passes of the loop would take, 0 if it isn't one
+ * that keeps looping on the keys held now
+ *
+ */
+static uint64_t key_poll_cycles(chip_8 *chip_8_object, u16 start, uint64_t budget){
+
+    const decoded_instruction *check = key_poll_loop(chip_8_object, start);
+    if (!check){
+        return 0;
+    }
+
+    // Looping means the check doesn't skip the jump back
+    bool down = chip8_key_down(chip_8_object, chip_8_object->V[check->x]);
+    bool skips = (check->opcode == OPCODE_SKIP_IF_KEY) ? down : !down;
+    return skips ? 0 : budget - budget % 2;
+
+}
+
+/*
+ * timer_poll_loop helper function - chip8_skip_idle
+ * Expects: start to be where a possible Fx07 + 3xNN/4xNN + 1NNN loop starts
+ * Does: Returns the check on the timer's value if start holds one with a jump straight back to it, else NULL
+ *
+ */
+static const decoded_instruction *timer_poll_loop(chip_8 *chip_8_object, u16 start){
+
+    const decoded_instruction *read = chip8_decode_at(chip_8_object, start);
+    const decoded_instruction *check = chip8_decode_at(chip_8_object, start + 2);
+    const decoded_instruction *jump = chip8_decode_at(chip_8_object, start + 4);
+    if (read->opcode != OPCODE_READ_DELAY || jump->opcode != OPCODE_JUMP || jump->nnn != start ||
+        (check->opcode != OPCODE_SKIP_IF_EQUAL_IMMEDIATE && check->opcode != OPCODE_SKIP_IF_NOT_EQUAL_IMMEDIATE) ||
+        check->x != read->x){
+        return NULL;
+    }
+    return check;
+
+}
+
+/*
+ * timer_poll_cycles helper function - chip8_skip_idle
+ * Expects: start to be where a possible Fx07 + 3xNN/4xNN + 1NNN loop starts with the PC inside it
+ * Does: Returns how many of until_tick instructions whole passes of the loop would take, 0 if it isn't one
+ * that keeps looping on the delay timer's value now
+ *
+ */
+static uint64_t timer_poll_cycles(chip_8 *chip_8_object, u16 start, uint64_t until_tick){
+
+    const decoded_instruction *check = timer_poll_loop(chip_8_object, start);
+    if (!check){
+        return 0;
+    }
+
+    // A pass only changes nothing once Vx already holds the timer (wherever in the loop the PC is) and
+    // the check doesn't skip the jump back
+    u8 delay = chip_8_object->delay_register;
+    if (chip_8_object->V[check->x] != delay){
+        return 0;
+    }
+    bool skips = (check->opcode == OPCODE_SKIP_IF_EQUAL_IMMEDIATE) ? delay == check->nn : delay != check->nn;
+    return skips ? 0 : until_tick - until_tick % 3;
+
+}
+
+/*
+ * chip8_may_idle_at function
+ * Expects: NA
+ * Does: Returns true if chip8_skip_idle could fast forward with the PC at address given what's in memory now
+ * (whatever the registers, keys and timers hold), false when it's sure to return 0 there
+ *
+ */
+bool chip8_may_idle_at(chip_8 *chip_8_object, u16 address){
+
+    // The same shapes chip8_skip_idle looks for with everything that can change at run time left out
+    u32 memory_end = chip_8_object->memory_mask + 1;
+    const decoded_instruction *decoded = chip8_decode_at(chip_8_object, address);
+
+    switch (decoded->opcode){
+        case OPCODE_JUMP:
+            return decoded->nnn == address ||
+                   (decoded->nnn == (u16)(address - 2) && key_poll_loop(chip_8_object, address - 2)) ||
+                   (decoded->nnn == (u16)(address - 4) && timer_poll_loop(chip_8_object, address - 4));
+        case OPCODE_WAIT_FOR_KEY:
+        case OPCODE_DRAW:
+        case OPCODE_EXTENDED_DRAW:
+            return true;
+        case OPCODE_SKIP_IF_KEY:
+        case OPCODE_SKIP_IF_NOT_KEY:
+            return (u32)address + 4 <= memory_end && key_poll_loop(chip_8_object, address);
+        case OPCODE_READ_DELAY:
+            return (u32)address + 6 <= memory_end && timer_poll_loop(chip_8_object, address);
+        case OPCODE_SKIP_IF_EQUAL_IMMEDIATE:
+        case OPCODE_SKIP_IF_NOT_EQUAL_IMMEDIATE:
+            return address >= 2 && (u32)address + 4 <= memory_end && timer_poll_loop(chip_8_object, address - 2);
+        default:
+            return false;
+    }
+
+}
+
+/*
+ * chip8_skip_idle function
+ * Expects: until_tick to be the instructions left before the next timer tick and budget the instructions left
+ * to run (until_tick <= budget)
+ * Does: Returns how many instructions the program would spend spinning in an idle loop without changing
+ * anything, the caller counts them as executed instead of running them
+ *
+ */
+uint64_t chip8_skip_idle(chip_8 *chip_8_object, uint64_t until_tick, uint64_t budget){
+
+    u16 PC = chip_8_object->PC;
+
+    // An analysed rom already knows every address none of the loops below can be at, unless memory they'd be
+    // read from was written since
+    const chip8_analysis *analysis = chip_8_object->analysis;
+    if (analysis && !(analysis->flags[PC] & CHIP8_ANALYSIS_IDLE) && !chip8_analysis_stale(chip_8_object, PC)){
+        return 0;
+    }
+
+    u32 memory_end = chip_8_object->memory_mask + 1;
+    const decoded_instruction *decoded = chip8_decode_at(chip_8_object, PC);
+
+    switch (decoded->opcode){
+        // 1NNN jumping to itself never changes anything again, otherwise it may close a polling loop
+        case OPCODE_JUMP:
+            if (decoded->nnn == PC){
+                return budget;
+            }
+            if (decoded->nnn == (u16)(PC - 2)){
+                return key_poll_cycles(chip_8_object, PC - 2, budget);
+            }
+            if (decoded->nnn == (u16)(PC - 4)){
+                return timer_poll_cycles(chip_8_object, PC - 4, until_tick);
+            }
+            return 0;
+        // FX0A already waiting with no press queued waits until the frontend sets new keys
+        case OPCODE_WAIT_FOR_KEY:
+            return (chip_8_object->waiting_for_key && chip_8_object->key_press_count == 0) ? budget : 0;
+        // DXYN held back by the display wait quirk retries until the next tick
+        case OPCODE_DRAW:
+        case OPCODE_EXTENDED_DRAW:
+            return chip_8_object->display_wait_timer ? until_tick : 0;
+        case OPCODE_SKIP_IF_KEY:
+        case OPCODE_SKIP_IF_NOT_KEY:
+            return (u32)PC + 4 <= memory_end ? key_poll_cycles(chip_8_object, PC, budget) : 0;
+        case OPCODE_READ_DELAY:
+            return (u32)PC + 6 <= memory_end ? timer_poll_cycles(chip_8_object, PC, until_tick) : 0;
+        case OPCODE_SKIP_IF_EQUAL_IMMEDIATE:
+        case OPCODE_SKIP_IF_NOT_EQUAL_IMMEDIATE:
+            return (PC >= 2 && (u32)PC + 4 <= memory_end) ? timer_poll_cycles(chip_8_object, PC - 2, until_tick) : 0;
+        default:
+            return 0;
+    }
+
+}
+
+/*
+ * chip8_step function
+ * Expects: chip_8_object to be initialized with a rom loaded and still running (chip8_is_running)
+ * Does: Fetches, decodes and executes exactly one instruction (timers are left to the caller)
+ *
+ */
+void chip8_step(chip_8 *chip_8_object){
+
+    decoded_instruction *decoded = fetch_instruction(chip_8_object, DEBUG_ENABLED);
+    if (CHIP8_PROFILER && chip_8_object->profiler){
+        count_instruction(chip_8_object->profiler, decoded, chip_8_object->PC - 2);
+    }
+    decoded->handler(chip_8_object, decoded);
+
+}
+
+/*
+ * chip8_run function
+ * Expects: chip_8_object to be initialized with a rom loaded
+ * Does: Executes up to cycles instructions ticking the timers every cycles_per_tick of them, stops early if the
+ * program counter leaves the rom and returns how many instructions were executed
+ *
+ */
+uint64_t chip8_run(chip_8 *chip_8_object, uint64_t cycles){
+
+    // The recompiler runs whole blocks natively (debug output and profiling only come from the interpreter) and
+    // covers the 4 KB modes, XO-CHIP's 64 KB of memory and double length instructions stay with the interpreter
+    bool profiling = CHIP8_PROFILER && chip_8_object->profiler;
+    if (chip_8_object->jit && !DEBUG_ENABLED && !profiling && chip_8_object->mode != CHIP8_MODE_XOCHIP){
+        return chip8_jit_run(chip_8_object, cycles);
+    }
+
+    return chip_8_object->profile->run(chip_8_object, cycles);
+
+}
@@ -1,16 +1,19 @@
 #ifndef chip8_core_h
 #define chip8_core_h
-#include <sys/time.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
 
 typedef unsigned char u8;
 typedef unsigned short u16;
 typedef unsigned char b8;
+typedef uint32_t u32;
+typedef uint64_t u64;
 
-// Width of the CHIP-8 display
+// Width of the CHIP-8 display (lores)
 extern const int chip_8_screen_width;
 
-// Height of the CHIP-8 display
+// Height of the CHIP-8 display (lores)
 extern const int chip_8_screen_height;
 
 // CHIP-8 has 4096 bytes of memory
@@ -21,7 +24,70 @@ extern const int rom_start_address;
 
 // Starting memory address for fonts
 #define FONT_START 0x50
-#define MEMORY_SIZE 4096
+// Starting memory address for the SUPER-CHIP 8x10 fonts (right after the small ones)
+#define BIG_FONT_START 0xA0
+
+// Memory of the largest mode (XO-CHIP's 64 KB), CHIP-8 and SUPER-CHIP only address the first 4 KB of it
+#define MEMORY_SIZE 65536
+#define CHIP8_MEMORY_SIZE 4096
+
+// SUPER-CHIP hires display size, every mode's display is stored at this size
+#define CHIP8_HIRES_WIDTH 128
+#define CHIP8_HIRES_HEIGHT 64
+// XO-CHIP draws to two bit planes (CHIP-8 and SUPER-CHIP only ever use the first)
+#define CHIP8_PLANES 2
+
+// Instructions run per 60hz timer tick by default, 11 is the 660 instructions a second the frontend runs at in real time
+#define CHIP8_DEFAULT_CYCLES_PER_TICK 11
+
+// Dispatch engine used by chip8_run, 0 = handler table (portable) 1 = computed goto threaded dispatch (GCC/Clang)
+#ifndef CHIP8_DISPATCH_GOTO
+#define CHIP8_DISPATCH_GOTO 0
+#endif
+
+// Build with CHIP8_DEBUG=0 (make DEBUG=0) to compile every debug print out of the core
+#ifndef CHIP8_DEBUG
+#define CHIP8_DEBUG 1
+#endif
+
+// Build with CHIP8_PROFILER=1 (make PROFILER=1) to compile in the execution profiler (see chip_8_profiler.h),
+// otherwise every profiler count is compiled out of the core
+#ifndef CHIP8_PROFILER
+#define CHIP8_PROFILER 0
+#endif
+
+// DEBUG FLAG
+extern bool debug;
+
+/*
+ * chip8_mode enum
+ * Expects: N/A
+ * Does: Which machine a chip 8 emulates, picked per rom before it's loaded (see chip8_set_mode)
+ *   CHIP8   the original 64x32 with 4 KB of memory
+ *   SCHIP   SUPER-CHIP 1.1, adds 128x64 hires, scrolling, 16x16 sprites, big fonts and RPL flags
+ *   XOCHIP  XO-CHIP, SUPER-CHIP plus 64 KB of memory, two bit planes, F000 NNNN and the audio pattern registers
+ */
+typedef enum chip8_mode {
+    CHIP8_MODE_CHIP8,
+    CHIP8_MODE_SCHIP,
+    CHIP8_MODE_XOCHIP
+} chip8_mode;
+
+// True when the core should print what it's doing
+#define DEBUG_ENABLED (CHIP8_DEBUG && debug)
+
+// Flag for flag register to be reset by 8xy1, 8xy2, 8xy3
+extern bool vf_reset_quirk;
+// Flag for Fx55 and Fx65 to increment index register
+extern bool memory_quirk;
+// Flag for capping drawing sprites to 60hz (simplification)
+extern bool display_wait_quirk;
+// Flag to enable sprites to clip instead of wrap
+extern bool clipping_quirk;
+// Flag for 8xy6 and 8xyE to shift V[y] placed into V[x] or just shift V[x] inplace
+extern bool shifting_quirk;
+// Flag for 1nnn to jump to nnn + V[n top nibble] + nnn or nnn + V[0]
+extern bool jumping_quirk;
 
 /*
  * Custom Stack object
@@ -50,15 +116,150 @@ void push (stack *emulated_stack, u16 to_push);
  */
 u16 pop (stack *emulated_stack);
 
+typedef struct chip_8 chip_8;
+typedef struct decoded_instruction decoded_instruction;
+typedef struct chip8_jit chip8_jit;
+typedef struct chip8_profiler chip8_profiler;
+typedef struct chip8_analysis chip8_analysis;
+typedef struct quirk_profile quirk_profile;
+
+/*
+ * CHIP8_OPCODE_LIST macro
+ * Expects: OP to be a macro taking (NAME, handler_suffix)
+ * Does: Lists every opcode the core knows so the enum, handler table and dispatch labels are all generated from one place
+ */
+#define CHIP8_OPCODE_LIST(OP) \
+    OP(IGNORED, ignored) \
+    OP(CLEAR_DISPLAY, clear_display) \
+    OP(RETURN, return) \
+    OP(SCROLL_DOWN, scroll_down) \
+    OP(SCROLL_UP, scroll_up) \
+    OP(SCROLL_RIGHT, scroll_right) \
+    OP(SCROLL_LEFT, scroll_left) \
+    OP(EXIT, exit) \
+    OP(LORES, lores) \
+    OP(HIRES, hires) \
+    OP(JUMP, jump) \
+    OP(CALL, call) \
+    OP(SKIP_IF_EQUAL_IMMEDIATE, skip_if_equal_immediate) \
+    OP(SKIP_IF_NOT_EQUAL_IMMEDIATE, skip_if_not_equal_immediate) \
+    OP(SKIP_IF_EQUAL_REGISTER, skip_if_equal_register) \
+    OP(SAVE_RANGE, save_range) \
+    OP(LOAD_RANGE, load_range) \
+    OP(SET_IMMEDIATE, set_immediate) \
+    OP(ADD_IMMEDIATE, add_immediate) \
+    OP(SET_REGISTER, set_register) \
+    OP(OR, or) \
+    OP(AND, and) \
+    OP(XOR, xor) \
+    OP(ADD_REGISTER, add_register) \
+    OP(SUBTRACT_REGISTER, subtract_register) \
+    OP(SHIFT_RIGHT, shift_right) \
+    OP(SUBTRACT_REVERSED, subtract_reversed) \
+    OP(SHIFT_LEFT, shift_left) \
+    OP(SKIP_IF_NOT_EQUAL_REGISTER, skip_if_not_equal_register) \
+    OP(SET_INDEX, set_index) \
+    OP(JUMP_OFFSET, jump_offset) \
+    OP(RANDOM, random) \
+    OP(DRAW, draw) \
+    OP(EXTENDED_DRAW, extended_draw) \
+    OP(SKIP_IF_KEY, skip_if_key) \
+    OP(SKIP_IF_NOT_KEY, skip_if_not_key) \
+    OP(LONG_SKIP, long_skip) \
+    OP(LONG_INDEX, long_index) \
+    OP(SELECT_PLANES, select_planes) \
+    OP(AUDIO_PATTERN, audio_pattern) \
+    OP(READ_DELAY, read_delay) \
+    OP(WAIT_FOR_KEY, wait_for_key) \
+    OP(SET_DELAY, set_delay) \
+    OP(SET_SOUND, set_sound) \
+    OP(ADD_INDEX, add_index) \
+    OP(FONT, font) \
+    OP(BIG_FONT, big_font) \
+    OP(PITCH, pitch) \
+    OP(BCD, bcd) \
+    OP(STORE_REGISTERS, store_registers) \
+    OP(LOAD_REGISTERS, load_registers) \
+    OP(SAVE_FLAGS, save_flags) \
+    OP(LOAD_FLAGS, load_flags)
+
+#define CHIP8_OPCODE_ENUM(name, handler) OPCODE_##name,
+typedef enum chip8_opcode {
+    CHIP8_OPCODE_LIST(CHIP8_OPCODE_ENUM)
+    OPCODE_COUNT
+} chip8_opcode;
+#undef CHIP8_OPCODE_ENUM
+
+/*
+ * opcode_handler type
+ * Expects: the PC to already point past the instruction being executed
+ * Does: Executes one decoded instruction against the chip 8
+ */
+typedef void (*opcode_handler)(chip_8 *chip_8_object, const decoded_instruction *decoded);
+
+/*
+ * quirk_profile struct
+ * Expects: N/A
+ * Does: A copy of the opcode handlers and run loop generated with one set of quirks baked in as constants
+ */
+struct quirk_profile {
+
+    const char *name;
+
+    // The quirk globals this profile was generated for
+    bool vf_reset;
+    bool memory;
+    bool display_wait;
+    bool clipping;
+    bool shifting;
+    bool jumping;
+
+    // Handlers indexed by chip8_opcode
+    const opcode_handler *handlers;
+
+    // chip8_run for this profile
+    uint64_t (*run)(chip_8 *chip_8_object, uint64_t cycles);
+
+};
+
+/*
+ * decoded_instruction struct
+ * Expects: handler to be NULL when the entry hasn't been decoded (or was written over)
+ * Does: Holds an instruction with its handler picked and its operands already pulled out of the nibbles
+ */
+struct decoded_instruction {
+    opcode_handler handler;
+    // Which opcode handler is (used by the threaded dispatch engine)
+    u8 opcode;
+    // The raw instruction (kept for debug output)
+    u16 instruction;
+    // Lowest 12 bits, an address
+    u16 nnn;
+    // Second nibble, a register
+    u8 x;
+    // Third nibble, a register
+    u8 y;
+    // Lowest nibble
+    u8 n;
+    // Lowest byte
+    u8 nn;
+    // The skip a LONG_SKIP runs (XO-CHIP's skips over a double length F000 NNNN)
+    u8 skipped_opcode;
+};
+
 /*
  * chip_8 struct
  * Expects: N/A
  * Does: Defines the structure of the CHIP-8 emulator, including memory, registers, stack, and display
  */
-typedef struct chip_8 {
+struct chip_8 {
 
-    // The Chip 8's memory
+    // The Chip 8's memory, only the first memory_mask + 1 bytes are addressable in the current mode
     u8 memory[MEMORY_SIZE];
+    u32 memory_mask;
+
+    // Which machine is being emulated (a chip8_mode)
+    u8 mode;
 
     // The Chip 8's registers
     u8 V[16];
@@ -80,27 +281,74 @@ typedef struct chip_8 {
     // display wait timer used to emulate the chip 8s display wait quirk
     u8 display_wait_timer;
 
-    //SPECIAL VALUE USED FOR TIME
-    unsigned long last_update;
+    // The timers tick every cycles_per_tick instructions executed (not off the wall clock) so they keep
+    // pace with the instructions at any speed, cycles_until_tick counts down to the next tick
+    u32 cycles_per_tick;
+    u32 cycles_until_tick;
+
+    // The Chip 8's display, per bit plane 64 rows of two words (128 pixels) with the leftmost pixel in the highest
+    // bit of the first word. Lores (64 x 32) only uses the first word of the first 32 rows
+    u64 display[CHIP8_PLANES][CHIP8_HIRES_HEIGHT][2];
+
+    // SUPER-CHIP 128 x 64 mode, and the bit planes XO-CHIP draws, clears and scrolls (bit N = plane N)
+    bool hires;
+    u8 planes;
+
+    // One bit per display row (bit N = row N) set when that row changed, cleared by whoever consumes the display
+    u64 dirty_rows;
 
-    // The Chip 8's display (64 x 32 pixels)
-    b8 display[64 * 32];
+    // Sprites drawn (DXYN) since chip8_init, always counted for the frontend's metrics
+    u64 sprites_drawn;
 
-    // boolean to denote if something changed in the display_array
-    bool display_has_changed;
+    // SUPER-CHIP RPL user flags (Fx75/Fx85) and XO-CHIP's 16 byte audio pattern and pitch (F002/Fx3A)
+    u8 rpl_flags[16];
+    u8 audio_pattern[16];
+    u8 pitch;
 
-    struct timespec when_key_last_pressed[16];
+    // Keys held down this frame, bit N = key N, set by the frontend (or a movie) through chip8_set_keys
+    u16 keys_down;
 
+    // Keys that went down since Fx0A started waiting, oldest first, and whether an Fx0A is waiting
+    u8 key_presses[16];
+    u8 key_press_head;
+    u8 key_press_count;
+    bool waiting_for_key;
 
-} chip_8;
+    // Address one past the last byte of the loaded rom, 00FD sets it to 0 to stop the program
+    u32 rom_end;
+
+    // Seed the rng was last started from (what movies record) and the PCG32 state 0xC draws from, kept per instance
+    // so parallel instances don't share it and the same seed gives the same sequence on every host
+    u32 rng_seed;
+    u64 rng_state;
+
+    // Optional dynamic recompiler (see chip_8_jit.h), NULL runs the interpreter
+    chip8_jit *jit;
+
+    // Optional execution profiler (see chip_8_profiler.h), only looked at in CHIP8_PROFILER builds
+    chip8_profiler *profiler;
+
+    // Optional static analysis of the loaded rom (see chip_8_analysis.h) and one bit per address whose flags were
+    // worked out from memory written since it was attached
+    const chip8_analysis *analysis;
+    u64 analysis_stale[MEMORY_SIZE / 64];
+
+    // Handlers and run loop specialized for the quirks in use, picked by chip8_init and chip8_load_rom_bytes
+    const quirk_profile *profile;
+
+    // Decoded instructions keyed by the address they were fetched from, kept last as at 1.5 MB only the mode's
+    // memory_mask + 1 entries of it are ever cleared (by chip8_load_rom_bytes), chip8_init leaves it alone
+    decoded_instruction decode_cache[MEMORY_SIZE];
+
+};
 
 /*
  * update_time_registers function
- * Exxpects: chip 8 object to be correctly initialized
- * Does: If a second has passed we decrement any timers above 0 by 1
+ * Exxpects: cycles to be how many instructions just ran (none of which looked at the timers after a tick was due)
+ * Does: Counts the instructions towards the next timer tick, ticking the timers for every cycles_per_tick passed
  *
  */
-void update_time_registers(chip_8 *chip_8_object);
+void update_time_registers(chip_8 *chip_8_object, uint64_t cycles);
 
 /*
  * print_chip_8_contents function
@@ -110,6 +358,234 @@ void update_time_registers(chip_8 *chip_8_object);
  */
 int print_chip_8_contents(chip_8 *chip_8_instance);
 
+/*
+ * chip8_display_width function
+ * Expects: NA
+ * Does: Returns how many pixels wide the display is right now (64 lores, 128 hires)
+ *
+ */
+static inline int chip8_display_width(const chip_8 *chip_8_object){
+    return chip_8_object->hires ? CHIP8_HIRES_WIDTH : chip_8_screen_width;
+}
+
+/*
+ * chip8_display_height function
+ * Expects: NA
+ * Does: Returns how many pixels tall the display is right now (32 lores, 64 hires)
+ *
+ */
+static inline int chip8_display_height(const chip_8 *chip_8_object){
+    return chip_8_object->hires ? CHIP8_HIRES_HEIGHT : chip_8_screen_height;
+}
+
+/*
+ * chip8_get_pixel_planes function
+ * Expects: x and y to be inside chip8_display_width/height
+ * Does: Returns which planes are lit at x, y (bit N = plane N), 0 is background
+ *
+ */
+static inline u8 chip8_get_pixel_planes(const chip_8 *chip_8_object, int x, int y){
+    int shift = 63 - (x & 63);
+    return ((chip_8_object->display[0][y][x >> 6] >> shift) & 1) |
+           (((chip_8_object->display[1][y][x >> 6] >> shift) & 1) << 1);
+}
+
+/*
+ * chip8_get_pixel function
+ * Expects: x and y to be inside chip8_display_width/height
+ * Does: Returns true if the pixel at x, y is lit in the first plane
+ *
+ */
+static inline bool chip8_get_pixel(const chip_8 *chip_8_object, int x, int y){
+    return (chip_8_object->display[0][y][x >> 6] >> (63 - (x & 63))) & 1;
+}
+
+/*
+ * chip8_init function
+ * Expects: chip_8_object to point at writable memory, a rom to be loaded (chip8_load_rom_bytes) before it runs
+ * Does: Blanks the chip 8 (but for the decode cache, loading the rom clears that), points the PC at the rom start,
+ * loads the fonts and readies the stack, timers and keys
+ *
+ */
+void chip8_init(chip_8 *chip_8_object);
+
+/*
+ * chip8_set_mode function
+ * Expects: chip_8_object to be initialized with chip8_init and no rom loaded yet
+ * Does: Switches chip_8_object to emulating mode, sizing its memory and loading the big fonts for SUPER-CHIP
+ * and XO-CHIP
+ *
+ */
+void chip8_set_mode(chip_8 *chip_8_object, chip8_mode mode);
+
+/*
+ * chip8_mode_from_name function
+ * Expects: name to be chip8, schip or xochip
+ * Does: Sets *mode to the named mode, returns 0 on success else 1 (after printing why)
+ *
+ */
+int chip8_mode_from_name(const char *name, chip8_mode *mode);
+
+/*
+ * chip8_mode_for_path function
+ * Expects: NA
+ * Does: Returns the mode a rom's file extension calls for, .sc8 SUPER-CHIP, .xo8 XO-CHIP and anything else CHIP-8
+ *
+ */
+chip8_mode chip8_mode_for_path(const char *path);
+
+/*
+ * chip8_mode_name function
+ * Expects: NA
+ * Does: Returns the name of mode as chip8_mode_from_name takes it
+ *
+ */
+const char *chip8_mode_name(chip8_mode mode);
+
+/*
+ * chip8_load_rom_bytes function
+ * Expects: chip_8_object to be initialized with chip8_init (and chip8_set_mode) and rom to hold size bytes of a rom
+ * Does: Copies the rom into memory at rom_start_address (truncating anything that doesn't fit) and records where it ends
+ *
+ */
+void chip8_load_rom_bytes(chip_8 *chip_8_object, const u8 *rom, size_t size);
+
+/*
+ * chip8_load_rom function
+ * Expects: chip_8_object to be initialized with chip8_init (and chip8_set_mode) and path to point at a chip 8 rom
+ * Does: Reads the rom into memory at rom_start_address and records where it ends, returns 0 on success else 1
+ *
+ */
+int chip8_load_rom(chip_8 *chip_8_object, const char *path);
+
+/*
+ * chip8_memory_written function
+ * Expects: address and length to describe bytes of memory something outside the core just wrote
+ * Does: Drops every cached decode and compiled block that read any of those bytes
+ *
+ */
+void chip8_memory_written(chip_8 *chip_8_object, int address, int length);
+
+/*
+ * chip8_is_running function
+ * Expects: chip_8_object to have a rom loaded
+ * Does: Returns true while the program counter is still inside the loaded rom (and 00FD hasn't exited)
+ *
+ */
+bool chip8_is_running(const chip_8 *chip_8_object);
+
+/*
+ * chip8_set_keys function
+ * Expects: keys to have bit N set for every key N (0x0 - 0xF) held down, called once per frame
+ * Does: Sets which keys the chip 8 sees as held until the next call and queues every key that just went down
+ * for a waiting Fx0A
+ *
+ */
+void chip8_set_keys(chip_8 *chip_8_object, u16 keys);
+
+/*
+ * chip8_key_down function
+ * Expects: key to be 0x0 - 0xF (higher bits are ignored)
+ * Does: Returns true if key is held down
+ *
+ */
+static inline bool chip8_key_down(const chip_8 *chip_8_object, u8 key){
+    return (chip_8_object->keys_down >> (key & 0xF)) & 1;
+}
+
+/*
+ * chip8_tick_timers function
+ * Expects: chip_8_object to be initialized
+ * Does: Counts the delay, sound and display wait timers down by one 60hz tick
+ *
+ */
+void chip8_tick_timers(chip_8 *chip_8_object);
+
+/*
+ * chip8_set_cycles_per_tick function
+ * Expects: cycles_per_tick to be at least 1
+ * Does: Sets how many instructions run per 60hz timer tick and starts counting towards the next tick from zero
+ *
+ */
+void chip8_set_cycles_per_tick(chip_8 *chip_8_object, u32 cycles_per_tick);
+
+/*
+ * chip8_seed_rng function
+ * Expects: chip_8_object to be initialized
+ * Does: Restarts the random numbers 0xC draws from the sequence for seed
+ *
+ */
+void chip8_seed_rng(chip_8 *chip_8_object, u32 seed);
+
+/*
+ * chip8_next_key_press function
+ * Expects: chip_8_object to be correctly initialized
+ * Does: Takes the oldest queued key press and returns it or 0xFF as no key has gone down
+ *
+ */
+u8 chip8_next_key_press(chip_8 *chip_8_object);
+
+/*
+ * chip8_use_quirk_profile function
+ * Expects: name to be cosmac, schip or xochip
+ * Does: Sets the six quirk globals to that profile, returns 0 on success else 1 (after printing why)
+ *
+ */
+int chip8_use_quirk_profile(const char *name);
+
+/*
+ * chip8_profile_name function
+ * Expects: chip_8_object to be initialized
+ * Does: Returns the name of the profile chip_8_object is running with (generic when the quirks match no profile)
+ *
+ */
+const char *chip8_profile_name(const chip_8 *chip_8_object);
+
+/*
+ * chip8_decode_at function
+ * Expects: address to be inside memory
+ * Does: Returns the decoded instruction at address without executing it or touching the PC
+ *
+ */
+const decoded_instruction *chip8_decode_at(chip_8 *chip_8_object, u16 address);
+
+/*
+ * chip8_may_idle_at function
+ * Expects: NA
+ * Does: Returns true if chip8_skip_idle could fast forward with the PC at address given what's in memory now
+ * (whatever the registers, keys and timers hold), false when it's sure to return 0 there
+ *
+ */
+bool chip8_may_idle_at(chip_8 *chip_8_object, u16 address);
+
+/*
+ * chip8_skip_idle function
+ * Expects: until_tick to be the instructions left before the next timer tick and budget the instructions left
+ * to run (until_tick <= budget)
+ * Does: Returns how many instructions the program would spend spinning in an idle loop (jump to self, Fx0A or
+ * a key poll loop with no new input, a Fx07 timer poll loop or a draw held back by display wait) without
+ * changing anything, the caller counts them as executed (and towards the timers) instead of running them
+ *
+ */
+uint64_t chip8_skip_idle(chip_8 *chip_8_object, uint64_t until_tick, uint64_t budget);
+
+/*
+ * chip8_step function
+ * Expects: chip_8_object to be initialized with a rom loaded and still running (chip8_is_running)
+ * Does: Fetches, decodes and executes exactly one instruction (timers are left to the caller)
+ *
+ */
+void chip8_step(chip_8 *chip_8_object);
+
+/*
+ * chip8_run function
+ * Expects: chip_8_object to be initialized with a rom loaded
+ * Does: Executes up to cycles instructions ticking the timers every cycles_per_tick of them, stops early if the
+ * program counter leaves the rom and returns how many instructions were executed
+ *
+ */
+uint64_t chip8_run(chip_8 *chip_8_object, uint64_t cycles);
+
 extern chip_8 chip_8_instance;
 
 #endif /* chip_8_core_h */
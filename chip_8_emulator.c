@@ -16,72 +16,205 @@
 #include "raylib.h"
 #include "timing.h"
 #include "chip_8_core.h"
+#include "headless.h"
+#include "chip_8_jit.h"
+#include "chip_8_analysis.h"
+#include "chip_8_state.h"
+#include "chip_8_rewind.h"
+#include "chip_8_movie.h"
+#include "chip_8_profiler.h"
+#include "chip_8_export.h"
+#include "chip_8_audio.h"
+#include "chip_8_triple_buffer.h"
+#include "chip_8_metrics.h"
 #include <time.h>
 #include <sys/time.h>
 #include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <poll.h>
+#include <unistd.h>
 
-// DEBUG FLAG
-bool debug = false;
+// Flag to pause after each instruction for walkthrough debugging
 bool walk_through_each_instruction = false;
 
-// Flag for flag register to be reset by 8xy1, 8xy2, 8xy3
-bool vf_reset_quirk = true;
-// Flag for Fx55 and Fx65 to increment index register
-bool memory_quirk = true;
-// Flag for capping drawing sprites to 60hz (simplification)
-bool display_wait_quirk = true;
-// Flag to enable sprites to clip instead of wrap
-bool clipping_quirk = true;
-// Flag for 8xy6 and 8xyE to shift V[y] placed into V[x] or just shift V[x] inplace
-bool shifting_quirk = false;
-// Flag for 1nnn to jump to nnn + V[n top nibble] + nnn or nnn + V[0]
-bool jumping_quirk = false;
+// Keyboard key for each CHIP-8 key 0x0 - 0xF (the 4x4 block from 1 to V on a qwerty keyboard)
+static const int keypad_keys[16] = {
+    KEY_X, KEY_ONE, KEY_TWO, KEY_THREE,
+    KEY_Q, KEY_W, KEY_E, KEY_A,
+    KEY_S, KEY_D, KEY_Z, KEY_C,
+    KEY_FOUR, KEY_R, KEY_F, KEY_V
+};
+
+/*
+ * keypad_index function
+ * Expects: key to be a raylib key code
+ * Does: Returns which CHIP-8 key (0x0 - 0xF) the keyboard key is mapped to or -1 if it isn't one
+ *
+ */
+static int keypad_index(int key){
+    for (int i = 0; i < 16; i++){
+        if (keypad_keys[i] == key){
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Rate and buffer size (in samples) of the beeper's stream, 512 samples is about 12 ms of latency
+#define AUDIO_SAMPLE_RATE 44100
+#define AUDIO_BUFFER_SAMPLES 512
+
+// Synthesizer the audio stream's callback pulls from (raylib's callback takes no user pointer)
+static chip8_audio *beeper;
+
+/*
+ * fill_audio_stream function
+ * Expects: to be called by raylib on its audio thread with room for frames mono 16 bit samples
+ * Does: Synthesizes the next frames samples of the beeper
+ *
+ */
+static void fill_audio_stream(void *buffer, unsigned int frames){
+    chip8_audio_fill(beeper, buffer, frames);
+}
+
+/*
+ * display_texture struct
+ * Expects: N/A
+ * Does: Holds the 128x64 texture the CHIP-8 display is uploaded to plus the pixels staged for the upload, low
+ * resolution uses its top left 64x32
+ */
+typedef struct display_texture {
+
+    Texture2D texture;
+    Color pixels[CHIP8_HIRES_WIDTH * CHIP8_HIRES_HEIGHT];
+
+    // Color for each combination of the two planes, 0 is the background and 1 the primary
+    Color palette[4];
+
+    // Size of the display the texture last had uploaded
+    int width;
+    int height;
+
+} display_texture;
+
+/*
+ * load_display_texture function
+ * Expects: the raylib window to be open, palette to hold 4 colors
+ * Does: Creates a 128x64 texture filled with the background color that scales up without smoothing
+ *
+ */
+void load_display_texture(display_texture *screen, const Color *palette){
+
+    memcpy(screen->palette, palette, sizeof(screen->palette));
+    screen->width = chip_8_screen_width;
+    screen->height = chip_8_screen_height;
+    for (int i = 0; i < CHIP8_HIRES_WIDTH * CHIP8_HIRES_HEIGHT; i++){
+        screen->pixels[i] = palette[0];
+    }
+
+    Image image = GenImageColor(CHIP8_HIRES_WIDTH, CHIP8_HIRES_HEIGHT, palette[0]);
+    screen->texture = LoadTextureFromImage(image);
+    UnloadImage(image);
+
+    // Nearest neighbour so each CHIP-8 pixel stays a hard edged square at any scale
+    SetTextureFilter(screen->texture, TEXTURE_FILTER_POINT);
+
+}
 
 /*
  * draw_frame function
- * Expects: a pointer to a chip_8 struct
- * Does: Draws the current state of the CHIP-8 display to the raylib window
+ * Expects: a loaded display texture, frame to be a new frame from the emulation thread or NULL if there isn't one
+ * Does: Uploads the rows of frame that changed since the last frame to the texture (one upload per run of
+ * neighbouring dirty rows) then draws the texture scaled to the window in a single draw call
  *
  */
-int draw_frame(chip_8 *chip_8_object, int scale_factor, Color *primary, Color *background){
+int draw_frame(const chip8_frame *frame, display_texture *screen, int scale_factor){
+
+    // Nothing new means last frame's upload is still valid
+    u64 dirty = 0;
+    if (frame){
+        screen->width = frame->width;
+        screen->height = frame->height;
+        dirty = frame->dirty_rows;
+    }
+    int width = screen->width;
+    int height = screen->height;
 
-    for (int i = 0; i < chip_8_screen_width; i++){
-        for (int j = 0; j < chip_8_screen_height; j++){
-            if (chip_8_object->display[j * chip_8_screen_width + i]){
-                DrawRectangle(i * scale_factor, j * scale_factor, scale_factor, scale_factor, *primary);
-            }
-            else {
-                DrawRectangle(i * scale_factor, j * scale_factor, scale_factor, scale_factor, *background);
+    // Rows past the bottom don't exist in lores
+    if (height < 64){
+        dirty &= ((u64)1 << height) - 1;
+    }
+    while (dirty){
+        // Find the next run of dirty rows
+        int first = __builtin_ctzll(dirty);
+        int last = first;
+        while (last + 1 < height && (dirty >> (last + 1)) & 1){
+            last++;
+        }
+
+        for (int j = first; j <= last; j++){
+            Color *pixel = &screen->pixels[j * CHIP8_HIRES_WIDTH];
+            for (int word = 0; word < width / 64; word++){
+                u64 plane_0 = frame->display[0][j][word];
+                u64 plane_1 = frame->display[1][j][word];
+                for (int i = 0; i < 64; i++){
+                    int color = ((plane_0 >> (63 - i)) & 1) | (((plane_1 >> (63 - i)) & 1) << 1);
+                    pixel[word * 64 + i] = screen->palette[color];
+                }
             }
         }
+
+        Rectangle rows = { 0, (float)first, (float)CHIP8_HIRES_WIDTH, (float)(last - first + 1) };
+        UpdateTextureRec(screen->texture, rows, &screen->pixels[first * CHIP8_HIRES_WIDTH]);
+
+        // Drop the run we just uploaded (last can be 63 so shift in two steps)
+        dirty = (dirty >> last >> 1) << last << 1;
     }
 
-    chip_8_object->display_has_changed = false;
+    // The window stays the same size in both resolutions, hires pixels are just half as big
+    Rectangle source = { 0, 0, (float)width, (float)height };
+    Rectangle dest = { 0, 0, (float)(chip_8_screen_width * scale_factor), (float)(chip_8_screen_height * scale_factor) };
+    Vector2 origin = { 0, 0 };
+    DrawTexturePro(screen->texture, source, dest, origin, 0.0f, WHITE);
+
     return 0;
 
 }
 
 /*
- * get_most_recent_input function
- * Expects: chip_8_object to be correctly initialized
- * Does: Returns which character has been pressed most recently (cap 200 ms old) or 0xFF as none were pressed
+ * draw_metrics_overlay function
+ * Expects: to be called between BeginDrawing and EndDrawing
+ * Does: Draws the metrics summary over the top left of the window, times in ms
  *
  */
-u8 get_most_recent_input(chip_8 *chip_8_object) {
-    // max age in ms
-    int most_recent_age = 20;
-    // default if no key is recent
-    u8 recent_key = 0xFF;
-    struct timespec temp;
-
-    for (int i = 0; i < 16; i++) {
-        int age = millis_since(chip_8_object->when_key_last_pressed[i]);
-        if (age < most_recent_age) {
-            most_recent_age = age;
-            recent_key = i;
-        }
+void draw_metrics_overlay(const chip8_metrics_summary *summary){
+
+    const chip8_histogram_summary *execute = &summary->histograms[CHIP8_HISTOGRAM_EXECUTE];
+    const chip8_histogram_summary *present = &summary->histograms[CHIP8_HISTOGRAM_PRESENT];
+    const chip8_histogram_summary *overshoot = &summary->histograms[CHIP8_HISTOGRAM_SLEEP_OVERSHOOT];
+    const chip8_histogram_summary *latency = &summary->histograms[CHIP8_HISTOGRAM_INPUT_LATENCY];
+    // Own buffers, raylib's TextFormat only keeps a few results alive at once
+    char lines[5][96];
+    snprintf(lines[0], sizeof(lines[0]), "IPS %.0f  frames/s %.1f  draws/s %.1f  sprites/s %.0f",
+             summary->per_second[CHIP8_COUNTER_INSTRUCTIONS], summary->per_second[CHIP8_COUNTER_FRAMES],
+             summary->per_second[CHIP8_COUNTER_PRESENTS], summary->per_second[CHIP8_COUNTER_SPRITES]);
+    snprintf(lines[1], sizeof(lines[1]), "emulate  p50 %.3f  p99 %.3f  max %.3f", execute->p50_ns / 1e6,
+             execute->p99_ns / 1e6, execute->max_ns / 1e6);
+    snprintf(lines[2], sizeof(lines[2]), "present  p50 %.3f  p99 %.3f  max %.3f", present->p50_ns / 1e6,
+             present->p99_ns / 1e6, present->max_ns / 1e6);
+    snprintf(lines[3], sizeof(lines[3]), "oversleep  p50 %.3f  p99 %.3f  max %.3f", overshoot->p50_ns / 1e6,
+             overshoot->p99_ns / 1e6, overshoot->max_ns / 1e6);
+    snprintf(lines[4], sizeof(lines[4]), "input  p50 %.3f  p99 %.3f  max %.3f", latency->p50_ns / 1e6,
+             latency->p99_ns / 1e6, latency->max_ns / 1e6);
+    int line_count = (int)(sizeof(lines) / sizeof(lines[0]));
+
+    // Dark backing so the text reads over any palette
+    Rectangle backing = { 0, 0, 330, (float)(line_count * 12 + 6) };
+    DrawRectangleRec(backing, Fade(BLACK, 0.7f));
+    for (int i = 0; i < line_count; i++){
+        DrawText(lines[i], 4, 4 + i * 12, 10, WHITE);
     }
-    return recent_key;
 
 }
 
@@ -120,6 +253,220 @@ Color get_color_from_name(const char *color_name){
 
 }
 
+// Hotkeys the render thread passes to the emulation thread (F1 save state, F2 load state)
+#define HOTKEY_SAVE_STATE 1u
+#define HOTKEY_LOAD_STATE 2u
+
+/*
+ * emulation_thread struct
+ * Expects: N/A
+ * Does: Everything the emulation thread runs with. The render thread only ever touches the atomics and takes
+ * frames out of the triple buffer, the rest belongs to the emulation thread until it's joined
+ */
+typedef struct emulation_thread {
+
+    chip_8 *chip_8_object;
+    chip8_movie *movie;
+    chip8_rewind *rewind_buffer;
+    chip8_profiler *profiler;
+    chip8_metrics *metrics;
+    const char *state_path;
+
+    // Instructions per 60hz frame, fractional speeds carry the remainder over to the next frame
+    double cycles_per_frame;
+
+    // Render thread to emulation thread: CHIP-8 keys held (bit N = key N), keys that went down since the
+    // emulation thread last looked (so a tap shorter than a frame still lands), hotkeys waiting to be acted on
+    // and backspace held for rewinding
+    atomic_uint keys_held;
+    atomic_uint keys_pressed;
+    // When the oldest of keys_pressed went down (0 = none waiting), for the input latency
+    atomic_ullong keys_pressed_ns;
+    atomic_uint hotkeys;
+    atomic_bool rewinding;
+    atomic_bool quit;
+
+    // Emulation thread to render thread: every finished frame and whether the rom has ended
+    chip8_triple_buffer frames;
+    atomic_bool finished;
+
+} emulation_thread;
+
+/*
+ * read_walkthrough_command helper function - emulation_main
+ * Expects: input to hold size bytes
+ * Does: Waits for a line on stdin (checking whether the render thread asked to quit every 100ms so closing the
+ * window never waits on the user) and puts it in input without its newline, returns 1 on a line else 0 if stdin
+ * ended or the emulation should quit
+ *
+ */
+static int read_walkthrough_command(emulation_thread *emulation, char *input, int size){
+
+    struct pollfd stdin_poll = { .fd = STDIN_FILENO, .events = POLLIN };
+    while (!atomic_load(&emulation->quit)) {
+        int ready = poll(&stdin_poll, 1, 100);
+        if (ready < 0) {
+            return 0;
+        }
+        if (ready == 0) {
+            continue;
+        }
+        // Readable includes hung up, fgets tells the two apart
+        if (fgets(input, size, stdin) == NULL) {
+            return 0;
+        }
+        // Remove newline if present
+        input[strcspn(input, "\n")] = 0;
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * emulation_main function
+ * Expects: arg to be an emulation_thread set up by main, the render thread to be polling input into it
+ * Does: Runs the chip 8 one 60hz frame at a time on its own clock, publishing every finished frame to the triple
+ * buffer, until the rom ends or the render thread asks it to quit
+ *
+ */
+static void *emulation_main(void *arg){
+
+    emulation_thread *emulation = arg;
+    chip_8 *chip_8_object = emulation->chip_8_object;
+    chip8_movie *movie = emulation->movie;
+    chip8_rewind *rewind_buffer = emulation->rewind_buffer;
+    chip8_profiler *profiler = emulation->profiler;
+    chip8_metrics *metrics = emulation->metrics;
+
+    // Sprites counted so far, the metrics get each frame's new ones
+    u64 sprites_counted = chip_8_object->sprites_drawn;
+
+    // Variable used to hold inputs when in debug mode
+    char input[100];
+
+    double cycle_credit = 0.0;
+
+    // Absolute time the current frame should end at, advanced by exactly one frame each loop
+    struct timespec frame_deadline;
+    clock_gettime(CLOCK_MONOTONIC, &frame_deadline);
+
+    /* Start emulation loop, one pass per 60hz frame */
+
+    // While we haven't read all of the ROM (and the window hasn't been closed)
+    while (chip8_is_running(chip_8_object) && !atomic_load(&emulation->quit)) {
+
+        /* Take the inputs the render thread polled */
+
+        // The core only ever sees this mask so a movie can replay it
+        u16 keys = (u16)(atomic_load(&emulation->keys_held) | atomic_exchange(&emulation->keys_pressed, 0));
+        chip8_set_keys(chip_8_object, keys);
+        unsigned long long pressed_ns = atomic_exchange(&emulation->keys_pressed_ns, 0);
+        if (pressed_ns) {
+            chip8_metrics_record(metrics, CHIP8_HISTOGRAM_INPUT_LATENCY, monotonic_ns() - pressed_ns);
+        }
+
+        // Save state hotkeys
+        unsigned int hotkeys = atomic_exchange(&emulation->hotkeys, 0);
+        if ((hotkeys & HOTKEY_SAVE_STATE) && chip8_save_state_file(chip_8_object, emulation->state_path) == 0) {
+            printf("Saved state to %s\n", emulation->state_path);
+        }
+        if ((hotkeys & HOTKEY_LOAD_STATE) && !movie && chip8_load_state_file(chip_8_object, emulation->state_path) == 0) {
+            printf("Loaded state from %s\n", emulation->state_path);
+        }
+
+        /* Run this frame's instructions */
+
+        unsigned long long execute_start = monotonic_ns();
+
+        cycle_credit += emulation->cycles_per_frame;
+        uint64_t frame_cycles = (uint64_t)cycle_credit;
+        cycle_credit -= (double)frame_cycles;
+        uint64_t executed;
+
+        // Holding backspace steps back a frame per frame instead of running one
+        if (rewind_buffer && !movie && atomic_load(&emulation->rewinding)){
+            executed = 0;
+            chip8_rewind_pop(rewind_buffer, chip_8_object);
+        }
+        // Debug controller that takes input for each instruction to allow instruction by instruction debugging
+        else if (walk_through_each_instruction){
+            executed = 0;
+            while (executed < frame_cycles && chip8_is_running(chip_8_object)){
+                executed += chip8_run(chip_8_object, 1);
+
+                printf("Enter a command: ");
+                fflush(stdout);
+                // Out of input (or quitting) stops stepping, the rest runs at full speed
+                if (!read_walkthrough_command(emulation, input, sizeof(input))){
+                    printf("\nNo more commands, walkthrough stopped\n");
+                    walk_through_each_instruction = false;
+                    break;
+                }
+
+                // If the user just hit enter
+                if (input[0] == '\0'){
+
+                }
+                // The user gave some command
+                else{
+                    if (strcmp(input, "print") == 0){
+                        print_chip_8_contents(chip_8_object);
+
+                    }
+                }
+            }
+        }
+        else {
+            // Run the whole frame's budget in one go (this also updates the time registers)
+            executed = chip8_run(chip_8_object, frame_cycles);
+        }
+
+        unsigned long long execute_ns = monotonic_ns() - execute_start;
+
+        // Replaying the same keys and budgets frame by frame gets back exactly this run
+        if (movie){
+            chip8_movie_record_frame(movie, keys, (uint32_t)frame_cycles);
+        }
+
+        // Remember this frame so it can be rewound to
+        if (rewind_buffer && executed > 0){
+            chip8_rewind_push(rewind_buffer, chip_8_object);
+        }
+
+        // Start or stop the beep (or change its pattern) if the frame changed the sound timer. Only the state at the
+        // end of the frame is passed on: the frame ran in a burst microseconds long and the audio thread only plays
+        // the newest state, so pushing each change mid frame wouldn't start a beep any sooner
+        chip8_audio_update(beeper, chip_8_object);
+
+        // Hand the finished frame to the render thread, never waits on it
+        chip8_triple_buffer_publish(&emulation->frames, chip_8_object);
+
+        /* Keep track of instruction speed */
+
+        // Loading a state or rewinding can take the sprite count back
+        chip8_metrics_add(metrics, CHIP8_COUNTER_INSTRUCTIONS, executed);
+        chip8_metrics_add(metrics, CHIP8_COUNTER_FRAMES, 1);
+        if (chip_8_object->sprites_drawn > sprites_counted) {
+            chip8_metrics_add(metrics, CHIP8_COUNTER_SPRITES, chip_8_object->sprites_drawn - sprites_counted);
+        }
+        sprites_counted = chip_8_object->sprites_drawn;
+        chip8_metrics_record(metrics, CHIP8_HISTOGRAM_EXECUTE, execute_ns);
+
+        /* Sleep once until the frame's deadline */
+        unsigned long long sleep_start = profiler ? monotonic_ns() : 0;
+        long overshoot_ns = sleep_until_next_frame(&frame_deadline, 1000000000L / 60);
+        chip8_metrics_record(metrics, CHIP8_HISTOGRAM_SLEEP_OVERSHOOT, overshoot_ns > 0 ? (u64)overshoot_ns : 0);
+        if (profiler) {
+            chip8_profiler_add_frame(profiler, execute_ns, monotonic_ns() - sleep_start);
+        }
+
+    }
+
+    atomic_store(&emulation->finished, true);
+    return NULL;
+
+}
+
 /*
  * main function
  * Expects: one argument: path to the CHIP-8 ROM file
@@ -130,16 +477,10 @@ int main(int argc, const char * argv[]) {
 
     /* Set up variables for emulation such as arguments */
 
-    // Declare and init our chip_8 struct (blanking it to 0 to prevent bad data)
-    chip_8 chip_8_instance;
-    memset(&chip_8_instance, 0, sizeof(chip_8_instance));
-
-    // Our Emulated stack requires top be init to -1
-    chip_8_instance.emulated_stack.top = -1;
-    // Last update needs to be assigned a value at start up
-    chip_8_instance.last_update = current_ms();
-    // Point out program counter to where the rom starts
-    chip_8_instance.PC = 0x200;
+    // Declare and init our chip_8 struct (blanking it to 0 to prevent bad data, loading fonts), static as the
+    // 1.5 MB decode cache is too big for the stack
+    static chip_8 chip_8_instance;
+    chip8_init(&chip_8_instance);
 
     // Argument validation
     if(argc < 2) {
@@ -151,7 +492,22 @@ int main(int argc, const char * argv[]) {
         printf("Expected behavior is ./chip_8_emulator arguments path_to_ch8_rom\n");
         printf("arguments are -BGCOLOR = any raylib color, -PCOLOR = any raylib color\n");
         printf("-SPEED=float, -SCALE_FACTOR=int, -debug=bool, -walkthrough=bool \n");
+        printf("-cycles_per_tick=int instructions per 60hz timer tick (default 11, realtime speed is 60x this a second)\n");
+        printf("-P2COLOR, -P3COLOR = any raylib color for XO-CHIP's second plane and both planes together\n");
+        printf("-MODE=chip8|schip|xochip machine to emulate (default by rom extension .ch8, .sc8 or .xo8, sets the matching profile)\n");
+        printf("-profile=cosmac|schip|xochip sets all of the quirks below at once\n");
         printf("-vf_reset=bool, -memory_quirk=bool, -display_wait=bool, -clipping_quirk=bool, shifting_quirk=bool, -jumping_quirk=bool\n");
+        printf("-jit=bool runs the core through the x86-64 recompiler\n");
+        printf("-record=path records every frame's input to a movie, -replay=path replays one headless as fast as possible\n");
+        printf("-profiler=path writes an execution profile to path as JSON (and a report to the terminal) on exit, needs make PROFILER=1\n");
+        printf("-export=path writes every frame of a -replay (or into a directory with --headless), -export_format=raw|png|gif ");
+        printf("(default by extension .c8f, .png or .gif), -export_changed=bool only frames the display changed in\n");
+        printf("-analyze prints the rom's disassembly and control flow graph, -analysis_cache=dir caches every rom's analysis in dir ");
+        printf("and hands it to the decode cache, jit and idle loop detector (also with -replay and --headless)\n");
+        printf("-metrics=path|unix:path writes pacing metrics as JSON every -metrics_interval=int ms (default 1000) to a file or UNIX socket\n");
+        printf("While running F1 saves the state to rom.ch8.state and F2 loads it back, hold backspace to rewind, F3 shows the metrics\n");
+        printf("--headless runs without a window or audio on a rom or a directory of roms with --jobs=int (threads), ");
+        printf("--seeds=int (instances per rom), --cycles=int (instructions per instance), --results=path\n");
         printf("Available colors are: darkgray, maroon, orange, darkgreen, darkblue, darkpurple, darkbrown, ");
         printf("gray, red, gold, lime, blue, violet, brown, lightgray, pink, yellow, green, skyblue, purple, beige, black, white\n");
 
@@ -165,11 +521,23 @@ int main(int argc, const char * argv[]) {
         }
     }
 
-    // Declare and init background and primary Color with defaults
+    // Declare and init background and primary Color with defaults (plus XO-CHIP's second plane and the two overlapping)
     Color background;
     Color primary;
+    Color second_plane;
+    Color both_planes;
     background = WHITE;
     primary = BLACK;
+    second_plane = LIGHTGRAY;
+    both_planes = GRAY;
+
+    // The machine goes by the rom's extension unless -MODE says otherwise, SUPER-CHIP and XO-CHIP roms also
+    // want their own quirks (quirk flags given after still override)
+    chip8_mode mode = chip8_mode_for_path(argv[argc-1]);
+    bool mode_given = false;
+    if (mode != CHIP8_MODE_CHIP8) {
+        chip8_use_quirk_profile(chip8_mode_name(mode));
+    }
 
     // Delcare and init scale factor with a default of 10 (modest)
     int scale_factor;
@@ -179,9 +547,38 @@ int main(int argc, const char * argv[]) {
     float speed_scaler;
     speed_scaler = 1.0f;
 
+    // Instructions per 60hz timer tick, realtime is 60 ticks a second so this also sets the instructions per second
+    int cycles_per_tick = CHIP8_DEFAULT_CYCLES_PER_TICK;
+
     // Debug used to hold end location of strings as their proccessed into none string data
     char *endptr;
 
+    // Run the core through the recompiler instead of the interpreter
+    bool use_jit = false;
+
+    // Movie to record this session to, or to replay instead of opening a window
+    const char *record_path = NULL;
+    const char *replay_path = NULL;
+
+    // Where to write the execution profile on exit (NULL = don't profile)
+    const char *profiler_path = NULL;
+
+    // Where and how often the metrics are dumped as JSON (NULL = only the F3 overlay shows them)
+    const char *metrics_path = NULL;
+    long metrics_interval_ms = 1000;
+
+    // Print the rom's static analysis instead of running it, and where analyses are cached (NULL = not analysed)
+    bool analyze = false;
+    const char *analysis_cache = NULL;
+
+    // Frames exported from -replay and --headless runs (NULL path = none), the format goes by the path unless given
+    chip8_export_options export_options = chip8_export_default_options();
+    bool export_format_given = false;
+
+    // Headless batch mode and its options
+    bool headless = false;
+    headless_options batch_options = headless_default_options();
+
     /* Process all our arguments as requested */
     for (int i = 1; i < argc; i++) {
         // if a background color is requested set it
@@ -194,6 +591,28 @@ int main(int argc, const char * argv[]) {
             primary = get_color_from_name(argv[i] + 8);
             printf("Primary color: %s\n", argv[i] + 8);
         }
+        // else if a color for XO-CHIP's second plane is requested set it
+        else if (strncmp(argv[i], "-P2COLOR=", 9) == 0) {
+            second_plane = get_color_from_name(argv[i] + 9);
+            printf("Second plane color: %s\n", argv[i] + 9);
+        }
+        // else if a color for pixels set in both XO-CHIP planes is requested set it
+        else if (strncmp(argv[i], "-P3COLOR=", 9) == 0) {
+            both_planes = get_color_from_name(argv[i] + 9);
+            printf("Both planes color: %s\n", argv[i] + 9);
+        }
+        // else if a machine is requested set it along with its quirk profile (later quirk flags still override)
+        else if (strncmp(argv[i], "-MODE=", 6) == 0) {
+            if (chip8_mode_from_name(argv[i] + 6, &mode)) {
+                printf("Error: -MODE must be chip8, schip or xochip.\n");
+                return 1;
+            }
+            if (mode != CHIP8_MODE_CHIP8) {
+                chip8_use_quirk_profile(chip8_mode_name(mode));
+            }
+            mode_given = true;
+            printf("Mode: %s\n", chip8_mode_name(mode));
+        }
         // else if a speed is requested set it
         else if (strncmp(argv[i], "-SPEED=", 7) == 0) {
 
@@ -247,6 +666,18 @@ int main(int argc, const char * argv[]) {
 
             debug = value;
         }
+        // else if the number of instructions per timer tick is requested set it
+        else if (strncmp(argv[i], "-cycles_per_tick=", 17) == 0) {
+            long value = strtol(argv[i] + 17, &endptr, 10);
+
+            if (*endptr != '\0' || value <= 0) {
+                printf("Error: -cycles_per_tick must be a positive number.\n");
+                return 1;
+            }
+
+            cycles_per_tick = (int)value;
+            printf("Cycles per tick: %d\n", cycles_per_tick);
+        }
         // else if we got the walkthrough we check if true else always false (bad input = false)
         else if (strncmp(argv[i], "-walkthrough=", 13) == 0) {
             bool value = (strncmp(argv[i] + 13, "true", 4) == 0);
@@ -256,6 +687,13 @@ int main(int argc, const char * argv[]) {
             walk_through_each_instruction = value;
 
         }
+        // else if we got a quirk profile set all six quirks from it (later quirk flags still override)
+        else if (strncmp(argv[i], "-profile=", 9) == 0) {
+            if (chip8_use_quirk_profile(argv[i] + 9)) {
+                return 1;
+            }
+            printf("Quirk profile: %s\n", argv[i] + 9);
+        }
         // else if we got vf_reset quirk (bad input = default)
         else if (strncmp(argv[i], "-vf_reset=", 10) == 0) {
             bool value = (strncmp(argv[i] + 10, "true", 4) == 0);
@@ -364,705 +802,399 @@ int main(int argc, const char * argv[]) {
 
             printf("jumping quirk: %s\n", jumping_quirk ? "true" : "false");
         }
+        // else if we got the jit we check if true else always false (bad input = false)
+        else if (strncmp(argv[i], "-jit=", 5) == 0) {
+            bool value = (strncmp(argv[i] + 5, "true", 4) == 0);
 
-    }
-
-    // last argument should always be path to chip 8 rom
-    FILE *rom = fopen(argv[argc-1], "rb");
-    if (!rom) {
-        printf("Failed to open ROM file: %s\n", argv[argc-1]);
-        return 1;
-    }
+            printf("JIT: %s\n", value ? "true" : "false");
 
-    // Read in the rom to memory and set how many bytes were written into this variable
-    size_t bytes_read = fread(&chip_8_instance.memory[rom_start_address], 1, memory_size - rom_start_address, rom);
-    fclose(rom);
+            use_jit = value;
+        }
+        // else if a movie should be recorded
+        else if (strncmp(argv[i], "-record=", 8) == 0) {
+            record_path = argv[i] + 8;
+        }
+        // else if a movie should be replayed
+        else if (strncmp(argv[i], "-replay=", 8) == 0) {
+            replay_path = argv[i] + 8;
+        }
+        // else if an execution profile is requested
+        else if (strncmp(argv[i], "-profiler=", 10) == 0) {
+            profiler_path = argv[i] + 10;
+        }
+        // else if metrics should be dumped
+        else if (strncmp(argv[i], "-metrics=", 9) == 0) {
+            metrics_path = argv[i] + 9;
+        }
+        // else if a metrics dump interval is requested set it
+        else if (strncmp(argv[i], "-metrics_interval=", 18) == 0) {
+            metrics_interval_ms = strtol(argv[i] + 18, &endptr, 10);
 
-    // Init the window and audio device
-    InitWindow(64 * scale_factor, 32 * scale_factor, "CHIP-8 Emulator");
-    InitAudioDevice();
+            if (*endptr != '\0' || metrics_interval_ms <= 0) {
+                printf("Error: -metrics_interval must be a positive number of ms.\n");
+                return 1;
+            }
+        }
+        // else if the rom should be analysed instead of run
+        else if (strcmp(argv[i], "-analyze") == 0) {
+            analyze = true;
+        }
+        // else if an analysis cache directory is requested set it
+        else if (strncmp(argv[i], "-analysis_cache=", 16) == 0) {
+            analysis_cache = argv[i] + 16;
+        }
+        // else if frames should be exported
+        else if (strncmp(argv[i], "-export=", 8) == 0) {
+            export_options.path = argv[i] + 8;
+        }
+        // else if an export format is requested set it
+        else if (strncmp(argv[i], "-export_format=", 15) == 0) {
+            if (chip8_export_format_from_name(argv[i] + 15, &export_options.format)) {
+                return 1;
+            }
+            export_format_given = true;
+        }
+        // else if only changed frames should be exported we check if true else always false (bad input = false)
+        else if (strncmp(argv[i], "-export_changed=", 16) == 0) {
+            export_options.changed_only = (strncmp(argv[i] + 16, "true", 4) == 0);
+        }
+        // else if headless batch mode was requested
+        else if (strcmp(argv[i], "--headless") == 0) {
+            headless = true;
+        }
+        // else if a worker thread count for headless mode is requested set it
+        else if (strncmp(argv[i], "--jobs=", 7) == 0) {
+            long value = strtol(argv[i] + 7, &endptr, 10);
 
-    // Load sound file for our chip 8's emulated sound
-    Sound beep = LoadSound("beep.wav");
+            if (*endptr != '\0' || value <= 0) {
+                printf("Error: --jobs must be a positive number.\n");
+                return 1;
+            }
 
-    // Variable used to hold the next read instruction from memory
-    unsigned short instruction;
-    // Temporary variable used to work on instructions
-    u8 temporary_u8;
+            batch_options.jobs = (int)value;
+        }
+        // else if a seed count for headless mode is requested set it
+        else if (strncmp(argv[i], "--seeds=", 8) == 0) {
+            long value = strtol(argv[i] + 8, &endptr, 10);
 
-    // Holds the instructions per second
-    int instructions_performed_last_second;
+            if (*endptr != '\0' || value <= 0) {
+                printf("Error: --seeds must be a positive number.\n");
+                return 1;
+            }
 
-    // Variable used to hold whatever key has been pressed
-    u8 current_key_pressed;
+            batch_options.seeds = (unsigned int)value;
+        }
+        // else if a cycle budget for headless mode is requested set it
+        else if (strncmp(argv[i], "--cycles=", 9) == 0) {
+            unsigned long long value = strtoull(argv[i] + 9, &endptr, 10);
 
-    // timespec variable used to hold WHEN we should draw our NEXT frame
-    struct timespec when_next_frame;
-    // Init it as we need to draw our first frame to get raylib to start a window
-    clock_gettime(CLOCK_MONOTONIC, &when_next_frame);
+            if (*endptr != '\0' || value == 0) {
+                printf("Error: --cycles must be a positive number.\n");
+                return 1;
+            }
 
-    // Init all input keys as if they were pressed 1000 seconds ago
-    for (int i = 0; i < 16; i++){
-        // make it “old” so it won’t trigger again until pressed
-        chip_8_instance.when_key_last_pressed[i].tv_sec -= 1000; // 1000s ago
+            batch_options.cycles = value;
+        }
+        // else if a results file for headless mode is requested set it
+        else if (strncmp(argv[i], "--results=", 10) == 0) {
+            batch_options.results_path = argv[i] + 10;
+        }
 
     }
 
-    // Variables used to pick indexes on our emulated display
-    u8 x_coordinate;
-    u8 y_coordinate;
-
-    // Variable used to hold inputs when in debug mode
-    char input[100];
-
-    // Variables to control how much time between each instructions given a 660 as realtime with
-    // a scaler if we want to run faster than realtime
-    float instruction_per_second = speed_scaler * 660.0f;
-    float time_per_instruction_ms =  1000.0f / instruction_per_second;
-
-    // float used to adjust instruction timing to be closer to our goal ips
-    float adjustment_ratio;
-    // Since code execution (emulator), chip 8 execution, and inaccuracy of sleep we give some wiggle room
-    time_per_instruction_ms += ((float)time_per_instruction_ms * -.15);
-
-    // Variable used to hold our fonts
-    u8 fonts[16][5] = {
-        {0xF0, 0x90, 0x90, 0x90, 0xF0}, // 0
-        {0x20, 0x60, 0x20, 0x20, 0x70}, // 1
-        {0xF0, 0x10, 0xF0, 0x80, 0xF0}, // 2
-        {0xF0, 0x10, 0xF0, 0x10, 0xF0}, // 3
-        {0x90, 0x90, 0xF0, 0x10, 0x10}, // 4
-        {0xF0, 0x80, 0xF0, 0x10, 0xF0}, // 5
-        {0xF0, 0x80, 0xF0, 0x90, 0xF0}, // 6
-        {0xF0, 0x10, 0x20, 0x40, 0x40}, // 7
-        {0xF0, 0x90, 0xF0, 0x90, 0xF0}, // 8
-        {0xF0, 0x90, 0xF0, 0x10, 0xF0}, // 9
-        {0xF0, 0x90, 0xF0, 0x90, 0x90}, // A
-        {0xE0, 0x90, 0xE0, 0x90, 0xE0}, // B
-        {0xF0, 0x80, 0x80, 0x80, 0xF0}, // C
-        {0xE0, 0x90, 0x90, 0x90, 0xE0}, // D
-        {0xF0, 0x80, 0xF0, 0x80, 0xF0}, // E
-        {0xF0, 0x80, 0xF0, 0x80, 0x80}  // F
-    };
-    // Set the fonts to be inside our emulated chip 8s memory starting at FONT_START (0x50)
-    for (int i = 0; i < 16; i++) {
-        for (int j = 0; j < 5; j++) {
-            chip_8_instance.memory[FONT_START + i * 5 + j] = fonts[i][j];
+    // Exported frames use the window's colors
+    if (export_options.path) {
+        Color colors[4] = { background, primary, second_plane, both_planes };
+        for (int i = 0; i < 4; i++) {
+            export_options.palette[i][0] = colors[i].r;
+            export_options.palette[i][1] = colors[i].g;
+            export_options.palette[i][2] = colors[i].b;
+        }
+        if (!export_format_given) {
+            export_options.format = chip8_export_format_for_path(export_options.path);
+        }
+        if (!headless && !replay_path) {
+            printf("Error: -export only works with -replay or --headless.\n");
+            return 1;
         }
     }
 
-    /* Set up our graphics */
-
-    // Init the window with a black background
-    BeginDrawing();
-    ClearBackground(background);
-    EndDrawing();
+    // The metrics time the window's frames, runs without one have nothing to measure
+    if (metrics_path && (headless || replay_path)) {
+        printf("Error: -metrics only works with a window.\n");
+        return 1;
+    }
 
-    /* Start emulation loop */
+    // The listing is of one rom as it loads, not of a batch or a movie
+    if (analyze && (headless || replay_path)) {
+        printf("Error: -analyze only works on a single rom.\n");
+        return 1;
+    }
 
-    // While we haven't read all of the ROM
-    while(chip_8_instance.PC < (rom_start_address + bytes_read)) {
+    // Headless mode never opens a window so hand off before we do
+    if (headless) {
+        batch_options.export = export_options;
+        batch_options.jit = use_jit;
+        batch_options.cycles_per_tick = cycles_per_tick;
+        batch_options.analysis_cache = analysis_cache;
+        // Without -MODE each rom in a directory goes by its own extension
+        if (mode_given) {
+            batch_options.mode = mode;
+        }
+        return run_headless(&batch_options, argv[argc-1]);
+    }
+    if (replay_path) {
+        return run_replay(replay_path, argv[argc-1], use_jit, profiler_path, export_options.path ? &export_options : NULL,
+                          analysis_cache);
+    }
 
-        /* Fetch instruction */
+    // The mode decides how much memory there is so it's set before the rom goes in
+    chip8_set_mode(&chip_8_instance, mode);
 
-        // Get the next instruction and increment out PC by 2 (2 byte instruction size)
-        instruction = (chip_8_instance.memory[chip_8_instance.PC] << 8) | chip_8_instance.memory[chip_8_instance.PC + 1];
-        chip_8_instance.PC += 2;
+    // last argument should always be path to chip 8 rom
+    if (chip8_load_rom(&chip_8_instance, argv[argc-1])) {
+        printf("Failed to open ROM file: %s\n", argv[argc-1]);
+        return 1;
+    }
+    if (debug) {
+        printf("Running the %s core\n", chip8_profile_name(&chip_8_instance));
+    }
 
-        // Debug statements
-        if (debug){
-            printf("On instruction address: 0x%04X, which is: 0x%04X\n", chip_8_instance.PC, instruction);
+    // Work out (or fetch from the cache) what the rom does before any of it runs
+    chip8_analysis *analysis = NULL;
+    if (analyze || analysis_cache) {
+        analysis = chip8_analysis_load_or_build(&chip_8_instance, analysis_cache);
+        if (!analysis) {
+            printf("Error: Out of memory for the analysis\n");
+            return 1;
+        }
+        if (analyze) {
+            chip8_analysis_write_listing(analysis, &chip_8_instance, stdout);
+            chip8_analysis_destroy(analysis);
+            return 0;
         }
+        chip8_analysis_attach(&chip_8_instance, analysis);
+    }
 
-        // If our time register is not 0 and we aren't currently playing a sound then we do play a sound
-        if ((chip_8_instance.sound_register > 0) && (!IsSoundPlaying(beep))){
-            PlaySound(beep);
+    // Hand the core a recompiler if asked for and the host supports one
+    chip8_jit *jit = NULL;
+    if (use_jit) {
+        jit = chip8_jit_create();
+        if (jit) {
+            chip8_jit_attach(&chip_8_instance, jit);
         }
-        // If our time register for sound is 0 and or we're playing a sound stop the sound
-        else{
-            StopSound(beep);
+        else {
+            printf("JIT not supported on this host, using the interpreter\n");
         }
+    }
 
-        /* Decode instructions and execute it */
-
-        // Switch case for the instruction we grab the first hex value of the 2 byte instruction
-        switch ((instruction & 0xF000) >> 12){
-            // Cases for 0x0
-            case 0x0:
-                // Switch on the last byte of the instruction
-                switch(instruction & 0x00FF){
-                    // Clear the display
-                    case 0xE0:
-                        memset(chip_8_instance.display, 0, sizeof(chip_8_instance.display));
-                        chip_8_instance.display_has_changed = true;
-                        if (debug) {
-                            printf("Clear the display\n");
-                        }
-                        break;
-
-                    // Need to return from subroutine AKA pop stack and make it the PC
-                    case 0xEE:
-                        chip_8_instance.PC = pop(&chip_8_instance.emulated_stack);
-                        if (debug){
-                            printf("Returing from subroutine to 0x%04X\n", chip_8_instance.PC);
-                        }
-                        break;
-
-                }
-                break;
-
-            // Jump to address NNN
-            case 0x1:
-                chip_8_instance.PC = instruction & 0x0FFF;
-                if (debug){
-                    printf("Jump to address 0x%04X\n", chip_8_instance.PC);
-                }
-                break;
-
-            // this case we actually do a call of the subroutine
-            case 0x2:
-                push(&chip_8_instance.emulated_stack, chip_8_instance.PC);
-                chip_8_instance.PC = instruction & 0x0FFF;
-                if (debug){
-                    printf("Call address 0x%04X\n", chip_8_instance.PC);
-                }
-                break;
-
-            // Skip 1 instruction if the value of Vx is equal to NN
-            case 0x3:
-                if (chip_8_instance.V[(instruction & 0x0F00) >> 8] == (instruction & 0x00FF)){
-                    chip_8_instance.PC += 2;
-                }
-                if (debug){
-                    printf("Checked if 0x%02X is equal to 0x%02X\n", chip_8_instance.V[(instruction & 0x0F00) >> 8], instruction & 0x00FF);
-                }
-                break;
-
-            // Skip 1 instruction if the value Vx is not equal to NN
-            case 0x4:
-                if (chip_8_instance.V[(instruction & 0x0F00) >> 8] != (instruction & 0x00FF)){
-                    chip_8_instance.PC += 2;
-                }
-                if (debug){
-                    printf("Checked if 0x%02X is not equal to 0x%02X\n", chip_8_instance.V[(instruction & 0x0F00) >> 8], instruction & 0x00FF);
-                }
-                break;
-
-            // Skip 1 instruction if Vx and Vy are equal
-            case 0x5:
-                if (chip_8_instance.V[(instruction & 0x0F00) >> 8] == chip_8_instance.V[(instruction & 0x00F0) >> 4]){
-                    chip_8_instance.PC += 2;
-                }
-                if (debug){
-                    printf("Checked if V[%d] = 0x%02X is equal to V[%d] = 0x%02X\n", ((instruction & 0x0F00) >> 8), chip_8_instance.V[(instruction & 0x0F00) >> 8], ((instruction & 0x00F0) >> 4), chip_8_instance.V[(instruction & 0x00F0) >> 4]);
-                }
-                break;
-
-            // Set Vx to NN
-            case 0x6:
-                chip_8_instance.V[(instruction & 0x0F00) >> 8] = instruction & 0x00FF;
-                if (debug){
-                    printf("Set V[%d] to 0x%02X\n", (instruction & 0x0F00) >> 8, instruction & 0x00FF);
-                }
-                break;
-
-            // Add NN to Vx (without carry) and without changing the carry flag
-            case 0x7:
-                chip_8_instance.V[(instruction & 0x0F00) >> 8] = chip_8_instance.V[(instruction & 0x0F00) >> 8] + (instruction & 0x00FF);
-                if (debug){
-                    printf("Add 0x%02X to V[%d], result: 0x%02X\n", instruction & 0x00FF, (instruction & 0x0F00) >> 8, chip_8_instance.V[(instruction & 0x0F00) >> 8]);
-                }
-                break;
-
-            // 0x8 is used for a lot of logical and arthmetic instructions so we switch for each
-            case 0x8:
-                switch (instruction & 0x000F){
-                    // Binary Set operation
-                    case 0x0:
-                        chip_8_instance.V[(instruction & 0x0F00) >> 8] = chip_8_instance.V[(instruction & 0x00F0) >> 4];
-                        if (debug){
-                            printf("Set V[%d] to equal V[%d]\n", ((instruction & 0x0F00) >> 8), ((instruction & 0x00F0) >> 4));
-                        }
-                        break;
-
-                    // Binary Or operation
-                    case 0x1:
-                        chip_8_instance.V[(instruction & 0x0F00) >> 8] = chip_8_instance.V[(instruction & 0x0F00) >> 8] | chip_8_instance.V[(instruction & 0x00F0) >> 4];
-                        if (debug){
-                            printf("Set V[%d] to the or operation of V[%d] | V[%d]\n", ((instruction & 0x0F00) >> 8), ((instruction & 0x0F00) >> 8), ((instruction & 0x00F0) >> 4));
-                        }
-                        if (vf_reset_quirk){
-                            chip_8_instance.V[15] = 0;
-                            if (debug) {
-                                printf("Reset flag register V[15]\n");
-                            }
-                        }
-                        break;
-
-                    // Binary And operation
-                    case 0x2:
-                        chip_8_instance.V[(instruction & 0x0F00) >> 8] = chip_8_instance.V[(instruction & 0x0F00) >> 8] & chip_8_instance.V[(instruction & 0x00F0) >> 4];
-                        if (debug){
-                            printf("Set V[%d] to the and operation of V[%d] & V[%d]\n", ((instruction & 0x0F00) >> 8), ((instruction & 0x0F00) >> 8), ((instruction & 0x00F0) >> 4));
-                        }
-                        if (vf_reset_quirk){
-                            chip_8_instance.V[15] = 0;
-                            if (debug) {
-                                printf("Reset flag register V[15]\n");
-                            }
-                        }
-                        break;
-
-                    // Binary XOR operation
-                    case 0x3:
-                        chip_8_instance.V[(instruction & 0x0F00) >> 8] = chip_8_instance.V[(instruction & 0x0F00) >> 8] ^ chip_8_instance.V[(instruction & 0x00F0) >> 4];
-                        if (debug){
-                            printf("Set V[%d] to the XOR operation of V[%d] ^ V[%d]\n", ((instruction & 0x0F00) >> 8), ((instruction & 0x0F00) >> 8), ((instruction & 0x00F0) >> 4));
-                        }
-                        if (vf_reset_quirk){
-                            chip_8_instance.V[15] = 0;
-                            if (debug) {
-                                printf("Reset flag register V[15]\n");
-                            }
-                        }
-                        break;
-
-                    // Binary addition of registers V[x] and V[y] with overflow setting VF to 1 ELSE its set to 0
-                    case 0x4:
-                        if ((chip_8_instance.V[(instruction & 0x0F00) >> 8] + chip_8_instance.V[(instruction & 0x00F0) >> 4]) > 255){
-                            chip_8_instance.V[(instruction & 0x0F00) >> 8] = (chip_8_instance.V[(instruction & 0x0F00) >> 8] + chip_8_instance.V[(instruction & 0x00F0) >> 4]);
-                            chip_8_instance.V[15] = 1;
-                        }
-                        else {
-                            chip_8_instance.V[(instruction & 0x0F00) >> 8] = (chip_8_instance.V[(instruction & 0x0F00) >> 8] + chip_8_instance.V[(instruction & 0x00F0) >> 4]);
-                            chip_8_instance.V[15] = 0;
-                        }
-                        if (debug){
-                            printf("Added V[%d] with V[%d] placed in V[%d] did overflow: %s\n", (instruction & 0x0F00) >> 8, (instruction & 0x00F0) >> 4, (instruction & 0x0F00) >> 8, (chip_8_instance.V[15] == 1) ? "True" : "False");
-                        }
-                        break;
-
-                    // 8XY5 - VX = VX - VY, VF = NOT borrow
-                    case 0x5:
-                        if (chip_8_instance.V[(instruction & 0x0F00) >> 8] >= chip_8_instance.V[(instruction & 0x00F0) >> 4]){
-                            temporary_u8 = 1;
-                        }
-                        else{
-                            temporary_u8 = 0;
-                        }
-                        chip_8_instance.V[(instruction & 0x0F00) >> 8] -= chip_8_instance.V[(instruction & 0x00F0) >> 4];
-                        chip_8_instance.V[15] = temporary_u8;
-                        if (debug){
-                            printf("Substracted V[%d] from V[%d] placed in V[%d] carry flag: %s\n", (instruction & 0x00F0) >> 4, (instruction & 0x0F00) >> 8, (instruction & 0x0F00) >> 8, (chip_8_instance.V[15] == 1) ? "1" : "0");
-                        }
-                        break;
-
-                    // 8XY7 - VX = VY - VX, VF = NOT borrow
-                    case 0x7:
-                        if (chip_8_instance.V[(instruction & 0x00F0) >> 4] >= chip_8_instance.V[(instruction & 0x0F00) >> 8]){
-                            temporary_u8 = 1;
-                        }
-                        else{
-                            temporary_u8 = 0;
-                        }
-                        chip_8_instance.V[(instruction & 0x0F00) >> 8] = chip_8_instance.V[(instruction & 0x00F0) >> 4] - chip_8_instance.V[(instruction & 0x0F00) >> 8];
-                        chip_8_instance.V[15] = temporary_u8;
-                        if (debug){
-                            printf("Substracted V[%d] from V[%d] placed in V[%d] carry flag: %s\n", (instruction & 0x0F00) >> 8, (instruction & 0x00F0) >> 4, (instruction & 0x0F00) >> 8, (chip_8_instance.V[15] == 1) ? "1" : "0");
-                        }
-                        break;
-
-                    // Shift V[X] by 1 bit (right) if the bit shifted out was 1 set V[F] to 1 else set it to 0
-                    case 0x6:
-                        if (chip_8_instance.V[(instruction & 0x0F00) >> 8] & 0b00000001){
-                            temporary_u8 = 1;
-
-                        }
-                        else{
-                            temporary_u8 = 0;
-                        }
-                        if (shifting_quirk) {
-                            chip_8_instance.V[(instruction & 0x0F00) >> 8] = chip_8_instance.V[(instruction & 0x0F00) >> 8] >> 1;
-                            chip_8_instance.V[15] = temporary_u8;
-                        }
-                        else {
-                            chip_8_instance.V[(instruction & 0x0F00) >> 8] = chip_8_instance.V[(instruction & 0x00F0) >> 4] >> 1;
-                            chip_8_instance.V[15] = chip_8_instance.V[(instruction & 0X00F0) >> 4] & 0b00000001;
-                        }
-
-                        if (debug){
-                            printf("Shifted V[%d] by 1 bit to the right, shifted out %d into V[F]\n", (instruction & 0x0F00) >> 8, chip_8_instance.V[15]);
-                        }
-                        break;
-
-                    // Shift V[X] by 1 bit (left) if the bit shifted out was 1 set V[F] to 1 else set it to 0
-                    case 0xE:
-                        if (chip_8_instance.V[(instruction & 0x0F00) >> 8] & 0b10000000){
-                            temporary_u8 = 1;
-
-                        }
-                        else{
-                            temporary_u8 = 0;
-                        }
-                        if (shifting_quirk) {
-                            chip_8_instance.V[(instruction & 0x0F00) >> 8] = chip_8_instance.V[(instruction & 0x0F00) >> 8] << 1;
-                            chip_8_instance.V[15] = temporary_u8;
-                        }
-                        else {
-                            chip_8_instance.V[(instruction & 0x0F00) >> 8] = chip_8_instance.V[(instruction & 0x00F0) >> 4] << 1;
-                            chip_8_instance.V[15] = (chip_8_instance.V[(instruction & 0X00F0) >> 4] & 0b10000000) >> 7;
-                        }
-
-                        if (debug){
-                            printf("Shifted V[%d] by 1 bit to the left, shifted out %d into V[F]\n", (instruction & 0x0F00) >> 8, chip_8_instance.V[15]);
-                        }
-                        break;
-
-                }
-                break;
-
-            // Skip 1 instruction if Vx and Vy are not equal
-            case 0x9:
-                if (chip_8_instance.V[(instruction & 0x0F00) >> 8] != chip_8_instance.V[(instruction & 0x00F0) >> 4]){
-                    chip_8_instance.PC += 2;
-                }
-                if (debug){
-                    printf("If V[%d] = 0x%02X is not equal to V[%d] = 0x%02X skip an instruction\n", ((instruction & 0x0F00) >> 8), chip_8_instance.V[(instruction & 0x0F00) >> 8], ((instruction & 0x00F0) >> 4), chip_8_instance.V[(instruction & 0x00F0) >> 4]);
-                }
-                break;
-
-            // Set the index register to NNN
-            case 0xA:
-                chip_8_instance.I = (instruction & 0x0FFF);
-                if (debug){
-                    printf("Set I to 0x%03X\n", chip_8_instance.I);
-                }
-
-                break;
-
-            // Jump with an offset (original implementation)
-            case 0xB:
-                if (jumping_quirk) {
-                    chip_8_instance.PC = (instruction & 0x0FFF) + chip_8_instance.V[(instruction & 0X0F00) >> 8];
-                }
-                else {
-                    chip_8_instance.PC = (instruction & 0x0FFF) + chip_8_instance.V[0];
-                }
-               if (debug){
-                   printf("Jump to %d\n", chip_8_instance.PC);
-               }
-               break;
-
-            // Get a random value (0 - 255 inclusive) then binary and it with the two last nibbles of the instruction
-            case 0xC:
-               chip_8_instance.V[(instruction & 0x0F00) >> 8] = GetRandomValue(0, 255) & (instruction & 0x00FF);
-               if (debug){
-                   printf("Got a random int: %d\n", (GetRandomValue(0, 255) & (instruction & 0x00FF)));
-               }
-               break;
-
-            // Case of us writting a sprite to the screen
-            case 0xD:
-                if (chip_8_instance.display_wait_timer == 0){
-
-                    // DXYN
-                    // set the X coordinate to the value in VX (V register N number) modulo 64
-                    x_coordinate = chip_8_instance.V[(instruction & 0x0F00) >> 8] & 63;
-                    y_coordinate = chip_8_instance.V[(instruction & 0x00F0) >> 4] & 31;
-                    chip_8_instance.V[15] = 0;
-
-
-                    for (int i = 0; i < (instruction & 0x000F); i++) {
-                        u8 sprite_data = chip_8_instance.memory[chip_8_instance.I + i];
-                        // wrap
-                        int y = (y_coordinate + i) % chip_8_screen_height;
-                        // if we're not supposed to wrap break if we would
-                        if (clipping_quirk && (y_coordinate + i) > chip_8_screen_height) {
-                            break;
-                        }
-
-                        for (int j = 0; j < 8; j++) {
-                            // wrap
-                            int x = (x_coordinate + j) % chip_8_screen_width;
-                            // if we're not supposed to wrap break if we would
-                            if (clipping_quirk && (x_coordinate + j) > chip_8_screen_width) {
-                                break;
-                            }
-                            if (sprite_data & (0x80 >> j)) {
-                                int display_index = y * chip_8_screen_width + x;
-                                if (chip_8_instance.display[display_index]) {
-                                    chip_8_instance.display[display_index] = 0;
-                                    chip_8_instance.V[15] = 1;
-                                } else {
-                                    chip_8_instance.display[display_index] = 1;
-                                }
-                            }
-                        }
-                    }
-                    chip_8_instance.display_has_changed = true;
-
-                    if (display_wait_quirk) {
-                        chip_8_instance.display_wait_timer += 1;
-                    }
-
-                    if (debug){
-                        printf("Wrote %d tall sprite at X = %d and Y = %d\n", (instruction & 0X00F), (instruction & 0x0F00) >> 8, (instruction & 0x00F0) >> 4);
-                    }
-                }
-                else {
-                    chip_8_instance.PC -= 2;
-                }
-                break;
-
-            // Cases for input (that aren't blocking)
-            case 0xE:
-                // Switch on the last byte
-                switch (instruction & 0x00FF) {
-                    // Skip if key in Vx is pressed
-                    case 0x9E: {
-                        PollInputEvents();
-                        temporary_u8 = chip_8_instance.V[(instruction & 0x0F00) >> 8];
-                        current_key_pressed = get_most_recent_input(&chip_8_instance);
-
-                        if (temporary_u8 == current_key_pressed) {  // check the correct key
-                            chip_8_instance.PC += 2;
-                        }
-
-                        if (debug){
-                            printf("Skip if 0x%01X == 0x%01X\n", temporary_u8, current_key_pressed);
-                        }
-
-                        break;
-                    }
-                    // Skip if key in Vx is NOT pressed
-                    case 0xA1: {
-                        PollInputEvents();
-                        temporary_u8 = chip_8_instance.V[(instruction & 0x0F00) >> 8];
-                        current_key_pressed = get_most_recent_input(&chip_8_instance);
-
-                        if (!((temporary_u8 == current_key_pressed) && (temporary_u8 != 0xFF))) {
-                            chip_8_instance.PC += 2;
-                        }
-
-                        if (debug){
-                            printf("Skip if 0x%01X != 0x%01X\n", temporary_u8, current_key_pressed);
-                        }
-
-                        break;
-                    }
-                }
-
-               break;
-
-
-            // Opcodes for timers, setting, and reading
-            case 0xF:
-                // switch on the last byte
-                switch (instruction & 0x00FF){
-                    // Set V[X] to the current value of our delay_register (timer)
-                    case 0x07:
-                        chip_8_instance.V[(instruction & 0x0F00) >> 8] = chip_8_instance.delay_register;
-                        if (debug){
-                            printf("Set %d to the delay_registers value of %d\n", (instruction & 0x0F00) >> 8, chip_8_instance.delay_register);
-                        }
-                        break;
-                    // Set the delay_register (timer) to V[X]
-                    case 0x15:
-                        chip_8_instance.delay_register = chip_8_instance.V[(instruction & 0x0F00) >> 8];
-                        if (debug){
-                            printf("Set delay register to V[%d] = %d\n", (instruction & 0x0F00) >> 8, chip_8_instance.V[(instruction & 0x0F00) >> 8]);
-                        }
-                        break;
-                    // Set the sound_register (timer for sound) to V[X]
-                    case 0x18:
-                        chip_8_instance.sound_register = chip_8_instance.V[(instruction & 0x0F00) >> 8];
-                        if (debug){
-                            printf("Set sound register to V[%d] = %d\n", (instruction & 0x0F00) >> 8, chip_8_instance.V[(instruction & 0x0F00) >> 8]);
-                        }
-                        break;
-                    // Add V[X] to our index register (ambiguous behavior)
-                    case 0x1E:
-                        chip_8_instance.I += chip_8_instance.V[(instruction & 0x0F00) >> 8];
-                        if (debug){
-                            printf("Add V[%d] to index register\n", (instruction & 0x0F00) >> 8);
-                        }
-                        break;
-                    // Get a key blocking until a key is recieved
-                    case 0x0A:
-                        PollInputEvents();
-                        temporary_u8 = get_most_recent_input(&chip_8_instance);
-                        if (temporary_u8 != 0xFF){
-                            chip_8_instance.V[(instruction & 0xF00) >> 8] = temporary_u8;
-                            if (debug){
-                                printf("Got input: 0x%01X\n", temporary_u8);
-                            }
-                        }
-                        else{
-                            chip_8_instance.PC -= 2;
-                            if (debug){
-                                printf("Waiting for input\n");
-                            }
-                        }
-                        break;
-                    // Set our index register to the requested font V[X]
-                    case 0x29:
-                        chip_8_instance.I = 0x50 + (chip_8_instance.V[(instruction & 0x0F00) >> 8] * 5);
-                        if (debug){
-                            printf("Setting index register to font: 0x%01X\n", chip_8_instance.V[(instruction & 0x0F00) >> 8]);
-                        }
-                        break;
-                    // Binary-Coded decimal conversion i = (V[X] / 100), i + 1 = (V[X] % 100) / 10, i + 2 = (V[X] % 10)
-                    // AKA we take each digit of of V[X] and place them individually in I incrementing for each digit
-                    case 0x33:
-                        temporary_u8 = chip_8_instance.V[(instruction & 0x0F00) >> 8];
-                        chip_8_instance.memory[chip_8_instance.I] = temporary_u8 / 100;
-                        chip_8_instance.memory[chip_8_instance.I + 1] = (temporary_u8 % 100) / 10;
-                        chip_8_instance.memory[chip_8_instance.I + 2] = (temporary_u8 % 10);
-
-                        if (debug){
-                            printf("BCD - Start\n");
-                            printf("Memory address[%d] = (V[%d] / 100) = %d\n", chip_8_instance.I, (instruction & 0x0F00) >> 8, chip_8_instance.memory[chip_8_instance.I]);
-                            printf("Memory address[%d] = (V[%d] %% 100) / 10 = %d\n", chip_8_instance.I + 1, (instruction & 0x0F00) >> 8, chip_8_instance.memory[chip_8_instance.I + 1]);
-                            printf("Memmory address[%d] = (V[%d] %% 10) = %d\n", chip_8_instance.I + 2, (instruction & 0x0F00) >> 8, chip_8_instance.memory[chip_8_instance.I + 2]);
-                            printf("BCD - End\n");
-                        }
-
-                        break;
-                    // We change our emulated memory to the registers from 0 to X
-                    // AKA overwrite our emulated memory starting at i with V[0] till i + x = V[X]
-                    case 0x55:
-                        temporary_u8 = ((instruction & 0x0F00) >> 8);
-                        for( u8 i = 0; i <= temporary_u8; i++){
-                            chip_8_instance.memory[chip_8_instance.I + i] = chip_8_instance.V[i];
-                            if (debug) {
-                                printf("Overwriting memory address[%d] with %d\n", chip_8_instance.I + i,  chip_8_instance.V[i]);
-                            }
-                        }
-                        if (memory_quirk){
-                            chip_8_instance.I += 1;
-                        }
-                        break;
-                    // We change our emulated registers to the memory from 0 to X
-                    // AKA Overwrite our registers starting at V[0] with memory[i] till V[X] = memory[i] + x
-                    case 0x65:
-                        temporary_u8 = ((instruction & 0x0F00) >> 8);
-                        for( u8 i = 0; i <= temporary_u8; i++){
-                            chip_8_instance.V[i] = chip_8_instance.memory[chip_8_instance.I + i];
-                            if (debug) {
-                                printf("Overwriting V[%x] with memory address[%d]\n", i, chip_8_instance.I);
-                            }
-                        }
-                        if (memory_quirk){
-                            chip_8_instance.I += 1;
-                        }
-                        break;
-                }
-                break;
-
-            // Default case for unimplemented instructions / bad data
-            default:
-                printf("Unknown instruction\n");
-                break;
+    // Count everything the rom does from here on (the interpreter is used while profiling)
+    chip8_profiler *profiler = NULL;
+    if (profiler_path) {
+        profiler = chip8_profiler_create();
+        if (!profiler) {
+            printf("Error: -profiler needs the core built with make PROFILER=1\n");
+            return 1;
         }
+        chip8_profiler_attach(&chip_8_instance, profiler);
+    }
 
-        // Debug controller that takes input for each instruction to allow instruction by instruction debugging
-        if (walk_through_each_instruction){
-            printf("Enter a command: ");
-            fgets(input, sizeof(input), stdin);
-
-            // Remove newline if present
-            input[strcspn(input, "\n")] = 0;
+    // Pacing metrics are always kept for the F3 overlay, -metrics also dumps them
+    chip8_metrics *metrics = chip8_metrics_create();
+    if (!metrics) {
+        printf("Error: Out of memory for the metrics\n");
+        return 1;
+    }
+    if (metrics_path && chip8_metrics_start_dump(metrics, metrics_path, (unsigned int)metrics_interval_ms)) {
+        return 1;
+    }
 
-            // If the user just hit enter
-            if (input[0] == '\0'){
+    // Seed the random number generator used by 0xC
+    chip8_seed_rng(&chip_8_instance, (u32)time(NULL));
 
-            }
-            // The user gave some command
-            else{
-                if (strcmp(input, "print") == 0){
-                    print_chip_8_contents(&chip_8_instance);
+    // Timers count instructions rather than wall clock time so they keep pace at any -SPEED
+    chip8_set_cycles_per_tick(&chip_8_instance, cycles_per_tick);
 
-                }
-            }
-
-         }
+    // The movie starts from here so it holds the seed
+    chip8_movie *movie = NULL;
+    if (record_path) {
+        movie = chip8_movie_record(record_path, &chip_8_instance);
+        if (!movie) {
+            return 1;
+        }
+        printf("Recording to %s (loading states and rewinding are off while recording)\n", record_path);
+    }
 
-         // Update the time registers (decrement if its been 1/60 of a second)
-         update_time_registers(&chip_8_instance);
+    // Recent frames kept for rewinding (about a minute or more depending on how much the rom changes per frame)
+    chip8_rewind *rewind_buffer = chip8_rewind_create(CHIP8_REWIND_DEFAULT_ARENA);
+    if (rewind_buffer) {
+        chip8_rewind_push(rewind_buffer, &chip_8_instance);
+    }
 
-         /* Draw our frame if its time */
+    // F1 saves the whole chip 8 next to the rom and F2 restores it
+    char state_path[1024];
+    snprintf(state_path, sizeof(state_path), "%s.state", argv[argc-1]);
 
-         // If it's time to print a frame print the frame and reset our instruction count
-         if (time_has_passed(&when_next_frame)){
-            // Prep buffer for editing
-            BeginDrawing();
-            draw_frame(&chip_8_instance, scale_factor, &primary, &background);
-            // Draw the edited buffer to the screen
-            EndDrawing();
-            // Update for when we should print another frame
-            when_next_frame = make_future_time(16.6667);
-         }
+    // Init the window and audio device
+    SetConfigFlags(FLAG_VSYNC_HINT);
+    InitWindow(64 * scale_factor, 32 * scale_factor, "CHIP-8 Emulator");
+    // Drawing paces itself to the display, capped at its refresh rate in case vsync isn't honoured
+    int refresh_rate = GetMonitorRefreshRate(GetCurrentMonitor());
+    SetTargetFPS(refresh_rate > 0 ? refresh_rate : 60);
+    InitAudioDevice();
 
-         /* Get inputs from the user */
+    // Texture the display is uploaded to and drawn from each frame
+    static display_texture screen;
+    Color palette[4] = { background, primary, second_plane, both_planes };
+    load_display_texture(&screen, palette);
 
-         // Get what keys are pressed and set out timespec array for each character with when/if it was pressed
-         PollInputEvents();
-         if (IsKeyDown(KEY_ONE))    clock_gettime(CLOCK_MONOTONIC, &chip_8_instance.when_key_last_pressed[0x1]);
-         if (IsKeyDown(KEY_TWO))    clock_gettime(CLOCK_MONOTONIC, &chip_8_instance.when_key_last_pressed[0x2]);
-         if (IsKeyDown(KEY_THREE))  clock_gettime(CLOCK_MONOTONIC, &chip_8_instance.when_key_last_pressed[0x3]);
-         if (IsKeyDown(KEY_FOUR))   clock_gettime(CLOCK_MONOTONIC, &chip_8_instance.when_key_last_pressed[0xC]);
+    // The beeper is synthesized on the audio thread, the main loop only passes it sound timer changes
+    beeper = chip8_audio_create(AUDIO_SAMPLE_RATE);
+    if (!beeper) {
+        printf("Error: Out of memory for the audio\n");
+        return 1;
+    }
+    SetAudioStreamBufferSizeDefault(AUDIO_BUFFER_SAMPLES);
+    AudioStream beep = LoadAudioStream(AUDIO_SAMPLE_RATE, 16, 1);
+    SetAudioStreamCallback(beep, fill_audio_stream);
+    PlayAudioStream(beep);
+
+    // Realtime is one timer tick per 60hz frame (660 instructions per second by default), scaled by the requested
+    // speed
+    static emulation_thread emulation;
+    emulation.chip_8_object = &chip_8_instance;
+    emulation.movie = movie;
+    emulation.rewind_buffer = rewind_buffer;
+    emulation.profiler = profiler;
+    emulation.metrics = metrics;
+    emulation.state_path = state_path;
+    emulation.cycles_per_frame = speed_scaler * cycles_per_tick;
+    atomic_init(&emulation.keys_held, 0);
+    atomic_init(&emulation.keys_pressed, 0);
+    atomic_init(&emulation.keys_pressed_ns, 0);
+    atomic_init(&emulation.hotkeys, 0);
+    atomic_init(&emulation.rewinding, false);
+    atomic_init(&emulation.quit, false);
+    atomic_init(&emulation.finished, false);
+    chip8_triple_buffer_init(&emulation.frames);
 
-         if (IsKeyDown(KEY_Q))      clock_gettime(CLOCK_MONOTONIC, &chip_8_instance.when_key_last_pressed[0x4]);
-         if (IsKeyDown(KEY_W))      clock_gettime(CLOCK_MONOTONIC, &chip_8_instance.when_key_last_pressed[0x5]);
-         if (IsKeyDown(KEY_E))      clock_gettime(CLOCK_MONOTONIC, &chip_8_instance.when_key_last_pressed[0x6]);
-         if (IsKeyDown(KEY_R))      clock_gettime(CLOCK_MONOTONIC, &chip_8_instance.when_key_last_pressed[0xD]);
+    /* Set up our graphics */
 
-         if (IsKeyDown(KEY_A))      clock_gettime(CLOCK_MONOTONIC, &chip_8_instance.when_key_last_pressed[0x7]);
-         if (IsKeyDown(KEY_S))      clock_gettime(CLOCK_MONOTONIC, &chip_8_instance.when_key_last_pressed[0x8]);
-         if (IsKeyDown(KEY_D))      clock_gettime(CLOCK_MONOTONIC, &chip_8_instance.when_key_last_pressed[0x9]);
-         if (IsKeyDown(KEY_F))      clock_gettime(CLOCK_MONOTONIC, &chip_8_instance.when_key_last_pressed[0xE]);
+    // Init the window with a black background
+    BeginDrawing();
+    ClearBackground(background);
+    EndDrawing();
 
-         if (IsKeyDown(KEY_Z))      clock_gettime(CLOCK_MONOTONIC, &chip_8_instance.when_key_last_pressed[0xA]);
-         if (IsKeyDown(KEY_X))      clock_gettime(CLOCK_MONOTONIC, &chip_8_instance.when_key_last_pressed[0x0]);
-         if (IsKeyDown(KEY_C))      clock_gettime(CLOCK_MONOTONIC, &chip_8_instance.when_key_last_pressed[0xB]);
-         if (IsKeyDown(KEY_V))      clock_gettime(CLOCK_MONOTONIC, &chip_8_instance.when_key_last_pressed[0xF]);
+    // The core runs on its own thread from here on so a slow present never holds up emulation
+    pthread_t emulation_thread_id;
+    if (pthread_create(&emulation_thread_id, NULL, emulation_main, &emulation) != 0) {
+        printf("Error: Can't start the emulation thread\n");
+        return 1;
+    }
 
-         /* Keep track of instruction speed and adjust as necessary */
+    // CHIP-8 keys held down, bit N = key N, kept up to date from key events each frame
+    u16 keys = 0;
 
-         // track this instruction (if its been a second we get a print out of how many instructions we did in that second)
-         instructions_performed_last_second = track_instructions();
+    // F3 overlay of the metrics, refreshed once a second from the interval since the last refresh
+    bool show_metrics = false;
+    static chip8_metrics_snapshot metrics_before;
+    static chip8_metrics_snapshot metrics_now;
+    chip8_metrics_summary metrics_summary;
+    chip8_metrics_take_snapshot(metrics, &metrics_before);
+    chip8_metrics_summarize(metrics, &metrics_before, NULL, &metrics_summary);
 
-         // Adjust how long we sleep in accordance with how many instructions we want to do vs what we actually did
-         if (instructions_performed_last_second > 0 && !debug) {
-             adjustment_ratio = instruction_per_second / (float)instructions_performed_last_second;
+    /* Start render loop, one pass per display refresh */
 
-             // If debug is on we print our target instructions per second as value and ratio
-             if (debug){
-                 printf("Target instructions per second: %f\n", instruction_per_second);
-                 printf("Ratio: %f\n", adjustment_ratio);
-             }
+    // While the rom is still running and the window is still open
+    while (!atomic_load(&emulation.finished) && !WindowShouldClose()) {
 
-             // Get how far we are off as a value
-             adjustment_ratio -= 1.0;
-             // Adjust how long we should sleep to we're closer to our target instructions per second
-             time_per_instruction_ms += (time_per_instruction_ms * (adjustment_ratio * -1));
+        /* Get inputs from the user */
 
-         }
+        // Keys that went down since last frame come off raylib's key press queue (EndDrawing already polled events)
+        u16 pressed = 0;
+        int pressed_key;
+        while ((pressed_key = GetKeyPressed()) != 0) {
+            int key = keypad_index(pressed_key);
+            if (key >= 0) pressed |= 1 << key;
+        }
+        keys |= pressed;
+        // and only the keys held down need checking for a release
+        for (u16 held = keys; held; held &= held - 1) {
+            int key = __builtin_ctz(held);
+            if (!IsKeyDown(keypad_keys[key])) keys &= ~(1 << key);
+        }
+        if (pressed) {
+            // Only the oldest press waiting is timed, stamped before the keys so the emulation thread never takes
+            // the keys without it
+            unsigned long long no_press = 0;
+            atomic_compare_exchange_strong(&emulation.keys_pressed_ns, &no_press, monotonic_ns());
+            atomic_fetch_or(&emulation.keys_pressed, pressed);
+        }
+        atomic_store(&emulation.keys_held, keys);
+
+        // Save state and rewind hotkeys
+        unsigned int hotkeys = 0;
+        if (IsKeyPressed(KEY_F1)) hotkeys |= HOTKEY_SAVE_STATE;
+        if (IsKeyPressed(KEY_F2)) hotkeys |= HOTKEY_LOAD_STATE;
+        if (hotkeys) atomic_fetch_or(&emulation.hotkeys, hotkeys);
+        atomic_store(&emulation.rewinding, IsKeyDown(KEY_BACKSPACE));
+        if (IsKeyPressed(KEY_F3)) show_metrics = !show_metrics;
+
+        // Work out the overlay's numbers again once a second
+        if (monotonic_ns() - metrics_before.taken_ns >= 1000000000ULL) {
+            chip8_metrics_take_snapshot(metrics, &metrics_now);
+            chip8_metrics_summarize(metrics, &metrics_now, &metrics_before, &metrics_summary);
+            metrics_before = metrics_now;
+        }
 
-         /* Sleep till next instruction using delta time */
+        /* Draw the newest frame */
 
-         // Sleep with delta time
-         sleep_for_instruction(time_per_instruction_ms);
+        unsigned long long present_start = monotonic_ns();
+        // Prep buffer for editing
+        BeginDrawing();
+        draw_frame(chip8_triple_buffer_take(&emulation.frames), &screen, scale_factor);
+        if (show_metrics) {
+            draw_metrics_overlay(&metrics_summary);
+        }
+        // Draw the edited buffer to the screen (waits for vsync)
+        EndDrawing();
+        chip8_metrics_record(metrics, CHIP8_HISTOGRAM_PRESENT, monotonic_ns() - present_start);
+        chip8_metrics_add(metrics, CHIP8_COUNTER_PRESENTS, 1);
 
     }
 
+    // Stop the emulation thread, everything it ran with is ours again once it's joined
+    atomic_store(&emulation.quit, true);
+    pthread_join(emulation_thread_id, NULL);
+
     // Clean up
-    // unload our beep audio file
-    UnloadSound(beep);
+    // report where the time went
+    if (profiler) {
+        chip8_profiler_write_report(profiler, &chip_8_instance, stdout);
+        if (chip8_profiler_write_json(profiler, &chip_8_instance, profiler_path) == 0) {
+            printf("Profile written to %s\n", profiler_path);
+        }
+    }
+    // finish the movie off with the state we ended in
+    if (movie && chip8_movie_finish(movie, &chip_8_instance) == 0) {
+        printf("Recorded %s\n", record_path);
+    }
+    // unload the display texture
+    UnloadTexture(screen.texture);
+    // Stop the beeper's stream before freeing what its callback reads
+    UnloadAudioStream(beep);
+    chip8_audio_destroy(beeper);
     // Close the audio device
     CloseAudioDevice();
     // Close the window
     CloseWindow();
+    // Free the recompiler and rewind buffer
+    chip8_jit_destroy(jit);
+    chip8_analysis_destroy(analysis);
+    chip8_rewind_destroy(rewind_buffer);
+    chip8_profiler_destroy(profiler);
+    // Stops the dump thread after one last dump
+    chip8_metrics_destroy(metrics);
     return 0;
 
 }
@@ -0,0 +1,798 @@
+#include "chip_8_export.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <pthread.h>
+
+/*
+ * Layout of a C8FR raw frame stream, every multi byte value is big endian
+ *
+ *   0  "C8FR"          4  version          6  mode             7  planes
+ *   8  width          10  height
+ *  12  frames, each [frame number (4)][per plane, height rows of width / 8 bytes (leftmost pixel in the top bit)]
+ *
+ * Every frame is the mode's full size (lores in the 128x64 modes is doubled up) so frames are a fixed size and
+ * frame N of a stream can be found without reading the ones before it.
+ */
+enum {
+    RAW_MAGIC = 0,
+    RAW_VERSION = 4,
+    RAW_MODE = 6,
+    RAW_PLANES = 7,
+    RAW_WIDTH = 8,
+    RAW_HEIGHT = 10,
+    RAW_HEADER_SIZE = 12
+};
+
+static const u8 raw_magic[4] = { 'C', '8', 'F', 'R' };
+
+// Frames that can wait on the encoder before the emulation thread has to wait for it (about a second at 60hz)
+#define EXPORT_QUEUE_FRAMES 64
+
+// Palette indexes in the biggest frame
+#define EXPORT_PIXELS (CHIP8_HIRES_WIDTH * CHIP8_HIRES_HEIGHT)
+
+// GIF's LZW codes top out at 12 bits
+#define GIF_MAX_CODES 4096
+
+/*
+ * export_frame struct
+ * Expects: N/A
+ * Does: One frame as the emulation thread handed it over, the display copied as is
+ */
+typedef struct export_frame {
+    uint32_t number;
+    bool hires;
+    u64 display[CHIP8_PLANES][CHIP8_HIRES_HEIGHT][2];
+} export_frame;
+
+struct chip8_exporter {
+
+    chip8_export_options options;
+    // Copy of options.path (with a .png extension cut off, the frame number goes in its place)
+    char *path;
+    chip8_mode mode;
+    int width;
+    int height;
+    int planes;
+    // The raw stream or GIF being written
+    FILE *file;
+
+    // Queue from the emulation thread to the encoder thread, frames are written in place and the slot at head
+    // stays the encoder's until it moves head past it
+    pthread_t encoder;
+    pthread_mutex_t lock;
+    pthread_cond_t frame_queued;
+    pthread_cond_t frame_written;
+    export_frame queue[EXPORT_QUEUE_FRAMES];
+    int head;
+    int count;
+    bool closing;
+    bool failed;
+
+    // Emulation thread only, frames seen and frames queued
+    uint32_t frames_seen;
+    uint32_t frames_queued;
+
+    // Encoder thread only, the frame being written as palette indexes, and for GIF the frame waiting to find out
+    // how long it stays up and the last frame written (only rows that changed since it are written)
+    u8 pixel_buffers[3][EXPORT_PIXELS];
+    u8 *current;
+    u8 *pending;
+    u8 *previous;
+    uint32_t pending_number;
+    bool has_pending;
+    bool has_previous;
+    u16 lzw_children[GIF_MAX_CODES][4];
+
+};
+
+/* Big endian helpers (PNG and C8FR), GIF is little endian */
+
+static inline void put_u16(u8 *out, u16 value){
+    out[0] = value >> 8;
+    out[1] = value;
+}
+
+static inline void put_u32(u8 *out, uint32_t value){
+    put_u16(out, value >> 16);
+    put_u16(out + 2, value);
+}
+
+static inline void put_u16_le(u8 *out, u16 value){
+    out[0] = value;
+    out[1] = value >> 8;
+}
+
+/*
+ * chip8_export_default_options function
+ * Expects: NA
+ * Does: Returns the options used when the user doesn't override them (no path, raw, every frame, the window's colors)
+ *
+ */
+chip8_export_options chip8_export_default_options(void){
+    chip8_export_options options;
+    options.path = NULL;
+    options.format = CHIP8_EXPORT_RAW;
+    options.changed_only = false;
+    // White background, black primary, light gray second plane and gray for both (the window's defaults)
+    static const u8 palette[4][3] = { { 255, 255, 255 }, { 0, 0, 0 }, { 200, 200, 200 }, { 130, 130, 130 } };
+    memcpy(options.palette, palette, sizeof(options.palette));
+    return options;
+}
+
+// Format names indexed by chip8_export_format, doubling as the file extensions (raw streams use .c8f)
+static const char *const format_names[] = { "raw", "png", "gif" };
+static const char *const format_extensions[] = { ".c8f", ".png", ".gif" };
+
+/*
+ * chip8_export_format_from_name function
+ * Expects: NA
+ * Does: Sets format from raw, png or gif and returns 0, else returns 1 (after printing why)
+ *
+ */
+int chip8_export_format_from_name(const char *name, chip8_export_format *format){
+
+    for (int i = 0; i < (int)(sizeof(format_names) / sizeof(format_names[0])); i++){
+        if (strcasecmp(format_names[i], name) == 0){
+            *format = (chip8_export_format)i;
+            return 0;
+        }
+    }
+
+    printf("Error: Unknown export format %s (expected raw, png or gif)\n", name);
+    return 1;
+
+}
+
+/*
+ * chip8_export_format_for_path function
+ * Expects: NA
+ * Does: Returns the format a file extension calls for, .png PNG, .gif GIF and anything else raw
+ *
+ */
+chip8_export_format chip8_export_format_for_path(const char *path){
+
+    const char *extension = strrchr(path, '.');
+    if (extension && strcasecmp(extension, ".png") == 0){
+        return CHIP8_EXPORT_PNG;
+    }
+    if (extension && strcasecmp(extension, ".gif") == 0){
+        return CHIP8_EXPORT_GIF;
+    }
+    return CHIP8_EXPORT_RAW;
+
+}
+
+/*
+ * chip8_export_extension function
+ * Expects: NA
+ * Does: Returns the file extension format is written with (raw frames use .c8f)
+ *
+ */
+const char *chip8_export_extension(chip8_export_format format){
+    return format_extensions[format];
+}
+
+/*
+ * render_frame function
+ * Expects: pixels to hold EXPORT_PIXELS
+ * Does: Unpacks frame into one palette index per pixel at the exporter's frame size
+ *
+ */
+static void render_frame(const chip8_exporter *exporter, const export_frame *frame, u8 *pixels){
+
+    // Lores in the 128x64 modes is doubled up so every frame of a mode is the same size
+    int shift = (exporter->width == CHIP8_HIRES_WIDTH && !frame->hires) ? 1 : 0;
+    u8 plane_mask = exporter->planes == 2 ? 3 : 1;
+
+    for (int y = 0; y < exporter->height; y++){
+        const u64 *row_0 = frame->display[0][y >> shift];
+        const u64 *row_1 = frame->display[1][y >> shift];
+        for (int x = 0; x < exporter->width; x++){
+            int source = x >> shift;
+            int bit = 63 - (source & 63);
+            u8 color = ((row_0[source >> 6] >> bit) & 1) | (((row_1[source >> 6] >> bit) & 1) << 1);
+            *pixels++ = color & plane_mask;
+        }
+    }
+
+}
+
+/*
+ * write_raw_header function
+ * Expects: exporter->file to be open at the start of the stream
+ * Does: Writes the C8FR header, returns 0 on success else 1
+ *
+ */
+static int write_raw_header(chip8_exporter *exporter){
+    u8 header[RAW_HEADER_SIZE];
+    memcpy(&header[RAW_MAGIC], raw_magic, sizeof(raw_magic));
+    put_u16(&header[RAW_VERSION], CHIP8_EXPORT_RAW_VERSION);
+    header[RAW_MODE] = exporter->mode;
+    header[RAW_PLANES] = exporter->planes;
+    put_u16(&header[RAW_WIDTH], exporter->width);
+    put_u16(&header[RAW_HEIGHT], exporter->height);
+    return fwrite(header, 1, sizeof(header), exporter->file) == sizeof(header) ? 0 : 1;
+}
+
+/*
+ * write_raw_frame function
+ * Expects: exporter->current to hold the frame's pixels
+ * Does: Appends the frame to the C8FR stream, returns 0 on success else 1
+ *
+ */
+static int write_raw_frame(chip8_exporter *exporter, uint32_t number){
+
+    u8 record[4 + CHIP8_PLANES * EXPORT_PIXELS / 8];
+    put_u32(record, number);
+
+    // Packed a bit per pixel per plane like the display itself
+    u8 *out = &record[4];
+    for (int plane = 0; plane < exporter->planes; plane++){
+        const u8 *pixel = exporter->current;
+        for (int i = 0; i < exporter->width * exporter->height; i += 8){
+            u8 packed = 0;
+            for (int bit = 0; bit < 8; bit++){
+                packed = (packed << 1) | ((pixel[i + bit] >> plane) & 1);
+            }
+            *out++ = packed;
+        }
+    }
+
+    size_t size = out - record;
+    return fwrite(record, 1, size, exporter->file) == size ? 0 : 1;
+
+}
+
+/* PNG, written with stored (uncompressed) deflate blocks so there's no zlib dependency. At 1 or 2 bits a pixel a
+ * frame is at most a couple of KB anyway */
+
+static uint32_t crc_table[256];
+static pthread_once_t crc_table_once = PTHREAD_ONCE_INIT;
+
+/*
+ * build_crc_table function
+ * Expects: to be run once through pthread_once (encoder threads can start together)
+ * Does: Fills crc_table for the PNG chunk CRC (CRC-32, polynomial 0xEDB88320)
+ *
+ */
+static void build_crc_table(void){
+    for (uint32_t i = 0; i < 256; i++){
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++){
+            crc = (crc & 1) ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+        }
+        crc_table[i] = crc;
+    }
+}
+
+/*
+ * crc32_update function
+ * Expects: crc_table to be built
+ * Does: Returns crc carried on over length bytes of data (start from 0xFFFFFFFF and invert the result)
+ *
+ */
+static uint32_t crc32_update(uint32_t crc, const u8 *data, size_t length){
+    for (size_t i = 0; i < length; i++){
+        crc = crc_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+/*
+ * write_png_chunk function
+ * Expects: type to be a 4 letter PNG chunk type
+ * Does: Writes a chunk with its length and CRC, returns 0 on success else 1
+ *
+ */
+static int write_png_chunk(FILE *file, const char *type, const u8 *data, uint32_t length){
+    u8 length_bytes[4];
+    u8 crc_bytes[4];
+    put_u32(length_bytes, length);
+    uint32_t crc = crc32_update(0xFFFFFFFFu, (const u8 *)type, 4);
+    crc = crc32_update(crc, data, length);
+    put_u32(crc_bytes, crc ^ 0xFFFFFFFFu);
+    return fwrite(length_bytes, 1, 4, file) != 4 || fwrite(type, 1, 4, file) != 4 ||
+           (length && fwrite(data, 1, length, file) != length) || fwrite(crc_bytes, 1, 4, file) != 4;
+}
+
+/*
+ * write_png_frame function
+ * Expects: exporter->current to hold the frame's pixels
+ * Does: Writes the frame as path_NNNNNN.png (a paletted PNG, 1 bit a pixel or 2 for XO-CHIP's planes), returns 0
+ * on success else 1
+ *
+ */
+static int write_png_frame(chip8_exporter *exporter, uint32_t number){
+
+    pthread_once(&crc_table_once, build_crc_table);
+
+    int depth = exporter->planes == 2 ? 2 : 1;
+    int row_bytes = (exporter->width * depth + 7) / 8;
+
+    // Scanlines each with a leading filter byte (0, none) wrapped in a zlib stream of one stored block
+    enum { SCANLINES_MAX = CHIP8_HIRES_HEIGHT * (1 + CHIP8_HIRES_WIDTH * 2 / 8) };
+    _Static_assert(SCANLINES_MAX <= 65535, "PNG scanlines no longer fit a single stored deflate block");
+    u8 idat[2 + 5 + SCANLINES_MAX + 4];
+    u8 *scanlines = &idat[7];
+    u8 *out = scanlines;
+    const u8 *pixel = exporter->current;
+    for (int y = 0; y < exporter->height; y++){
+        *out++ = 0;
+        memset(out, 0, row_bytes);
+        for (int x = 0; x < exporter->width; x++){
+            int position = x * depth;
+            out[position >> 3] |= *pixel++ << (8 - depth - (position & 7));
+        }
+        out += row_bytes;
+    }
+    u16 length = out - scanlines;
+
+    // zlib header (deflate, 32K window, no dictionary) then a final stored block
+    idat[0] = 0x78;
+    idat[1] = 0x01;
+    idat[2] = 0x01;
+    put_u16_le(&idat[3], length);
+    put_u16_le(&idat[5], ~length);
+
+    // Adler-32 of the uncompressed data
+    uint32_t a = 1;
+    uint32_t b = 0;
+    for (int i = 0; i < length; i++){
+        a = (a + scanlines[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    put_u32(out, (b << 16) | a);
+    uint32_t idat_length = 7 + length + 4;
+
+    u8 header[13];
+    put_u32(&header[0], exporter->width);
+    put_u32(&header[4], exporter->height);
+    header[8] = depth;
+    // Paletted, deflate, adaptive filtering, not interlaced
+    header[9] = 3;
+    header[10] = 0;
+    header[11] = 0;
+    header[12] = 0;
+
+    u8 palette[4 * 3];
+    int colors = 1 << depth;
+    memcpy(palette, exporter->options.palette, colors * 3);
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s_%06u.png", exporter->path, number);
+    FILE *file = fopen(path, "wb");
+    if (!file){
+        return 1;
+    }
+
+    static const u8 signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    int status = fwrite(signature, 1, sizeof(signature), file) != sizeof(signature);
+    status |= write_png_chunk(file, "IHDR", header, sizeof(header));
+    status |= write_png_chunk(file, "PLTE", palette, colors * 3);
+    status |= write_png_chunk(file, "IDAT", idat, idat_length);
+    status |= write_png_chunk(file, "IEND", NULL, 0);
+    status |= fclose(file) != 0;
+    return status ? 1 : 0;
+
+}
+
+/* GIF, one animated GIF89a with a 4 color global palette. Frames are LZW compressed and only the band of rows that
+ * changed since the last frame is written, the rest is left on screen */
+
+/*
+ * gif_bits struct
+ * Expects: N/A
+ * Does: Packs variable width LZW codes least significant bit first into GIF's 255 byte sub-blocks
+ */
+typedef struct gif_bits {
+    FILE *file;
+    u8 block[255];
+    int size;
+    uint32_t bits;
+    int count;
+} gif_bits;
+
+/*
+ * put_code function
+ * Expects: width to be at most 12
+ * Does: Appends code to the image data, writing out each sub-block as it fills
+ *
+ */
+static void put_code(gif_bits *out, int code, int width){
+    out->bits |= (uint32_t)code << out->count;
+    out->count += width;
+    while (out->count >= 8){
+        out->block[out->size++] = out->bits & 0xFF;
+        out->bits >>= 8;
+        out->count -= 8;
+        if (out->size == 255){
+            fputc(255, out->file);
+            fwrite(out->block, 1, 255, out->file);
+            out->size = 0;
+        }
+    }
+}
+
+/*
+ * write_gif_header function
+ * Expects: exporter->file to be open at the start of the file
+ * Does: Writes the GIF header, the global palette and the loop forever extension, returns 0 on success else 1
+ *
+ */
+static int write_gif_header(chip8_exporter *exporter){
+
+    u8 header[13 + 4 * 3 + 19];
+    memcpy(header, "GIF89a", 6);
+    put_u16_le(&header[6], exporter->width);
+    put_u16_le(&header[8], exporter->height);
+    // Global color table of 4 entries, background color 0, square pixels
+    header[10] = 0x91;
+    header[11] = 0;
+    header[12] = 0;
+    memcpy(&header[13], exporter->options.palette, 4 * 3);
+
+    // NETSCAPE2.0 application extension looping forever
+    u8 *loop = &header[13 + 4 * 3];
+    static const u8 netscape[19] = { 0x21, 0xFF, 0x0B, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0',
+                                     0x03, 0x01, 0x00, 0x00, 0x00 };
+    memcpy(loop, netscape, sizeof(netscape));
+
+    return fwrite(header, 1, sizeof(header), exporter->file) == sizeof(header) ? 0 : 1;
+
+}
+
+/*
+ * centiseconds function
+ * Expects: NA
+ * Does: Returns when 60hz frame number starts in (rounded) hundredths of a second, GIF's unit for delays
+ *
+ */
+static uint32_t centiseconds(uint32_t number){
+    return (uint32_t)(((uint64_t)number * 100 + 30) / 60);
+}
+
+/*
+ * write_gif_frame function
+ * Expects: exporter->pending to hold a frame and next_number to be the frame that replaces it
+ * Does: Writes the pending frame, held on screen until next_number, as the rows that differ from the last frame
+ * written, returns 0 on success else 1
+ *
+ */
+static int write_gif_frame(chip8_exporter *exporter, uint32_t next_number){
+
+    int width = exporter->width;
+    const u8 *pixels = exporter->pending;
+
+    // Band of rows that changed, everything above and below is left as it was
+    int top = 0;
+    int bottom = exporter->height - 1;
+    if (exporter->has_previous){
+        while (top < bottom && memcmp(&pixels[top * width], &exporter->previous[top * width], width) == 0){
+            top++;
+        }
+        while (bottom > top && memcmp(&pixels[bottom * width], &exporter->previous[bottom * width], width) == 0){
+            bottom--;
+        }
+    }
+    int rows = bottom - top + 1;
+
+    // Graphic control extension (leave the frame in place, delay) then the image descriptor for the band
+    u8 header[8 + 10 + 1];
+    header[0] = 0x21;
+    header[1] = 0xF9;
+    header[2] = 4;
+    header[3] = 1 << 2;
+    put_u16_le(&header[4], centiseconds(next_number) - centiseconds(exporter->pending_number));
+    header[6] = 0;
+    header[7] = 0;
+    header[8] = 0x2C;
+    put_u16_le(&header[9], 0);
+    put_u16_le(&header[11], top);
+    put_u16_le(&header[13], width);
+    put_u16_le(&header[15], rows);
+    header[17] = 0;
+    // LZW minimum code size, 2 bits covers the 4 colors
+    header[18] = 2;
+    if (fwrite(header, 1, sizeof(header), exporter->file) != sizeof(header)){
+        return 1;
+    }
+
+    // LZW over a 4 symbol alphabet, the dictionary is a child table per code (0 = no child yet)
+    enum { CLEAR_CODE = 4, END_CODE = 5, FIRST_CODE = 6, FIRST_WIDTH = 3 };
+    gif_bits out = { exporter->file, { 0 }, 0, 0, 0 };
+    memset(exporter->lzw_children, 0, sizeof(exporter->lzw_children));
+    int code_width = FIRST_WIDTH;
+    int next_code = FIRST_CODE;
+    put_code(&out, CLEAR_CODE, code_width);
+
+    const u8 *pixel = &pixels[top * width];
+    int count = rows * width;
+    int string = pixel[0];
+    for (int i = 1; i < count; i++){
+        u8 symbol = pixel[i];
+        u16 child = exporter->lzw_children[string][symbol];
+        if (child){
+            string = child;
+            continue;
+        }
+        put_code(&out, string, code_width);
+        if (next_code < GIF_MAX_CODES){
+            if (next_code == (1 << code_width)){
+                code_width++;
+            }
+            exporter->lzw_children[string][symbol] = next_code++;
+        }
+        // A full dictionary starts over
+        else {
+            put_code(&out, CLEAR_CODE, code_width);
+            memset(exporter->lzw_children, 0, sizeof(exporter->lzw_children));
+            code_width = FIRST_WIDTH;
+            next_code = FIRST_CODE;
+        }
+        string = symbol;
+    }
+    put_code(&out, string, code_width);
+    put_code(&out, END_CODE, code_width);
+
+    // Flush the last partial byte and sub-block then the block terminator
+    if (out.count > 0){
+        put_code(&out, 0, 8 - out.count);
+    }
+    if (out.size > 0){
+        fputc(out.size, exporter->file);
+        fwrite(out.block, 1, out.size, exporter->file);
+    }
+    fputc(0, exporter->file);
+    return ferror(exporter->file) ? 1 : 0;
+
+}
+
+/*
+ * write_frame function
+ * Expects: to run on the encoder thread
+ * Does: Writes frame in the exporter's format, returns 0 on success else 1
+ *
+ */
+static int write_frame(chip8_exporter *exporter, const export_frame *frame){
+
+    render_frame(exporter, frame, exporter->current);
+
+    switch (exporter->options.format){
+        case CHIP8_EXPORT_RAW:
+            return write_raw_frame(exporter, frame->number);
+        case CHIP8_EXPORT_PNG:
+            return write_png_frame(exporter, frame->number);
+        case CHIP8_EXPORT_GIF:
+            break;
+    }
+
+    // A GIF frame only goes out once the next different frame says how long it stayed up, the same picture again
+    // just keeps the pending one up longer
+    size_t size = exporter->width * exporter->height;
+    if (exporter->has_pending && memcmp(exporter->current, exporter->pending, size) == 0){
+        return 0;
+    }
+    int status = 0;
+    if (exporter->has_pending){
+        status = write_gif_frame(exporter, frame->number);
+        u8 *written = exporter->pending;
+        exporter->pending = exporter->previous;
+        exporter->previous = written;
+        exporter->has_previous = true;
+    }
+    u8 *pending = exporter->current;
+    exporter->current = exporter->pending;
+    exporter->pending = pending;
+    exporter->pending_number = frame->number;
+    exporter->has_pending = true;
+    return status;
+
+}
+
+/*
+ * encoder_main function
+ * Expects: arg to be a chip8_exporter
+ * Does: Writes queued frames in order until the exporter is closed and the queue is empty, after a failed write
+ * frames are only drained
+ *
+ */
+static void *encoder_main(void *arg){
+
+    chip8_exporter *exporter = (chip8_exporter *)arg;
+    for (;;){
+        pthread_mutex_lock(&exporter->lock);
+        while (exporter->count == 0 && !exporter->closing){
+            pthread_cond_wait(&exporter->frame_queued, &exporter->lock);
+        }
+        if (exporter->count == 0){
+            pthread_mutex_unlock(&exporter->lock);
+            break;
+        }
+        const export_frame *frame = &exporter->queue[exporter->head];
+        bool failed = exporter->failed;
+        pthread_mutex_unlock(&exporter->lock);
+
+        // Encoded outside the lock, the emulation thread doesn't touch this slot until head moves on
+        int status = failed ? 0 : write_frame(exporter, frame);
+
+        pthread_mutex_lock(&exporter->lock);
+        exporter->failed |= status != 0;
+        exporter->head = (exporter->head + 1) % EXPORT_QUEUE_FRAMES;
+        exporter->count--;
+        pthread_cond_signal(&exporter->frame_written);
+        pthread_mutex_unlock(&exporter->lock);
+    }
+    return NULL;
+
+}
+
+/*
+ * free_exporter function
+ * Expects: the encoder thread to have finished (or never started)
+ * Does: Frees the exporter (the file is closed by whoever opened it)
+ *
+ */
+static void free_exporter(chip8_exporter *exporter){
+    pthread_mutex_destroy(&exporter->lock);
+    pthread_cond_destroy(&exporter->frame_queued);
+    pthread_cond_destroy(&exporter->frame_written);
+    free(exporter->path);
+    free(exporter);
+}
+
+/*
+ * chip8_export_open function
+ * Expects: options->path to be set, chip_8_object to have its mode set (the mode decides the frame size)
+ * Does: Starts an exporter with its own encoder thread, returns NULL (after printing why) if the output can't be
+ * written
+ *
+ */
+chip8_exporter *chip8_export_open(const chip8_export_options *options, const chip_8 *chip_8_object){
+
+    chip8_exporter *exporter = calloc(1, sizeof(chip8_exporter));
+    if (!exporter){
+        printf("Error: Out of memory exporting to %s\n", options->path);
+        return NULL;
+    }
+    exporter->options = *options;
+    exporter->mode = chip_8_object->mode;
+    exporter->width = exporter->mode == CHIP8_MODE_CHIP8 ? chip_8_screen_width : CHIP8_HIRES_WIDTH;
+    exporter->height = exporter->mode == CHIP8_MODE_CHIP8 ? chip_8_screen_height : CHIP8_HIRES_HEIGHT;
+    exporter->planes = exporter->mode == CHIP8_MODE_XOCHIP ? 2 : 1;
+    exporter->current = exporter->pixel_buffers[0];
+    exporter->pending = exporter->pixel_buffers[1];
+    exporter->previous = exporter->pixel_buffers[2];
+    pthread_mutex_init(&exporter->lock, NULL);
+    pthread_cond_init(&exporter->frame_queued, NULL);
+    pthread_cond_init(&exporter->frame_written, NULL);
+
+    // PNG frames are numbered files so the extension makes way for the number
+    exporter->path = strdup(options->path);
+    if (!exporter->path){
+        printf("Error: Out of memory exporting to %s\n", options->path);
+        free_exporter(exporter);
+        return NULL;
+    }
+    size_t length = strlen(exporter->path);
+    if (options->format == CHIP8_EXPORT_PNG && length >= 4 && strcasecmp(exporter->path + length - 4, ".png") == 0){
+        exporter->path[length - 4] = '\0';
+    }
+
+    if (options->format != CHIP8_EXPORT_PNG){
+        exporter->file = fopen(exporter->path, "wb");
+        int status = !exporter->file;
+        if (!status){
+            status = options->format == CHIP8_EXPORT_GIF ? write_gif_header(exporter) : write_raw_header(exporter);
+        }
+        if (status){
+            printf("Error: Can't write frames to %s\n", exporter->path);
+            if (exporter->file){
+                fclose(exporter->file);
+            }
+            free_exporter(exporter);
+            return NULL;
+        }
+    }
+
+    if (pthread_create(&exporter->encoder, NULL, encoder_main, exporter) != 0){
+        printf("Error: Can't start the frame encoder\n");
+        if (exporter->file){
+            fclose(exporter->file);
+        }
+        free_exporter(exporter);
+        return NULL;
+    }
+
+    return exporter;
+
+}
+
+/*
+ * chip8_export_frame function
+ * Expects: to be called once per 60hz frame after the frame ran, nothing else to be consuming dirty_rows
+ * Does: Copies the display onto the encoder's queue (unless only changed frames are wanted and nothing was drawn)
+ * and clears dirty_rows, only waits when the queue is full. Returns 0 on success else 1 once encoding has failed
+ *
+ */
+int chip8_export_frame(chip8_exporter *exporter, chip_8 *chip_8_object){
+
+    // The first frame always goes out so there's something to compare against
+    uint32_t number = exporter->frames_seen++;
+    if (exporter->options.changed_only && number > 0 && !chip_8_object->dirty_rows){
+        return 0;
+    }
+    chip_8_object->dirty_rows = 0;
+
+    // Only a queue the encoder has fallen a whole queue behind on holds the emulation up
+    pthread_mutex_lock(&exporter->lock);
+    while (exporter->count == EXPORT_QUEUE_FRAMES && !exporter->failed){
+        pthread_cond_wait(&exporter->frame_written, &exporter->lock);
+    }
+    if (exporter->failed){
+        pthread_mutex_unlock(&exporter->lock);
+        return 1;
+    }
+    export_frame *frame = &exporter->queue[(exporter->head + exporter->count) % EXPORT_QUEUE_FRAMES];
+    frame->number = number;
+    frame->hires = chip_8_object->hires;
+    memcpy(frame->display, chip_8_object->display, sizeof(frame->display));
+    exporter->count++;
+    exporter->frames_queued++;
+    pthread_cond_signal(&exporter->frame_queued);
+    pthread_mutex_unlock(&exporter->lock);
+    return 0;
+
+}
+
+/*
+ * chip8_export_close function
+ * Expects: exporter to have come from chip8_export_open (or be NULL)
+ * Does: Waits for every queued frame to be written then closes and frees the exporter, returns 0 if everything
+ * was written else 1 (after printing why)
+ *
+ */
+int chip8_export_close(chip8_exporter *exporter){
+
+    if (!exporter){
+        return 0;
+    }
+
+    pthread_mutex_lock(&exporter->lock);
+    exporter->closing = true;
+    pthread_cond_signal(&exporter->frame_queued);
+    pthread_mutex_unlock(&exporter->lock);
+    pthread_join(exporter->encoder, NULL);
+
+    // The encoder is done so its state is ours, a GIF's last frame stays up until the last frame seen ended
+    int status = exporter->failed;
+    if (exporter->options.format == CHIP8_EXPORT_GIF){
+        if (!status && exporter->has_pending){
+            status = write_gif_frame(exporter, exporter->frames_seen);
+        }
+        fputc(0x3B, exporter->file);
+    }
+    if (exporter->file){
+        status |= ferror(exporter->file) != 0;
+        status |= fclose(exporter->file) != 0;
+    }
+    if (status){
+        printf("Error: Can't write frames to %s\n", exporter->path);
+    }
+
+    free_exporter(exporter);
+    return status ? 1 : 0;
+
+}
+
+/*
+ * chip8_export_frames_written function
+ * Expects: NA
+ * Does: Returns how many frames have been queued to be written so far
+ *
+ */
+uint32_t chip8_export_frames_written(const chip8_exporter *exporter){
+    return exporter->frames_queued;
+}
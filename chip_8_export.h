@@ -0,0 +1,110 @@
+#ifndef chip8_export_h
+#define chip8_export_h
+#include <stdbool.h>
+#include <stdint.h>
+#include "chip_8_core.h"
+
+// Current version of the raw frame format, bumped whenever the layout changes
+#define CHIP8_EXPORT_RAW_VERSION 1
+
+typedef struct chip8_exporter chip8_exporter;
+
+/*
+ * chip8_export_format enum
+ * Expects: N/A
+ * Does: What an exporter writes, a raw C8FR stream (one file), a numbered PNG per frame or one animated GIF
+ */
+typedef enum chip8_export_format {
+    CHIP8_EXPORT_RAW,
+    CHIP8_EXPORT_PNG,
+    CHIP8_EXPORT_GIF
+} chip8_export_format;
+
+/*
+ * chip8_export_options struct
+ * Expects: N/A
+ * Does: Holds where and how frames are exported
+ */
+typedef struct chip8_export_options {
+
+    // File to write (PNG frames go next to it numbered path_000000.png and up), NULL exports nothing
+    const char *path;
+
+    chip8_export_format format;
+
+    // Only export frames the display changed in (a GIF holds the last one on screen for as long as it lasted)
+    bool changed_only;
+
+    // RGB for each combination of the two planes, 0 is the background and 1 the primary
+    u8 palette[4][3];
+
+} chip8_export_options;
+
+/*
+ * chip8_export_default_options function
+ * Expects: NA
+ * Does: Returns the options used when the user doesn't override them (no path, raw, every frame, the window's colors)
+ *
+ */
+chip8_export_options chip8_export_default_options(void);
+
+/*
+ * chip8_export_format_from_name function
+ * Expects: NA
+ * Does: Sets format from raw, png or gif and returns 0, else returns 1 (after printing why)
+ *
+ */
+int chip8_export_format_from_name(const char *name, chip8_export_format *format);
+
+/*
+ * chip8_export_format_for_path function
+ * Expects: NA
+ * Does: Returns the format a file extension calls for, .png PNG, .gif GIF and anything else raw
+ *
+ */
+chip8_export_format chip8_export_format_for_path(const char *path);
+
+/*
+ * chip8_export_extension function
+ * Expects: NA
+ * Does: Returns the file extension format is written with (raw frames use .c8f)
+ *
+ */
+const char *chip8_export_extension(chip8_export_format format);
+
+/*
+ * chip8_export_open function
+ * Expects: options->path to be set, chip_8_object to have its mode set (the mode decides the frame size)
+ * Does: Starts an exporter with its own encoder thread, returns NULL (after printing why) if the output can't be
+ * written
+ *
+ */
+chip8_exporter *chip8_export_open(const chip8_export_options *options, const chip_8 *chip_8_object);
+
+/*
+ * chip8_export_frame function
+ * Expects: to be called once per 60hz frame after the frame ran, nothing else to be consuming dirty_rows
+ * Does: Copies the display onto the encoder's queue (unless only changed frames are wanted and nothing was drawn)
+ * and clears dirty_rows, only waits when the queue is full. Returns 0 on success else 1 once encoding has failed
+ *
+ */
+int chip8_export_frame(chip8_exporter *exporter, chip_8 *chip_8_object);
+
+/*
+ * chip8_export_close function
+ * Expects: exporter to have come from chip8_export_open (or be NULL)
+ * Does: Waits for every queued frame to be written then closes and frees the exporter, returns 0 if everything
+ * was written else 1 (after printing why)
+ *
+ */
+int chip8_export_close(chip8_exporter *exporter);
+
+/*
+ * chip8_export_frames_written function
+ * Expects: NA
+ * Does: Returns how many frames have been queued to be written so far
+ *
+ */
+uint32_t chip8_export_frames_written(const chip8_exporter *exporter);
+
+#endif /* chip8_export_h */
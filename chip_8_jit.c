@@ -0,0 +1,537 @@
+#include "chip_8_jit.h"
+#include "chip_8_analysis.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#if defined(__x86_64__) && !defined(_WIN32)
+#include <sys/mman.h>
+
+// Size of the executable arena, when it fills up every block is thrown away and compiling starts over
+#define JIT_ARENA_SIZE (1024 * 1024)
+// Longest run of instructions compiled into one block
+#define JIT_MAX_BLOCK_LENGTH 64
+// Worst case bytes one instruction compiles to (a handler call) plus the block prologue/epilogue
+#define JIT_MAX_INSTRUCTION_BYTES 48
+// Blocks are tracked per 256 byte page so writes to pages with no code skip the block scan
+#define JIT_PAGE_SHIFT 8
+
+// Compiled blocks take the chip 8 and return how many instructions they executed
+typedef uint32_t (*jit_block_function)(chip_8 *chip_8_object);
+
+/*
+ * jit_block struct
+ * Expects: code to be NULL when no block starts at this address
+ * Does: A compiled straight line run of instructions starting at one address
+ */
+typedef struct jit_block {
+    jit_block_function code;
+    // Number of instructions in the block
+    u16 length;
+    // Address one past the last byte the block read
+    u16 end;
+    // The block reads or writes a timer so it can't run across a timer tick
+    bool uses_timers;
+} jit_block;
+
+/*
+ * chip8_jit struct
+ * Expects: N/A
+ * Does: The block cache for one chip 8 along with the executable memory the blocks live in
+ */
+struct chip8_jit {
+
+    // Blocks keyed by the address they start at (only the 4 KB modes are compiled)
+    jit_block blocks[CHIP8_MEMORY_SIZE];
+
+    // Copies of the decoded instructions handed to handlers called from native code, keyed by address
+    decoded_instruction operands[CHIP8_MEMORY_SIZE];
+
+    // One bit per page that any block has read from
+    uint32_t code_pages;
+
+    // Executable arena and how much of it is used
+    u8 *arena;
+    size_t arena_used;
+
+};
+
+/*
+ * code_buffer struct
+ * Expects: N/A
+ * Does: Where the instruction emitters are currently writing machine code
+ */
+typedef struct code_buffer {
+    u8 *start;
+    u8 *position;
+} code_buffer;
+
+/* x86-64 emitters, rbx holds the chip 8 pointer for the whole block */
+
+static void emit_u8(code_buffer *buffer, u8 value){
+    *buffer->position++ = value;
+}
+
+static void emit_u16(code_buffer *buffer, u16 value){
+    memcpy(buffer->position, &value, sizeof(value));
+    buffer->position += sizeof(value);
+}
+
+static void emit_u32(code_buffer *buffer, uint32_t value){
+    memcpy(buffer->position, &value, sizeof(value));
+    buffer->position += sizeof(value);
+}
+
+static void emit_u64(code_buffer *buffer, uint64_t value){
+    memcpy(buffer->position, &value, sizeof(value));
+    buffer->position += sizeof(value);
+}
+
+// Displacements of the fields native code touches
+#define V_OFFSET(index) ((uint32_t)(offsetof(chip_8, V) + (index)))
+#define I_OFFSET ((uint32_t)offsetof(chip_8, I))
+#define PC_OFFSET ((uint32_t)offsetof(chip_8, PC))
+#define DELAY_OFFSET ((uint32_t)offsetof(chip_8, delay_register))
+#define SOUND_OFFSET ((uint32_t)offsetof(chip_8, sound_register))
+
+// movzx eax, byte [rbx + offset]
+static void emit_load_byte_eax(code_buffer *buffer, uint32_t offset){
+    emit_u8(buffer, 0x0F); emit_u8(buffer, 0xB6); emit_u8(buffer, 0x83); emit_u32(buffer, offset);
+}
+
+// movzx ecx, byte [rbx + offset]
+static void emit_load_byte_ecx(code_buffer *buffer, uint32_t offset){
+    emit_u8(buffer, 0x0F); emit_u8(buffer, 0xB6); emit_u8(buffer, 0x8B); emit_u32(buffer, offset);
+}
+
+// mov byte [rbx + offset], al
+static void emit_store_byte_al(code_buffer *buffer, uint32_t offset){
+    emit_u8(buffer, 0x88); emit_u8(buffer, 0x83); emit_u32(buffer, offset);
+}
+
+// mov byte [rbx + offset], value
+static void emit_store_byte_immediate(code_buffer *buffer, uint32_t offset, u8 value){
+    emit_u8(buffer, 0xC6); emit_u8(buffer, 0x83); emit_u32(buffer, offset); emit_u8(buffer, value);
+}
+
+// mov word [rbx + offset], value
+static void emit_store_word_immediate(code_buffer *buffer, uint32_t offset, u16 value){
+    emit_u8(buffer, 0x66); emit_u8(buffer, 0xC7); emit_u8(buffer, 0x83); emit_u32(buffer, offset); emit_u16(buffer, value);
+}
+
+// <or/and/xor> byte [rbx + offset], al
+static void emit_logic_byte_al(code_buffer *buffer, u8 opcode, uint32_t offset){
+    emit_u8(buffer, opcode); emit_u8(buffer, 0x83); emit_u32(buffer, offset);
+}
+
+// push rbx, mov rbx, rdi
+static void emit_prologue(code_buffer *buffer){
+    emit_u8(buffer, 0x53);
+    emit_u8(buffer, 0x48); emit_u8(buffer, 0x89); emit_u8(buffer, 0xFB);
+}
+
+// mov eax, length, pop rbx, ret
+static void emit_epilogue(code_buffer *buffer, uint32_t length){
+    emit_u8(buffer, 0xB8); emit_u32(buffer, length);
+    emit_u8(buffer, 0x5B);
+    emit_u8(buffer, 0xC3);
+}
+
+// handler(chip_8_object, operands) through rax
+static void emit_handler_call(code_buffer *buffer, opcode_handler handler, const decoded_instruction *operands){
+    // mov rdi, rbx
+    emit_u8(buffer, 0x48); emit_u8(buffer, 0x89); emit_u8(buffer, 0xDF);
+    // mov rsi, operands
+    emit_u8(buffer, 0x48); emit_u8(buffer, 0xBE); emit_u64(buffer, (uint64_t)(uintptr_t)operands);
+    // mov rax, handler
+    emit_u8(buffer, 0x48); emit_u8(buffer, 0xB8); emit_u64(buffer, (uint64_t)(uintptr_t)handler);
+    // call rax
+    emit_u8(buffer, 0xFF); emit_u8(buffer, 0xD0);
+}
+
+/*
+ * ends_block function
+ * Expects: NA
+ * Does: Returns true for opcodes that move the PC somewhere other than the next instruction (jumps, calls,
+ * returns, skips, and draw/key waits that repeat themselves) or write memory that may hold code
+ *
+ */
+static bool ends_block(u8 opcode){
+    switch (opcode){
+        case OPCODE_RETURN:
+        case OPCODE_JUMP:
+        case OPCODE_CALL:
+        case OPCODE_JUMP_OFFSET:
+        case OPCODE_EXIT:
+        case OPCODE_SKIP_IF_EQUAL_IMMEDIATE:
+        case OPCODE_SKIP_IF_NOT_EQUAL_IMMEDIATE:
+        case OPCODE_SKIP_IF_EQUAL_REGISTER:
+        case OPCODE_SKIP_IF_NOT_EQUAL_REGISTER:
+        case OPCODE_SKIP_IF_KEY:
+        case OPCODE_SKIP_IF_NOT_KEY:
+        case OPCODE_DRAW:
+        case OPCODE_EXTENDED_DRAW:
+        case OPCODE_WAIT_FOR_KEY:
+        case OPCODE_BCD:
+        case OPCODE_STORE_REGISTERS:
+            return true;
+    }
+    return false;
+}
+
+/*
+ * uses_timers function
+ * Expects: NA
+ * Does: Returns true for opcodes that read or write the delay, sound or display wait timers
+ *
+ */
+static bool uses_timers(u8 opcode){
+    switch (opcode){
+        case OPCODE_READ_DELAY:
+        case OPCODE_SET_DELAY:
+        case OPCODE_SET_SOUND:
+        case OPCODE_DRAW:
+        case OPCODE_EXTENDED_DRAW:
+            return true;
+    }
+    return false;
+}
+
+/*
+ * emit_inline function
+ * Expects: decoded to be the instruction being compiled
+ * Does: Emits native code for the simple register opcodes and returns true, returns false for anything
+ * that has to go through its handler
+ *
+ */
+static bool emit_inline(code_buffer *buffer, const decoded_instruction *decoded){
+    switch (decoded->opcode){
+        // 6XNN
+        case OPCODE_SET_IMMEDIATE:
+            emit_store_byte_immediate(buffer, V_OFFSET(decoded->x), decoded->nn);
+            return true;
+        // 7XNN add byte [rbx + Vx], nn
+        case OPCODE_ADD_IMMEDIATE:
+            emit_u8(buffer, 0x80); emit_u8(buffer, 0x83); emit_u32(buffer, V_OFFSET(decoded->x)); emit_u8(buffer, decoded->nn);
+            return true;
+        // 8XY0
+        case OPCODE_SET_REGISTER:
+            emit_load_byte_eax(buffer, V_OFFSET(decoded->y));
+            emit_store_byte_al(buffer, V_OFFSET(decoded->x));
+            return true;
+        // 8XY1, 8XY2, 8XY3 with the vf reset quirk baked in when the block is compiled
+        case OPCODE_OR:
+        case OPCODE_AND:
+        case OPCODE_XOR:
+            emit_load_byte_eax(buffer, V_OFFSET(decoded->y));
+            emit_logic_byte_al(buffer, decoded->opcode == OPCODE_OR ? 0x08 : (decoded->opcode == OPCODE_AND ? 0x20 : 0x30), V_OFFSET(decoded->x));
+            if (vf_reset_quirk){
+                emit_store_byte_immediate(buffer, V_OFFSET(15), 0);
+            }
+            return true;
+        // 8XY4 the 9 bit sum goes to Vx then its carry to VF (in that order so VF wins when X is F)
+        case OPCODE_ADD_REGISTER:
+            emit_load_byte_eax(buffer, V_OFFSET(decoded->x));
+            emit_load_byte_ecx(buffer, V_OFFSET(decoded->y));
+            // add eax, ecx
+            emit_u8(buffer, 0x01); emit_u8(buffer, 0xC8);
+            emit_store_byte_al(buffer, V_OFFSET(decoded->x));
+            // shr eax, 8
+            emit_u8(buffer, 0xC1); emit_u8(buffer, 0xE8); emit_u8(buffer, 0x08);
+            emit_store_byte_al(buffer, V_OFFSET(15));
+            return true;
+        // ANNN
+        case OPCODE_SET_INDEX:
+            emit_store_word_immediate(buffer, I_OFFSET, decoded->nnn);
+            return true;
+        // FX1E add word [rbx + I], ax
+        case OPCODE_ADD_INDEX:
+            emit_load_byte_eax(buffer, V_OFFSET(decoded->x));
+            emit_u8(buffer, 0x66); emit_u8(buffer, 0x01); emit_u8(buffer, 0x83); emit_u32(buffer, I_OFFSET);
+            return true;
+        // FX07
+        case OPCODE_READ_DELAY:
+            emit_load_byte_eax(buffer, DELAY_OFFSET);
+            emit_store_byte_al(buffer, V_OFFSET(decoded->x));
+            return true;
+        // FX15
+        case OPCODE_SET_DELAY:
+            emit_load_byte_eax(buffer, V_OFFSET(decoded->x));
+            emit_store_byte_al(buffer, DELAY_OFFSET);
+            return true;
+        // FX18
+        case OPCODE_SET_SOUND:
+            emit_load_byte_eax(buffer, V_OFFSET(decoded->x));
+            emit_store_byte_al(buffer, SOUND_OFFSET);
+            return true;
+    }
+    return false;
+}
+
+/*
+ * compile_block function
+ * Expects: start to be inside the loaded rom and the arena to have room for a whole block
+ * Does: Compiles instructions from start until one ends the block, the rom ends, the block is full or (when the rom
+ * was analysed) another basic block starts
+ *
+ */
+static jit_block *compile_block(chip_8 *chip_8_object, chip8_jit *jit, u16 start){
+
+    code_buffer buffer;
+    buffer.start = jit->arena + jit->arena_used;
+    buffer.position = buffer.start;
+
+    emit_prologue(&buffer);
+
+    u16 address = start;
+    uint32_t length = 0;
+    bool ended = false;
+    bool timers = false;
+
+    // With the rom analysed blocks stop where a basic block starts, so code that's jumped into the middle of is
+    // compiled once rather than again in every block running into it
+    const chip8_analysis *analysis = chip_8_object->analysis;
+
+    while (!ended && length < JIT_MAX_BLOCK_LENGTH && address < chip_8_object->rom_end){
+
+        if (analysis && address != start && (analysis->flags[address] & CHIP8_ANALYSIS_LEADER)){
+            break;
+        }
+
+        const decoded_instruction *decoded = chip8_decode_at(chip_8_object, address);
+        u16 next_address = address + 2;
+        length++;
+        timers |= uses_timers(decoded->opcode);
+
+        if (ends_block(decoded->opcode)){
+            // Handlers expect the PC to already be past their instruction
+            emit_store_word_immediate(&buffer, PC_OFFSET, next_address);
+            jit->operands[address] = *decoded;
+            emit_handler_call(&buffer, decoded->handler, &jit->operands[address]);
+            ended = true;
+        }
+        else if (!emit_inline(&buffer, decoded)){
+            jit->operands[address] = *decoded;
+            emit_handler_call(&buffer, decoded->handler, &jit->operands[address]);
+        }
+
+        address = next_address;
+    }
+
+    // Fell off the end of the block so carry on from the next instruction
+    if (!ended){
+        emit_store_word_immediate(&buffer, PC_OFFSET, address);
+    }
+    emit_epilogue(&buffer, length);
+
+    jit->arena_used += buffer.position - buffer.start;
+
+    // Remember every page the block read so writes there can find it
+    for (int page = start >> JIT_PAGE_SHIFT; page <= ((address - 1) & (CHIP8_MEMORY_SIZE - 1)) >> JIT_PAGE_SHIFT; page++){
+        jit->code_pages |= 1u << page;
+    }
+
+    jit_block *block = &jit->blocks[start];
+    block->code = (jit_block_function)(void *)buffer.start;
+    block->length = length;
+    block->end = address;
+    block->uses_timers = timers;
+    return block;
+
+}
+
+/*
+ * chip8_jit_create function
+ * Expects: NA
+ * Does: Allocates an empty block cache and executable code arena, returns NULL if the host isn't x86-64 or
+ * refuses executable memory (callers then just keep using the interpreter)
+ *
+ */
+chip8_jit *chip8_jit_create(void){
+
+    chip8_jit *jit = calloc(1, sizeof(chip8_jit));
+    if (!jit){
+        return NULL;
+    }
+
+    jit->arena = mmap(NULL, JIT_ARENA_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (jit->arena == MAP_FAILED){
+        free(jit);
+        return NULL;
+    }
+
+    return jit;
+
+}
+
+/*
+ * chip8_jit_destroy function
+ * Expects: jit to have come from chip8_jit_create (or be NULL) and not be attached to a running chip 8
+ * Does: Frees the code arena and the block cache
+ *
+ */
+void chip8_jit_destroy(chip8_jit *jit){
+    if (!jit){
+        return;
+    }
+    munmap(jit->arena, JIT_ARENA_SIZE);
+    free(jit);
+}
+
+/*
+ * chip8_jit_flush function
+ * Expects: jit to not be in the middle of running a block
+ * Does: Throws away every compiled block
+ *
+ */
+void chip8_jit_flush(chip8_jit *jit){
+    memset(jit->blocks, 0, sizeof(jit->blocks));
+    jit->code_pages = 0;
+    jit->arena_used = 0;
+}
+
+/*
+ * chip8_jit_invalidate function
+ * Expects: first and last to be memory addresses that were just written (inclusive)
+ * Does: Throws away every block whose instructions overlap that range, safe to call from inside a running block
+ *
+ */
+void chip8_jit_invalidate(chip8_jit *jit, int first, int last){
+
+    // Nothing past the 4 KB modes' memory is ever compiled
+    if (first >= CHIP8_MEMORY_SIZE){
+        return;
+    }
+    if (last >= CHIP8_MEMORY_SIZE){
+        last = CHIP8_MEMORY_SIZE - 1;
+    }
+
+    // Most writes land in data pages no block was compiled from
+    uint32_t written_pages = 0;
+    for (int page = first >> JIT_PAGE_SHIFT; page <= last >> JIT_PAGE_SHIFT; page++){
+        written_pages |= 1u << page;
+    }
+    if (!(written_pages & jit->code_pages)){
+        return;
+    }
+
+    // Only blocks starting at most one block length before the write can reach it
+    int earliest = first - JIT_MAX_BLOCK_LENGTH * 2;
+    if (earliest < 0){
+        earliest = 0;
+    }
+
+    // Only unlink the blocks, their code stays in the arena until the next flush so a block
+    // that wrote over itself can still return safely
+    for (int i = earliest; i <= last; i++){
+        jit_block *block = &jit->blocks[i];
+        if (block->code && block->end > first){
+            block->code = NULL;
+        }
+    }
+
+}
+
+/*
+ * chip8_jit_attach function
+ * Expects: chip_8_object to be initialized and jit to be unused by any other chip 8
+ * Does: Throws away any blocks the jit holds and makes chip8_run on chip_8_object use it (NULL detaches)
+ *
+ */
+void chip8_jit_attach(chip_8 *chip_8_object, chip8_jit *jit){
+    if (jit){
+        chip8_jit_flush(jit);
+    }
+    chip_8_object->jit = jit;
+}
+
+/*
+ * chip8_jit_run function
+ * Expects: chip_8_object to have a jit attached
+ * Does: Same contract as chip8_run but runs straight line blocks as native code, compiling them on first use
+ * and falling back to the interpreter for a single instruction when a block doesn't fit in the cycles left
+ *
+ */
+uint64_t chip8_jit_run(chip_8 *chip_8_object, uint64_t cycles){
+
+    chip8_jit *jit = chip_8_object->jit;
+    uint64_t executed = 0;
+
+    while (executed < cycles && chip8_is_running(chip_8_object)){
+
+        // Idle loops are fast forwarded instead of being run (see chip8_skip_idle)
+        uint64_t until_tick = chip_8_object->cycles_until_tick;
+        if (until_tick > cycles - executed){
+            until_tick = cycles - executed;
+        }
+        uint64_t idle = chip8_skip_idle(chip_8_object, until_tick, cycles - executed);
+        if (idle){
+            executed += idle;
+            update_time_registers(chip_8_object, idle);
+            continue;
+        }
+
+        u16 address = chip_8_object->PC & (CHIP8_MEMORY_SIZE - 1);
+        jit_block *block = &jit->blocks[address];
+
+        if (!block->code){
+            // Start over once the arena can't be trusted to fit another block
+            if (jit->arena_used + (JIT_MAX_BLOCK_LENGTH + 1) * JIT_MAX_INSTRUCTION_BYTES > JIT_ARENA_SIZE){
+                chip8_jit_flush(jit);
+            }
+            block = compile_block(chip_8_object, jit, address);
+        }
+
+        // Blocks always run to completion so only enter one that fits in what's left of the budget, and one that
+        // touches a timer only if it ends before the next tick (the rest can't tell when the tick lands)
+        uint32_t ran;
+        if (block->length <= cycles - executed &&
+            (!block->uses_timers || block->length <= chip_8_object->cycles_until_tick)){
+            ran = block->code(chip_8_object);
+        }
+        else {
+            chip8_step(chip_8_object);
+            ran = 1;
+        }
+
+        executed += ran;
+        update_time_registers(chip_8_object, ran);
+    }
+
+    return executed;
+
+}
+
+#else
+
+/* Not an x86-64 host so there is nothing to compile to, chip8_jit_create says so and everything else is inert */
+
+chip8_jit *chip8_jit_create(void){
+    return NULL;
+}
+
+void chip8_jit_destroy(chip8_jit *jit){
+    (void)jit;
+}
+
+void chip8_jit_flush(chip8_jit *jit){
+    (void)jit;
+}
+
+void chip8_jit_invalidate(chip8_jit *jit, int first, int last){
+    (void)jit;
+    (void)first;
+    (void)last;
+}
+
+void chip8_jit_attach(chip_8 *chip_8_object, chip8_jit *jit){
+    chip_8_object->jit = jit;
+}
+
+uint64_t chip8_jit_run(chip_8 *chip_8_object, uint64_t cycles){
+    chip_8_object->jit = NULL;
+    return chip8_run(chip_8_object, cycles);
+}
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef chip8_jit_h
+#define chip8_jit_h
+#include <stdbool.h>
+#include <stdint.h>
+#include "chip_8_core.h"
+
+/*
+ * chip8_jit_create function
+ * Expects: NA
+ * Does: Allocates an empty block cache and executable code arena, returns NULL if the host isn't x86-64 or
+ * refuses executable memory (callers then just keep using the interpreter)
+ *
+ */
+chip8_jit *chip8_jit_create(void);
+
+/*
+ * chip8_jit_destroy function
+ * Expects: jit to have come from chip8_jit_create (or be NULL) and not be attached to a running chip 8
+ * Does: Frees the code arena and the block cache
+ *
+ */
+void chip8_jit_destroy(chip8_jit *jit);
+
+/*
+ * chip8_jit_attach function
+ * Expects: chip_8_object to be initialized and jit to be unused by any other chip 8
+ * Does: Throws away any blocks the jit holds and makes chip8_run on chip_8_object use it (NULL detaches)
+ *
+ */
+void chip8_jit_attach(chip_8 *chip_8_object, chip8_jit *jit);
+
+/*
+ * chip8_jit_flush function
+ * Expects: jit to not be in the middle of running a block
+ * Does: Throws away every compiled block
+ *
+ */
+void chip8_jit_flush(chip8_jit *jit);
+
+/*
+ * chip8_jit_invalidate function
+ * Expects: first and last to be memory addresses that were just written (inclusive)
+ * Does: Throws away every block whose instructions overlap that range, safe to call from inside a running block
+ *
+ */
+void chip8_jit_invalidate(chip8_jit *jit, int first, int last);
+
+/*
+ * chip8_jit_run function
+ * Expects: chip_8_object to have a jit attached
+ * Does: Same contract as chip8_run but runs straight line blocks as native code, compiling them on first use
+ * and falling back to the interpreter for a single instruction when a block doesn't fit in the cycles left (or
+ * touches a timer and doesn't fit before the next timer tick)
+ *
+ */
+uint64_t chip8_jit_run(chip_8 *chip_8_object, uint64_t cycles);
+
+#endif /* chip8_jit_h */
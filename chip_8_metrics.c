@@ -0,0 +1,461 @@
+#include "chip_8_metrics.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "timing.h"
+
+// Prefix that makes a dump destination a UNIX socket instead of a file
+#define SOCKET_PREFIX "unix:"
+
+// Names used in the JSON, indexed by chip8_counter and chip8_histogram
+static const char *const counter_names[CHIP8_COUNTER_COUNT] = {
+    [CHIP8_COUNTER_INSTRUCTIONS] = "instructions",
+    [CHIP8_COUNTER_FRAMES] = "frames",
+    [CHIP8_COUNTER_SPRITES] = "sprites",
+    [CHIP8_COUNTER_PRESENTS] = "presents"
+};
+static const char *const histogram_names[CHIP8_HISTOGRAM_COUNT] = {
+    [CHIP8_HISTOGRAM_EXECUTE] = "execute_ns",
+    [CHIP8_HISTOGRAM_PRESENT] = "present_ns",
+    [CHIP8_HISTOGRAM_SLEEP_OVERSHOOT] = "sleep_overshoot_ns",
+    [CHIP8_HISTOGRAM_INPUT_LATENCY] = "input_latency_ns"
+};
+
+/*
+ * chip8_metrics_dump struct
+ * Expects: N/A
+ * Does: A dump thread and where it writes to, stop is guarded by lock and signalled through wake
+ */
+struct chip8_metrics_dump {
+
+    chip8_metrics *metrics;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    bool stop;
+
+    unsigned int interval_ms;
+    char path[1024];
+    char temporary_path[1040];
+    bool is_socket;
+    int socket_fd;
+
+    // A failing file is only reported the first time
+    bool reported_failure;
+
+    // Where the last interval ended
+    chip8_metrics_snapshot before;
+
+};
+
+/*
+ * chip8_metrics_create function
+ * Expects: NA
+ * Does: Allocates metrics with everything at zero, returns NULL if out of memory
+ *
+ */
+chip8_metrics *chip8_metrics_create(void){
+
+    chip8_metrics *metrics = malloc(sizeof(chip8_metrics));
+    if (!metrics){
+        return NULL;
+    }
+    for (int i = 0; i < CHIP8_COUNTER_COUNT; i++){
+        atomic_init(&metrics->counters[i], 0);
+    }
+    for (int i = 0; i < CHIP8_HISTOGRAM_COUNT; i++){
+        atomic_init(&metrics->sums[i], 0);
+        for (int j = 0; j < CHIP8_METRICS_BUCKETS; j++){
+            atomic_init(&metrics->buckets[i][j], 0);
+        }
+    }
+    metrics->start_ns = monotonic_ns();
+    metrics->dump = NULL;
+    return metrics;
+
+}
+
+/*
+ * chip8_metrics_destroy function
+ * Expects: metrics to have come from chip8_metrics_create (or be NULL) and nothing else to be using them
+ * Does: Stops the dump thread if there is one and frees the metrics
+ *
+ */
+void chip8_metrics_destroy(chip8_metrics *metrics){
+    if (!metrics){
+        return;
+    }
+    chip8_metrics_stop_dump(metrics);
+    free(metrics);
+}
+
+/*
+ * bucket_index function
+ * Expects: NA
+ * Does: Returns the histogram bucket value falls in
+ *
+ */
+static int bucket_index(uint64_t value){
+    if (value < CHIP8_METRICS_SUB_BUCKETS){
+        return (int)value;
+    }
+    int exponent = 63 - __builtin_clzll(value);
+    return (exponent - 2) * CHIP8_METRICS_SUB_BUCKETS + (int)((value >> (exponent - 3)) & (CHIP8_METRICS_SUB_BUCKETS - 1));
+}
+
+/*
+ * bucket_top function
+ * Expects: index to be a bucket
+ * Does: Returns the highest value that falls in bucket index
+ *
+ */
+static uint64_t bucket_top(int index){
+    if (index < CHIP8_METRICS_SUB_BUCKETS){
+        return (uint64_t)index;
+    }
+    int exponent = index / CHIP8_METRICS_SUB_BUCKETS + 2;
+    uint64_t bottom = (uint64_t)(CHIP8_METRICS_SUB_BUCKETS + index % CHIP8_METRICS_SUB_BUCKETS) << (exponent - 3);
+    return bottom + ((uint64_t)1 << (exponent - 3)) - 1;
+}
+
+/*
+ * chip8_metrics_record function
+ * Expects: NA
+ * Does: Adds one duration of value_ns to histogram, safe from any thread
+ *
+ */
+void chip8_metrics_record(chip8_metrics *metrics, chip8_histogram histogram, uint64_t value_ns){
+    atomic_fetch_add_explicit(&metrics->buckets[histogram][bucket_index(value_ns)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&metrics->sums[histogram], value_ns, memory_order_relaxed);
+}
+
+/*
+ * chip8_metrics_take_snapshot function
+ * Expects: NA
+ * Does: Copies every counter and histogram into snapshot
+ *
+ */
+void chip8_metrics_take_snapshot(const chip8_metrics *metrics, chip8_metrics_snapshot *snapshot){
+
+    snapshot->taken_ns = monotonic_ns();
+    for (int i = 0; i < CHIP8_COUNTER_COUNT; i++){
+        snapshot->counters[i] = atomic_load_explicit(&metrics->counters[i], memory_order_relaxed);
+    }
+    for (int i = 0; i < CHIP8_HISTOGRAM_COUNT; i++){
+        snapshot->sums[i] = atomic_load_explicit(&metrics->sums[i], memory_order_relaxed);
+        for (int j = 0; j < CHIP8_METRICS_BUCKETS; j++){
+            snapshot->buckets[i][j] = atomic_load_explicit(&metrics->buckets[i][j], memory_order_relaxed);
+        }
+    }
+
+}
+
+/*
+ * summarize_histogram function
+ * Expects: buckets to hold how many durations fell in each bucket over the interval and sum their total
+ * Does: Fills summary with the count, mean, percentiles and max of the durations
+ *
+ */
+static void summarize_histogram(const uint64_t *buckets, uint64_t sum, chip8_histogram_summary *summary){
+
+    memset(summary, 0, sizeof(*summary));
+    for (int i = 0; i < CHIP8_METRICS_BUCKETS; i++){
+        summary->count += buckets[i];
+    }
+    if (summary->count == 0){
+        return;
+    }
+    summary->mean_ns = sum / summary->count;
+
+    // The Nth percentile is the bucket the first count * N / 100 durations (rounded up) reach into
+    uint64_t p50 = (summary->count * 50 + 99) / 100;
+    uint64_t p90 = (summary->count * 90 + 99) / 100;
+    uint64_t p99 = (summary->count * 99 + 99) / 100;
+    uint64_t seen = 0;
+    for (int i = 0; i < CHIP8_METRICS_BUCKETS; i++){
+        if (buckets[i] == 0){
+            continue;
+        }
+        uint64_t before = seen;
+        seen += buckets[i];
+        if (before < p50 && seen >= p50) summary->p50_ns = bucket_top(i);
+        if (before < p90 && seen >= p90) summary->p90_ns = bucket_top(i);
+        if (before < p99 && seen >= p99) summary->p99_ns = bucket_top(i);
+        summary->max_ns = bucket_top(i);
+    }
+
+}
+
+/*
+ * chip8_metrics_summarize function
+ * Expects: before to have been taken earlier than now from the same metrics (or be NULL to summarize from start)
+ * Does: Fills summary with the rates and histogram percentiles between the two snapshots
+ *
+ */
+void chip8_metrics_summarize(const chip8_metrics *metrics, const chip8_metrics_snapshot *now,
+                             const chip8_metrics_snapshot *before, chip8_metrics_summary *summary){
+
+    uint64_t start_ns = before ? before->taken_ns : metrics->start_ns;
+    summary->seconds = (now->taken_ns - start_ns) / 1e9;
+    summary->uptime_seconds = (now->taken_ns - metrics->start_ns) / 1e9;
+
+    for (int i = 0; i < CHIP8_COUNTER_COUNT; i++){
+        uint64_t added = now->counters[i] - (before ? before->counters[i] : 0);
+        summary->totals[i] = now->counters[i];
+        summary->per_second[i] = summary->seconds > 0 ? added / summary->seconds : 0.0;
+    }
+
+    uint64_t buckets[CHIP8_METRICS_BUCKETS];
+    for (int i = 0; i < CHIP8_HISTOGRAM_COUNT; i++){
+        for (int j = 0; j < CHIP8_METRICS_BUCKETS; j++){
+            buckets[j] = now->buckets[i][j] - (before ? before->buckets[i][j] : 0);
+        }
+        summarize_histogram(buckets, now->sums[i] - (before ? before->sums[i] : 0), &summary->histograms[i]);
+    }
+
+}
+
+/*
+ * chip8_metrics_format_json function
+ * Expects: buffer to hold size bytes (CHIP8_METRICS_JSON_SIZE always fits)
+ * Does: Writes summary as a single line JSON object ending in a newline, returns its length
+ *
+ */
+size_t chip8_metrics_format_json(const chip8_metrics_summary *summary, char *buffer, size_t size){
+
+    size_t length = 0;
+#define APPEND(...) \
+    if (length < size) length += snprintf(buffer + length, size - length, __VA_ARGS__)
+
+    APPEND("{\"uptime_s\": %.3f, \"interval_s\": %.3f, \"counters\": {", summary->uptime_seconds, summary->seconds);
+    for (int i = 0; i < CHIP8_COUNTER_COUNT; i++){
+        APPEND("%s\"%s\": {\"total\": %llu, \"per_second\": %.1f}", i ? ", " : "", counter_names[i],
+               (unsigned long long)summary->totals[i], summary->per_second[i]);
+    }
+    APPEND("}, \"histograms\": {");
+    for (int i = 0; i < CHIP8_HISTOGRAM_COUNT; i++){
+        const chip8_histogram_summary *histogram = &summary->histograms[i];
+        APPEND("%s\"%s\": {\"count\": %llu, \"mean\": %llu, \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"max\": %llu}",
+               i ? ", " : "", histogram_names[i], (unsigned long long)histogram->count,
+               (unsigned long long)histogram->mean_ns, (unsigned long long)histogram->p50_ns,
+               (unsigned long long)histogram->p90_ns, (unsigned long long)histogram->p99_ns,
+               (unsigned long long)histogram->max_ns);
+    }
+    APPEND("}}\n");
+
+#undef APPEND
+    return length < size ? length : size - 1;
+
+}
+
+/*
+ * connect_socket function
+ * Expects: dump->path to be the socket's path
+ * Does: Connects dump to its UNIX socket, returns 0 on success else 1
+ *
+ */
+static int connect_socket(struct chip8_metrics_dump *dump){
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    // chip8_metrics_start_dump already checked the path fits
+    memcpy(address.sun_path, dump->path, strlen(dump->path) + 1);
+
+    dump->socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (dump->socket_fd < 0){
+        return 1;
+    }
+#ifdef SO_NOSIGPIPE
+    // macOS has no MSG_NOSIGNAL, a reader going away must not kill the emulator
+    int on = 1;
+    setsockopt(dump->socket_fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+    if (connect(dump->socket_fd, (struct sockaddr *)&address, sizeof(address)) != 0){
+        close(dump->socket_fd);
+        dump->socket_fd = -1;
+        return 1;
+    }
+    return 0;
+
+}
+
+/*
+ * write_dump function
+ * Expects: to be called from the dump thread
+ * Does: Writes the summary of everything since the last dump to the file or socket
+ *
+ */
+static void write_dump(struct chip8_metrics_dump *dump){
+
+    chip8_metrics_snapshot *now = malloc(sizeof(chip8_metrics_snapshot));
+    if (!now){
+        return;
+    }
+    chip8_metrics_take_snapshot(dump->metrics, now);
+    chip8_metrics_summary summary;
+    chip8_metrics_summarize(dump->metrics, now, &dump->before, &summary);
+    dump->before = *now;
+    free(now);
+
+    char json[CHIP8_METRICS_JSON_SIZE];
+    size_t length = chip8_metrics_format_json(&summary, json, sizeof(json));
+
+    if (dump->is_socket){
+        // A reader that went away gets reconnected to on a later dump
+        if (dump->socket_fd < 0 && connect_socket(dump) != 0){
+            return;
+        }
+#ifdef MSG_NOSIGNAL
+        int flags = MSG_NOSIGNAL;
+#else
+        int flags = 0;
+#endif
+        if (send(dump->socket_fd, json, length, flags) != (ssize_t)length){
+            close(dump->socket_fd);
+            dump->socket_fd = -1;
+        }
+        return;
+    }
+
+    // Readers only ever see a whole dump as the finished file replaces the old one in one step
+    FILE *out = fopen(dump->temporary_path, "w");
+    bool written = out && fwrite(json, 1, length, out) == length;
+    if (out && fclose(out) != 0){
+        written = false;
+    }
+    if (!written || rename(dump->temporary_path, dump->path) != 0){
+        if (!dump->reported_failure){
+            printf("Error: Can't write metrics to %s\n", dump->path);
+            dump->reported_failure = true;
+        }
+    }
+
+}
+
+/*
+ * dump_main function
+ * Expects: arg to be the metrics' chip8_metrics_dump
+ * Does: Writes a dump every interval until asked to stop, then writes one last one
+ *
+ */
+static void *dump_main(void *arg){
+
+    struct chip8_metrics_dump *dump = arg;
+
+    // Condition variables wait on the wall clock, the intervals only need to be roughly even
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+
+    pthread_mutex_lock(&dump->lock);
+    while (!dump->stop){
+        deadline.tv_sec += dump->interval_ms / 1000;
+        deadline.tv_nsec += (long)(dump->interval_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L){
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        int waited = 0;
+        while (!dump->stop && waited != ETIMEDOUT){
+            waited = pthread_cond_timedwait(&dump->wake, &dump->lock, &deadline);
+        }
+        pthread_mutex_unlock(&dump->lock);
+        write_dump(dump);
+        pthread_mutex_lock(&dump->lock);
+    }
+    pthread_mutex_unlock(&dump->lock);
+    return NULL;
+
+}
+
+/*
+ * chip8_metrics_start_dump function
+ * Expects: destination to be a file path or unix:path for a UNIX stream socket, interval_ms to be above 0
+ * Does: Starts a thread that writes a JSON summary of each interval to destination, returns 0 on success else 1
+ * (after printing why)
+ *
+ */
+int chip8_metrics_start_dump(chip8_metrics *metrics, const char *destination, unsigned int interval_ms){
+
+    struct chip8_metrics_dump *dump = calloc(1, sizeof(struct chip8_metrics_dump));
+    if (!dump){
+        printf("Error: Out of memory for the metrics dump\n");
+        return 1;
+    }
+    dump->metrics = metrics;
+    dump->interval_ms = interval_ms;
+    dump->socket_fd = -1;
+    dump->is_socket = strncmp(destination, SOCKET_PREFIX, strlen(SOCKET_PREFIX)) == 0;
+    const char *path = dump->is_socket ? destination + strlen(SOCKET_PREFIX) : destination;
+
+    struct sockaddr_un address;
+    size_t longest = dump->is_socket ? sizeof(address.sun_path) : sizeof(dump->path);
+    if (strlen(path) == 0 || strlen(path) >= longest){
+        printf("Error: Bad metrics destination %s\n", destination);
+        free(dump);
+        return 1;
+    }
+    strcpy(dump->path, path);
+    snprintf(dump->temporary_path, sizeof(dump->temporary_path), "%s.tmp", path);
+
+    if (dump->is_socket && connect_socket(dump) != 0){
+        printf("Error: Can't connect to the metrics socket %s\n", path);
+        free(dump);
+        return 1;
+    }
+
+    // The first interval starts from when the metrics were created
+    memset(&dump->before, 0, sizeof(dump->before));
+    dump->before.taken_ns = metrics->start_ns;
+
+    pthread_mutex_init(&dump->lock, NULL);
+    pthread_cond_init(&dump->wake, NULL);
+    if (pthread_create(&dump->thread, NULL, dump_main, dump) != 0){
+        printf("Error: Can't start the metrics dump thread\n");
+        pthread_mutex_destroy(&dump->lock);
+        pthread_cond_destroy(&dump->wake);
+        if (dump->socket_fd >= 0){
+            close(dump->socket_fd);
+        }
+        free(dump);
+        return 1;
+    }
+    metrics->dump = dump;
+    return 0;
+
+}
+
+/*
+ * chip8_metrics_stop_dump function
+ * Expects: NA
+ * Does: Writes one last dump and stops the dump thread, does nothing if there isn't one
+ *
+ */
+void chip8_metrics_stop_dump(chip8_metrics *metrics){
+
+    struct chip8_metrics_dump *dump = metrics->dump;
+    if (!dump){
+        return;
+    }
+    pthread_mutex_lock(&dump->lock);
+    dump->stop = true;
+    pthread_cond_signal(&dump->wake);
+    pthread_mutex_unlock(&dump->lock);
+    pthread_join(dump->thread, NULL);
+
+    pthread_mutex_destroy(&dump->lock);
+    pthread_cond_destroy(&dump->wake);
+    if (dump->socket_fd >= 0){
+        close(dump->socket_fd);
+    }
+    free(dump);
+    metrics->dump = NULL;
+
+}
@@ -0,0 +1,180 @@
+#ifndef chip8_metrics_h
+#define chip8_metrics_h
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Histogram buckets: one per value below 8, then 8 linear sub buckets per power of two (within 12.5% of any value)
+#define CHIP8_METRICS_SUB_BUCKETS 8
+#define CHIP8_METRICS_BUCKETS ((64 - 2) * CHIP8_METRICS_SUB_BUCKETS)
+
+// Biggest JSON document chip8_metrics_format_json writes
+#define CHIP8_METRICS_JSON_SIZE 4096
+
+/*
+ * chip8_counter enum
+ * Expects: N/A
+ * Does: Running totals the metrics keep
+ */
+typedef enum chip8_counter {
+    CHIP8_COUNTER_INSTRUCTIONS,
+    CHIP8_COUNTER_FRAMES,
+    CHIP8_COUNTER_SPRITES,
+    CHIP8_COUNTER_PRESENTS,
+    CHIP8_COUNTER_COUNT
+} chip8_counter;
+
+/*
+ * chip8_histogram enum
+ * Expects: N/A
+ * Does: Durations the metrics keep a histogram of, all in ns: running a frame's instructions, drawing and
+ * presenting a frame, how late the frame sleep woke up past its deadline and how long a key press took to reach
+ * the core
+ */
+typedef enum chip8_histogram {
+    CHIP8_HISTOGRAM_EXECUTE,
+    CHIP8_HISTOGRAM_PRESENT,
+    CHIP8_HISTOGRAM_SLEEP_OVERSHOOT,
+    CHIP8_HISTOGRAM_INPUT_LATENCY,
+    CHIP8_HISTOGRAM_COUNT
+} chip8_histogram;
+
+/*
+ * chip8_metrics struct
+ * Expects: N/A
+ * Does: Counters and histograms any thread can add to without locking (relaxed atomic adds, nothing orders
+ * them against each other) and any thread can snapshot at any time
+ */
+typedef struct chip8_metrics {
+
+    atomic_uint_fast64_t counters[CHIP8_COUNTER_COUNT];
+    atomic_uint_fast64_t buckets[CHIP8_HISTOGRAM_COUNT][CHIP8_METRICS_BUCKETS];
+    atomic_uint_fast64_t sums[CHIP8_HISTOGRAM_COUNT];
+
+    // When the metrics started, rates are worked out against it
+    uint64_t start_ns;
+
+    // Dump thread (see chip8_metrics_start_dump), NULL when there isn't one
+    struct chip8_metrics_dump *dump;
+
+} chip8_metrics;
+
+/*
+ * chip8_metrics_snapshot struct
+ * Expects: N/A
+ * Does: Everything counted up to when the snapshot was taken, two of them give the rates and percentiles for the
+ * time between them
+ */
+typedef struct chip8_metrics_snapshot {
+    uint64_t taken_ns;
+    uint64_t counters[CHIP8_COUNTER_COUNT];
+    uint64_t buckets[CHIP8_HISTOGRAM_COUNT][CHIP8_METRICS_BUCKETS];
+    uint64_t sums[CHIP8_HISTOGRAM_COUNT];
+} chip8_metrics_snapshot;
+
+/*
+ * chip8_histogram_summary struct
+ * Expects: N/A
+ * Does: A histogram over an interval, percentiles and max are the top of the bucket they fell in
+ */
+typedef struct chip8_histogram_summary {
+    uint64_t count;
+    uint64_t mean_ns;
+    uint64_t p50_ns;
+    uint64_t p90_ns;
+    uint64_t p99_ns;
+    uint64_t max_ns;
+} chip8_histogram_summary;
+
+/*
+ * chip8_metrics_summary struct
+ * Expects: N/A
+ * Does: What happened between two snapshots, plus the totals up to the later one
+ */
+typedef struct chip8_metrics_summary {
+    double seconds;
+    double uptime_seconds;
+    uint64_t totals[CHIP8_COUNTER_COUNT];
+    double per_second[CHIP8_COUNTER_COUNT];
+    chip8_histogram_summary histograms[CHIP8_HISTOGRAM_COUNT];
+} chip8_metrics_summary;
+
+/*
+ * chip8_metrics_create function
+ * Expects: NA
+ * Does: Allocates metrics with everything at zero, returns NULL if out of memory
+ *
+ */
+chip8_metrics *chip8_metrics_create(void);
+
+/*
+ * chip8_metrics_destroy function
+ * Expects: metrics to have come from chip8_metrics_create (or be NULL) and nothing else to be using them
+ * Does: Stops the dump thread if there is one and frees the metrics
+ *
+ */
+void chip8_metrics_destroy(chip8_metrics *metrics);
+
+/*
+ * chip8_metrics_add function
+ * Expects: NA
+ * Does: Adds amount to counter, safe from any thread
+ *
+ */
+static inline void chip8_metrics_add(chip8_metrics *metrics, chip8_counter counter, uint64_t amount){
+    atomic_fetch_add_explicit(&metrics->counters[counter], amount, memory_order_relaxed);
+}
+
+/*
+ * chip8_metrics_record function
+ * Expects: NA
+ * Does: Adds one duration of value_ns to histogram, safe from any thread
+ *
+ */
+void chip8_metrics_record(chip8_metrics *metrics, chip8_histogram histogram, uint64_t value_ns);
+
+/*
+ * chip8_metrics_take_snapshot function
+ * Expects: NA
+ * Does: Copies every counter and histogram into snapshot (each value on its own, so a snapshot taken while others
+ * are adding can be off by whatever was added while it was copying)
+ *
+ */
+void chip8_metrics_take_snapshot(const chip8_metrics *metrics, chip8_metrics_snapshot *snapshot);
+
+/*
+ * chip8_metrics_summarize function
+ * Expects: before to have been taken earlier than now from the same metrics (or be NULL to summarize from start)
+ * Does: Fills summary with the rates and histogram percentiles between the two snapshots
+ *
+ */
+void chip8_metrics_summarize(const chip8_metrics *metrics, const chip8_metrics_snapshot *now,
+                             const chip8_metrics_snapshot *before, chip8_metrics_summary *summary);
+
+/*
+ * chip8_metrics_format_json function
+ * Expects: buffer to hold size bytes (CHIP8_METRICS_JSON_SIZE always fits)
+ * Does: Writes summary as a single line JSON object ending in a newline, returns its length
+ *
+ */
+size_t chip8_metrics_format_json(const chip8_metrics_summary *summary, char *buffer, size_t size);
+
+/*
+ * chip8_metrics_start_dump function
+ * Expects: destination to be a file path or unix:path for a UNIX stream socket, interval_ms to be above 0
+ * Does: Starts a thread that every interval_ms writes the summary of that interval as JSON, replacing the file
+ * (written next to it then renamed so readers never see half of one) or as one line per interval down the socket
+ * (reconnecting if the reader goes away). Returns 0 on success else 1 (after printing why)
+ *
+ */
+int chip8_metrics_start_dump(chip8_metrics *metrics, const char *destination, unsigned int interval_ms);
+
+/*
+ * chip8_metrics_stop_dump function
+ * Expects: NA
+ * Does: Writes one last dump and stops the dump thread, does nothing if there isn't one
+ *
+ */
+void chip8_metrics_stop_dump(chip8_metrics *metrics);
+
+#endif /* chip8_metrics_h */
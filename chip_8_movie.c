@@ -0,0 +1,389 @@
+#include "chip_8_movie.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chip_8_state.h"
+
+/*
+ * Layout of a C8MV movie, every multi byte value is big endian
+ *
+ *   0  "C8MV"          4  version          6  flags (bit 0 = finished)
+ *   8  quirks         10  rom size        12  rom checksum
+ *  16  rng seed       20  frame count     24  hash of the final state   28  cycles per timer tick
+ *  32  mode
+ *  34  frame runs, each [frames in the run (4)][keys held (2)][cycles per frame (4)]
+ *
+ * Input only changes every few dozen frames so a run of identical frames is stored once and a
+ * minute of play is usually well under a KB.
+ * Frame count and the final hash are filled in when recording finishes, a movie cut short by a crash still replays
+ * up to its last run but can't be verified.
+ */
+enum {
+    MOVIE_MAGIC = 0,
+    MOVIE_VERSION = 4,
+    MOVIE_FLAGS = 6,
+    MOVIE_QUIRKS = 8,
+    MOVIE_ROM_SIZE = 10,
+    MOVIE_ROM_CHECKSUM = 12,
+    MOVIE_RNG_SEED = 16,
+    MOVIE_FRAME_COUNT = 20,
+    MOVIE_FINAL_HASH = 24,
+    MOVIE_CYCLES_PER_TICK = 28,
+    MOVIE_MODE = 32,
+    MOVIE_HEADER_SIZE = 34,
+    MOVIE_RUN_SIZE = 10
+};
+
+// Set in the flags once the frame count and final hash have been written
+#define MOVIE_FINISHED 1
+
+static const u8 movie_magic[4] = { 'C', '8', 'M', 'V' };
+
+struct chip8_movie {
+
+    FILE *file;
+    u8 header[MOVIE_HEADER_SIZE];
+
+    // The run of identical frames being recorded or replayed
+    u16 keys;
+    uint32_t cycles;
+    uint32_t run_frames;
+
+    // Frames recorded or replayed so far
+    uint32_t frames;
+
+    // Recording: a run failed to write, the movie is missing frames so chip8_movie_finish fails it
+    bool write_failed;
+
+};
+
+/* Big endian helpers so a movie moves between hosts unchanged */
+
+static inline void put_u16(u8 *out, u16 value){
+    out[0] = value >> 8;
+    out[1] = value;
+}
+
+static inline void put_u32(u8 *out, uint32_t value){
+    put_u16(out, value >> 16);
+    put_u16(out + 2, value);
+}
+
+static inline u16 get_u16(const u8 *in){
+    return (in[0] << 8) | in[1];
+}
+
+static inline uint32_t get_u32(const u8 *in){
+    return ((uint32_t)get_u16(in) << 16) | get_u16(in + 2);
+}
+
+/*
+ * fnv1a function
+ * Expects: data to hold length bytes
+ * Does: Returns the 32 bit FNV-1a hash of data
+ *
+ */
+static uint32_t fnv1a(const u8 *data, size_t length){
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++){
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/*
+ * state_hash function
+ * Expects: chip_8_object to be initialized
+ * Does: Sets *hash to the hash of the chip 8's save state (two chip 8s hash the same only if they'd save the same
+ * state), returns 0 on success else 1 if out of memory
+ *
+ */
+static int state_hash(const chip_8 *chip_8_object, uint32_t *hash){
+
+    // Saved into a buffer of its own so any number of movies can record or replay at once
+    size_t state_size = chip8_state_size(chip_8_object);
+    u8 *state = malloc(state_size);
+    if (!state){
+        return 1;
+    }
+    size_t size = chip8_save_state(chip_8_object, state, state_size);
+    *hash = fnv1a(state, size);
+    free(state);
+    return 0;
+
+}
+
+/*
+ * current_quirks function
+ * Expects: NA
+ * Does: Packs the six quirk globals into one bit each
+ *
+ */
+static u16 current_quirks(void){
+    return (vf_reset_quirk << 0) | (memory_quirk << 1) | (display_wait_quirk << 2) |
+           (clipping_quirk << 3) | (shifting_quirk << 4) | (jumping_quirk << 5);
+}
+
+/*
+ * write_run function
+ * Expects: movie to be recording
+ * Does: Appends the run of identical frames built up so far (if any), returns 0 on success else 1
+ *
+ */
+static int write_run(chip8_movie *movie){
+    if (movie->run_frames == 0){
+        return 0;
+    }
+    u8 run[MOVIE_RUN_SIZE];
+    put_u32(&run[0], movie->run_frames);
+    put_u16(&run[4], movie->keys);
+    put_u32(&run[6], movie->cycles);
+    movie->run_frames = 0;
+    return fwrite(run, 1, sizeof(run), movie->file) == sizeof(run) ? 0 : 1;
+}
+
+/*
+ * chip8_movie_record function
+ * Expects: chip_8_object to have its rom loaded, rng seed and cycles per tick set but not to have run yet
+ * Does: Creates a movie at path holding the rng seed, quirks, cycles per timer tick and a checksum of the rom,
+ * returns NULL (after printing why) on failure
+ *
+ */
+chip8_movie *chip8_movie_record(const char *path, const chip_8 *chip_8_object){
+
+    chip8_movie *movie = calloc(1, sizeof(chip8_movie));
+    if (!movie){
+        return NULL;
+    }
+    movie->file = fopen(path, "wb");
+    if (!movie->file){
+        printf("Error: Can't write movie %s\n", path);
+        free(movie);
+        return NULL;
+    }
+
+    const u8 *rom = &chip_8_object->memory[rom_start_address];
+    u16 rom_size = chip_8_object->rom_end - rom_start_address;
+
+    memcpy(&movie->header[MOVIE_MAGIC], movie_magic, sizeof(movie_magic));
+    put_u16(&movie->header[MOVIE_VERSION], CHIP8_MOVIE_VERSION);
+    put_u16(&movie->header[MOVIE_QUIRKS], current_quirks());
+    put_u16(&movie->header[MOVIE_ROM_SIZE], rom_size);
+    put_u32(&movie->header[MOVIE_ROM_CHECKSUM], fnv1a(rom, rom_size));
+    put_u32(&movie->header[MOVIE_RNG_SEED], chip_8_object->rng_seed);
+    put_u32(&movie->header[MOVIE_CYCLES_PER_TICK], chip_8_object->cycles_per_tick);
+    put_u16(&movie->header[MOVIE_MODE], chip_8_object->mode);
+
+    if (fwrite(movie->header, 1, sizeof(movie->header), movie->file) != sizeof(movie->header)){
+        printf("Error: Can't write movie %s\n", path);
+        fclose(movie->file);
+        free(movie);
+        return NULL;
+    }
+
+    return movie;
+
+}
+
+/*
+ * chip8_movie_record_frame function
+ * Expects: movie to be recording and to be called once per frame after the frame ran
+ * Does: Appends the keys held and the cycle budget of one frame, identical frames in a row are stored once
+ *
+ */
+void chip8_movie_record_frame(chip8_movie *movie, u16 keys, uint32_t cycles){
+    if (movie->run_frames > 0 && (keys != movie->keys || cycles != movie->cycles)){
+        movie->write_failed |= write_run(movie) != 0;
+    }
+    movie->keys = keys;
+    movie->cycles = cycles;
+    movie->run_frames++;
+    movie->frames++;
+}
+
+/*
+ * chip8_movie_finish function
+ * Expects: movie to be recording
+ * Does: Writes out the last frames along with a hash of the state chip_8_object finished in then closes and
+ * frees the movie, returns 0 on success else 1 (any frame that failed to write along the way fails it)
+ *
+ */
+int chip8_movie_finish(chip8_movie *movie, const chip_8 *chip_8_object){
+
+    // A run lost along the way (or anything stdio buffered and failed to write) fails the whole movie, it
+    // wouldn't replay to the state hashed here
+    int status = write_run(movie) | movie->write_failed | (ferror(movie->file) != 0);
+
+    uint32_t hash = 0;
+    status |= state_hash(chip_8_object, &hash);
+    put_u16(&movie->header[MOVIE_FLAGS], MOVIE_FINISHED);
+    put_u32(&movie->header[MOVIE_FRAME_COUNT], movie->frames);
+    put_u32(&movie->header[MOVIE_FINAL_HASH], hash);
+
+    // The header went out first with the frame count and hash blank
+    if (status == 0 && fseek(movie->file, 0, SEEK_SET) == 0){
+        status = fwrite(movie->header, 1, sizeof(movie->header), movie->file) == sizeof(movie->header) ? 0 : 1;
+    }
+    status |= fclose(movie->file) != 0;
+    if (status){
+        printf("Error: Can't finish writing movie\n");
+    }
+
+    free(movie);
+    return status ? 1 : 0;
+
+}
+
+/*
+ * chip8_movie_open function
+ * Expects: path to be a movie written by chip8_movie_record
+ * Does: Opens the movie for replay, returns NULL (after printing why) if it can't be read
+ *
+ */
+chip8_movie *chip8_movie_open(const char *path){
+
+    chip8_movie *movie = calloc(1, sizeof(chip8_movie));
+    if (!movie){
+        return NULL;
+    }
+    movie->file = fopen(path, "rb");
+    if (!movie->file){
+        printf("Error: Can't open movie %s\n", path);
+        free(movie);
+        return NULL;
+    }
+
+    if (fread(movie->header, 1, sizeof(movie->header), movie->file) != sizeof(movie->header) ||
+        memcmp(&movie->header[MOVIE_MAGIC], movie_magic, sizeof(movie_magic)) != 0){
+        printf("Error: %s is not a chip 8 movie\n", path);
+        chip8_movie_close(movie);
+        return NULL;
+    }
+    if (get_u16(&movie->header[MOVIE_VERSION]) != CHIP8_MOVIE_VERSION){
+        printf("Error: Movie version %d isn't supported (expected %d)\n",
+               get_u16(&movie->header[MOVIE_VERSION]), CHIP8_MOVIE_VERSION);
+        chip8_movie_close(movie);
+        return NULL;
+    }
+
+    return movie;
+
+}
+
+/*
+ * chip8_movie_start_replay function
+ * Expects: chip_8_object to be initialized with chip8_init (jit attached if wanted) and rom to be the recorded rom
+ * Does: Sets the quirks, rng seed and cycles per tick the movie was recorded with and loads the rom, returns 0 on
+ * success else 1 (after printing why) when the rom isn't the one recorded
+ *
+ */
+int chip8_movie_start_replay(chip8_movie *movie, chip_8 *chip_8_object, const u8 *rom, size_t size){
+
+    if (size != get_u16(&movie->header[MOVIE_ROM_SIZE]) ||
+        fnv1a(rom, size) != get_u32(&movie->header[MOVIE_ROM_CHECKSUM])){
+        printf("Error: The movie was recorded with a different rom\n");
+        return 1;
+    }
+
+    // Quirks first, loading the rom picks the profile from them
+    u16 quirks = get_u16(&movie->header[MOVIE_QUIRKS]);
+    vf_reset_quirk = quirks & (1 << 0);
+    memory_quirk = quirks & (1 << 1);
+    display_wait_quirk = quirks & (1 << 2);
+    clipping_quirk = quirks & (1 << 3);
+    shifting_quirk = quirks & (1 << 4);
+    jumping_quirk = quirks & (1 << 5);
+
+    u16 mode = get_u16(&movie->header[MOVIE_MODE]);
+    if (mode > CHIP8_MODE_XOCHIP){
+        printf("Error: The movie was recorded in an unknown mode\n");
+        return 1;
+    }
+    chip8_set_mode(chip_8_object, mode);
+
+    chip8_load_rom_bytes(chip_8_object, rom, size);
+    chip8_seed_rng(chip_8_object, get_u32(&movie->header[MOVIE_RNG_SEED]));
+    chip8_set_cycles_per_tick(chip_8_object, get_u32(&movie->header[MOVIE_CYCLES_PER_TICK]));
+
+    return 0;
+
+}
+
+/*
+ * chip8_movie_next_frame function
+ * Expects: movie to be opened with chip8_movie_open
+ * Does: Fills in the keys and cycle budget of the next frame, returns false once every frame has been read
+ *
+ */
+bool chip8_movie_next_frame(chip8_movie *movie, u16 *keys, uint32_t *cycles){
+
+    while (movie->run_frames == 0){
+        u8 run[MOVIE_RUN_SIZE];
+        if (fread(run, 1, sizeof(run), movie->file) != sizeof(run)){
+            return false;
+        }
+        movie->run_frames = get_u32(&run[0]);
+        movie->keys = get_u16(&run[4]);
+        movie->cycles = get_u32(&run[6]);
+    }
+
+    movie->run_frames--;
+    movie->frames++;
+    *keys = movie->keys;
+    *cycles = movie->cycles;
+    return true;
+
+}
+
+/*
+ * chip8_movie_verify function
+ * Expects: every frame of movie to have been replayed into chip_8_object
+ * Does: Returns 0 if chip_8_object finished in the state the recording did else 1 (after printing why)
+ *
+ */
+int chip8_movie_verify(const chip8_movie *movie, const chip_8 *chip_8_object){
+
+    if (!(get_u16(&movie->header[MOVIE_FLAGS]) & MOVIE_FINISHED)){
+        printf("The recording never finished so there is no final state to check against\n");
+        return 1;
+    }
+    if (movie->frames != get_u32(&movie->header[MOVIE_FRAME_COUNT])){
+        printf("Replayed %u of the %u recorded frames\n", movie->frames, get_u32(&movie->header[MOVIE_FRAME_COUNT]));
+        return 1;
+    }
+    uint32_t hash;
+    if (state_hash(chip_8_object, &hash)){
+        printf("Error: Out of memory for the final state\n");
+        return 1;
+    }
+    if (hash != get_u32(&movie->header[MOVIE_FINAL_HASH])){
+        printf("Replay diverged: the final state doesn't match the recording\n");
+        return 1;
+    }
+    return 0;
+
+}
+
+/*
+ * chip8_movie_frames function
+ * Expects: NA
+ * Does: Returns how many frames have been recorded or replayed so far
+ *
+ */
+uint32_t chip8_movie_frames(const chip8_movie *movie){
+    return movie->frames;
+}
+
+/*
+ * chip8_movie_close function
+ * Expects: movie to have come from chip8_movie_open (or be NULL)
+ * Does: Closes and frees the movie
+ *
+ */
+void chip8_movie_close(chip8_movie *movie){
+    if (!movie){
+        return;
+    }
+    fclose(movie->file);
+    free(movie);
+}
@@ -0,0 +1,87 @@
+#ifndef chip8_movie_h
+#define chip8_movie_h
+#include <stdbool.h>
+#include <stddef.h>
+#include "chip_8_core.h"
+
+// Current version of the movie format, bumped whenever the layout or what a replay depends on (like the rng) changes
+#define CHIP8_MOVIE_VERSION 5
+
+typedef struct chip8_movie chip8_movie;
+
+/*
+ * chip8_movie_record function
+ * Expects: chip_8_object to have its rom loaded, rng seed and cycles per tick set but not to have run yet
+ * Does: Creates a movie at path holding the mode, rng seed, quirks, cycles per timer tick and a checksum of the rom,
+ * returns NULL (after printing why) on failure
+ *
+ */
+chip8_movie *chip8_movie_record(const char *path, const chip_8 *chip_8_object);
+
+/*
+ * chip8_movie_record_frame function
+ * Expects: movie to be recording and to be called once per frame after the frame ran
+ * Does: Appends the keys held and the cycle budget of one frame, identical frames in a row are stored once
+ *
+ */
+void chip8_movie_record_frame(chip8_movie *movie, u16 keys, uint32_t cycles);
+
+/*
+ * chip8_movie_finish function
+ * Expects: movie to be recording
+ * Does: Writes out the last frames along with a hash of the state chip_8_object finished in then closes and
+ * frees the movie, returns 0 on success else 1 (any frame that failed to write along the way fails it)
+ *
+ */
+int chip8_movie_finish(chip8_movie *movie, const chip_8 *chip_8_object);
+
+/*
+ * chip8_movie_open function
+ * Expects: path to be a movie written by chip8_movie_record
+ * Does: Opens the movie for replay, returns NULL (after printing why) if it can't be read
+ *
+ */
+chip8_movie *chip8_movie_open(const char *path);
+
+/*
+ * chip8_movie_start_replay function
+ * Expects: chip_8_object to be initialized with chip8_init (jit attached if wanted) and rom to be the recorded rom
+ * Does: Sets the mode, quirks, rng seed and cycles per tick the movie was recorded with and loads the rom, returns 0
+ * on success else 1 (after printing why) when the rom isn't the one recorded
+ *
+ */
+int chip8_movie_start_replay(chip8_movie *movie, chip_8 *chip_8_object, const u8 *rom, size_t size);
+
+/*
+ * chip8_movie_next_frame function
+ * Expects: movie to be opened with chip8_movie_open
+ * Does: Fills in the keys and cycle budget of the next frame, returns false once every frame has been read
+ *
+ */
+bool chip8_movie_next_frame(chip8_movie *movie, u16 *keys, uint32_t *cycles);
+
+/*
+ * chip8_movie_verify function
+ * Expects: every frame of movie to have been replayed into chip_8_object
+ * Does: Returns 0 if chip_8_object finished in the state the recording did else 1 (after printing why)
+ *
+ */
+int chip8_movie_verify(const chip8_movie *movie, const chip_8 *chip_8_object);
+
+/*
+ * chip8_movie_frames function
+ * Expects: NA
+ * Does: Returns how many frames have been recorded or replayed so far
+ *
+ */
+uint32_t chip8_movie_frames(const chip8_movie *movie);
+
+/*
+ * chip8_movie_close function
+ * Expects: movie to have come from chip8_movie_open (or be NULL)
+ * Does: Closes and frees the movie
+ *
+ */
+void chip8_movie_close(chip8_movie *movie);
+
+#endif /* chip8_movie_h */
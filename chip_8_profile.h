@@ -0,0 +1,834 @@
+/*
+ * Opcode handlers and run loop for one quirk profile
+ *
+ * This isn't a normal header, chip_8_core.c includes it once per quirk profile after defining
+ *   PROFILE_NAME                        suffix for everything generated here (cosmac, schip, ...)
+ *   VF_RESET_QUIRK ... JUMPING_QUIRK    true/false for a fixed profile or the quirk globals for the generic one
+ *   PROFILE_DEBUG                       false to leave the debug prints out of this profile entirely
+ *   PROFILE_GENERIC                     (optional) the quirks aren't constants so don't emit a quirk_profile
+ * In a fixed profile every quirk and debug test is a constant the compiler folds away. All of them are undefined
+ * again at the bottom so the next profile starts clean.
+ */
+
+#define PROFILE_CONCAT_(a, b) a##_##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_STRING_(a) #a
+#define PROFILE_STRING(a) PROFILE_STRING_(a)
+#define OP(name) PROFILE_CONCAT(op_##name, PROFILE_NAME)
+
+/* Opcode handlers, the PC has already been moved past the instruction when these are called */
+
+// 0NNN machine code routines and opcodes we don't recognise are ignored
+static void OP(ignored)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    (void)chip_8_object;
+    (void)decoded;
+}
+
+// 00E0 Clear the display (just the selected planes in XO-CHIP)
+static void OP(clear_display)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    (void)decoded;
+    for (int plane = 0; plane < CHIP8_PLANES; plane++) {
+        if (!(chip_8_object->planes & (1 << plane))) {
+            continue;
+        }
+        // Only rows that had something lit in them actually change
+        for (int i = 0; i < CHIP8_HIRES_HEIGHT; i++) {
+            if (chip_8_object->display[plane][i][0] | chip_8_object->display[plane][i][1]) {
+                chip_8_object->dirty_rows |= (u64)1 << i;
+            }
+        }
+        memset(chip_8_object->display[plane], 0, sizeof(chip_8_object->display[plane]));
+    }
+    if (PROFILE_DEBUG) {
+        printf("Clear the display\n");
+    }
+}
+
+// 00EE Need to return from subroutine AKA pop stack and make it the PC
+static void OP(return)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    (void)decoded;
+    chip_8_object->PC = pop(&chip_8_object->emulated_stack);
+    if (PROFILE_DEBUG){
+        printf("Returing from subroutine to 0x%04X\n", chip_8_object->PC);
+    }
+}
+
+// 00CN Scroll the display down N pixels (SUPER-CHIP)
+static void OP(scroll_down)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    scroll_display_rows(chip_8_object, decoded->n);
+    if (PROFILE_DEBUG){
+        printf("Scroll down %d pixels\n", decoded->n);
+    }
+}
+
+// 00DN Scroll the display up N pixels (XO-CHIP)
+static void OP(scroll_up)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    scroll_display_rows(chip_8_object, -decoded->n);
+    if (PROFILE_DEBUG){
+        printf("Scroll up %d pixels\n", decoded->n);
+    }
+}
+
+// 00FB Scroll the display right 4 pixels (SUPER-CHIP)
+static void OP(scroll_right)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    (void)decoded;
+    scroll_display_columns(chip_8_object, 4);
+    if (PROFILE_DEBUG){
+        printf("Scroll right 4 pixels\n");
+    }
+}
+
+// 00FC Scroll the display left 4 pixels (SUPER-CHIP)
+static void OP(scroll_left)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    (void)decoded;
+    scroll_display_columns(chip_8_object, -4);
+    if (PROFILE_DEBUG){
+        printf("Scroll left 4 pixels\n");
+    }
+}
+
+// 00FD Exit the interpreter (SUPER-CHIP), the rom is treated as ending here so chip8_is_running goes false
+static void OP(exit)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    (void)decoded;
+    chip_8_object->rom_end = 0;
+    if (PROFILE_DEBUG){
+        printf("Exit\n");
+    }
+}
+
+// 00FE Switch to the 64x32 lores display (SUPER-CHIP)
+static void OP(lores)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    (void)decoded;
+    set_resolution(chip_8_object, false);
+    if (PROFILE_DEBUG){
+        printf("Switch to lores\n");
+    }
+}
+
+// 00FF Switch to the 128x64 hires display (SUPER-CHIP)
+static void OP(hires)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    (void)decoded;
+    set_resolution(chip_8_object, true);
+    if (PROFILE_DEBUG){
+        printf("Switch to hires\n");
+    }
+}
+
+// 1NNN Jump to address NNN
+static void OP(jump)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    chip_8_object->PC = decoded->nnn;
+    if (PROFILE_DEBUG){
+        printf("Jump to address 0x%04X\n", chip_8_object->PC);
+    }
+}
+
+// 2NNN this case we actually do a call of the subroutine
+static void OP(call)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    push(&chip_8_object->emulated_stack, chip_8_object->PC);
+    chip_8_object->PC = decoded->nnn;
+    if (PROFILE_DEBUG){
+        printf("Call address 0x%04X\n", chip_8_object->PC);
+    }
+}
+
+// 3XNN Skip 1 instruction if the value of Vx is equal to NN
+static void OP(skip_if_equal_immediate)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    if (chip_8_object->V[decoded->x] == decoded->nn){
+        chip_8_object->PC += 2;
+    }
+    if (PROFILE_DEBUG){
+        printf("Checked if 0x%02X is equal to 0x%02X\n", chip_8_object->V[decoded->x], decoded->nn);
+    }
+}
+
+// 4XNN Skip 1 instruction if the value Vx is not equal to NN
+static void OP(skip_if_not_equal_immediate)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    if (chip_8_object->V[decoded->x] != decoded->nn){
+        chip_8_object->PC += 2;
+    }
+    if (PROFILE_DEBUG){
+        printf("Checked if 0x%02X is not equal to 0x%02X\n", chip_8_object->V[decoded->x], decoded->nn);
+    }
+}
+
+// 5XY0 Skip 1 instruction if Vx and Vy are equal
+static void OP(skip_if_equal_register)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    if (chip_8_object->V[decoded->x] == chip_8_object->V[decoded->y]){
+        chip_8_object->PC += 2;
+    }
+    if (PROFILE_DEBUG){
+        printf("Checked if V[%d] = 0x%02X is equal to V[%d] = 0x%02X\n", decoded->x, chip_8_object->V[decoded->x], decoded->y, chip_8_object->V[decoded->y]);
+    }
+}
+
+// 5XY2 Store V[X] through V[Y] (either way round) in memory starting at I, I is left alone (XO-CHIP)
+static void OP(save_range)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    int step = decoded->x <= decoded->y ? 1 : -1;
+    int count = (decoded->x <= decoded->y ? decoded->y - decoded->x : decoded->x - decoded->y) + 1;
+    u32 mask = chip_8_object->memory_mask;
+    for (int i = 0; i < count; i++){
+        chip_8_object->memory[(chip_8_object->I + i) & mask] = chip_8_object->V[decoded->x + i * step];
+    }
+    invalidate_decoded_instructions(chip_8_object, chip_8_object->I, count);
+    if (PROFILE_DEBUG){
+        printf("Stored V[%d] through V[%d] at 0x%04X\n", decoded->x, decoded->y, chip_8_object->I);
+    }
+}
+
+// 5XY3 Load V[X] through V[Y] (either way round) from memory starting at I, I is left alone (XO-CHIP)
+static void OP(load_range)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    int step = decoded->x <= decoded->y ? 1 : -1;
+    int count = (decoded->x <= decoded->y ? decoded->y - decoded->x : decoded->x - decoded->y) + 1;
+    u32 mask = chip_8_object->memory_mask;
+    for (int i = 0; i < count; i++){
+        chip_8_object->V[decoded->x + i * step] = chip_8_object->memory[(chip_8_object->I + i) & mask];
+    }
+    if (PROFILE_DEBUG){
+        printf("Loaded V[%d] through V[%d] from 0x%04X\n", decoded->x, decoded->y, chip_8_object->I);
+    }
+}
+
+// 6XNN Set Vx to NN
+static void OP(set_immediate)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    chip_8_object->V[decoded->x] = decoded->nn;
+    if (PROFILE_DEBUG){
+        printf("Set V[%d] to 0x%02X\n", decoded->x, decoded->nn);
+    }
+}
+
+// 7XNN Add NN to Vx (without carry) and without changing the carry flag
+static void OP(add_immediate)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    chip_8_object->V[decoded->x] = chip_8_object->V[decoded->x] + decoded->nn;
+    if (PROFILE_DEBUG){
+        printf("Add 0x%02X to V[%d], result: 0x%02X\n", decoded->nn, decoded->x, chip_8_object->V[decoded->x]);
+    }
+}
+
+// 8XY0 Binary Set operation
+static void OP(set_register)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    chip_8_object->V[decoded->x] = chip_8_object->V[decoded->y];
+    if (PROFILE_DEBUG){
+        printf("Set V[%d] to equal V[%d]\n", decoded->x, decoded->y);
+    }
+}
+
+// 8XY1 Binary Or operation
+static void OP(or)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    chip_8_object->V[decoded->x] = chip_8_object->V[decoded->x] | chip_8_object->V[decoded->y];
+    if (PROFILE_DEBUG){
+        printf("Set V[%d] to the or operation of V[%d] | V[%d]\n", decoded->x, decoded->x, decoded->y);
+    }
+    if (VF_RESET_QUIRK){
+        chip_8_object->V[15] = 0;
+        if (PROFILE_DEBUG) {
+            printf("Reset flag register V[15]\n");
+        }
+    }
+}
+
+// 8XY2 Binary And operation
+static void OP(and)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    chip_8_object->V[decoded->x] = chip_8_object->V[decoded->x] & chip_8_object->V[decoded->y];
+    if (PROFILE_DEBUG){
+        printf("Set V[%d] to the and operation of V[%d] & V[%d]\n", decoded->x, decoded->x, decoded->y);
+    }
+    if (VF_RESET_QUIRK){
+        chip_8_object->V[15] = 0;
+        if (PROFILE_DEBUG) {
+            printf("Reset flag register V[15]\n");
+        }
+    }
+}
+
+// 8XY3 Binary XOR operation
+static void OP(xor)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    chip_8_object->V[decoded->x] = chip_8_object->V[decoded->x] ^ chip_8_object->V[decoded->y];
+    if (PROFILE_DEBUG){
+        printf("Set V[%d] to the XOR operation of V[%d] ^ V[%d]\n", decoded->x, decoded->x, decoded->y);
+    }
+    if (VF_RESET_QUIRK){
+        chip_8_object->V[15] = 0;
+        if (PROFILE_DEBUG) {
+            printf("Reset flag register V[15]\n");
+        }
+    }
+}
+
+// 8XY4 Binary addition of registers V[x] and V[y] with overflow setting VF to 1 ELSE its set to 0
+static void OP(add_register)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    if ((chip_8_object->V[decoded->x] + chip_8_object->V[decoded->y]) > 255){
+        chip_8_object->V[decoded->x] = (chip_8_object->V[decoded->x] + chip_8_object->V[decoded->y]);
+        chip_8_object->V[15] = 1;
+    }
+    else {
+        chip_8_object->V[decoded->x] = (chip_8_object->V[decoded->x] + chip_8_object->V[decoded->y]);
+        chip_8_object->V[15] = 0;
+    }
+    if (PROFILE_DEBUG){
+        printf("Added V[%d] with V[%d] placed in V[%d] did overflow: %s\n", decoded->x, decoded->y, decoded->x, (chip_8_object->V[15] == 1) ? "True" : "False");
+    }
+}
+
+// 8XY5 - VX = VX - VY, VF = NOT borrow
+static void OP(subtract_register)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    u8 temporary_u8 = (chip_8_object->V[decoded->x] >= chip_8_object->V[decoded->y]) ? 1 : 0;
+    chip_8_object->V[decoded->x] -= chip_8_object->V[decoded->y];
+    chip_8_object->V[15] = temporary_u8;
+    if (PROFILE_DEBUG){
+        printf("Substracted V[%d] from V[%d] placed in V[%d] carry flag: %s\n", decoded->y, decoded->x, decoded->x, (chip_8_object->V[15] == 1) ? "1" : "0");
+    }
+}
+
+// 8XY6 Shift V[X] by 1 bit (right) if the bit shifted out was 1 set V[F] to 1 else set it to 0
+static void OP(shift_right)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    u8 temporary_u8 = (chip_8_object->V[decoded->x] & 0b00000001) ? 1 : 0;
+    if (SHIFTING_QUIRK) {
+        chip_8_object->V[decoded->x] = chip_8_object->V[decoded->x] >> 1;
+        chip_8_object->V[15] = temporary_u8;
+    }
+    else {
+        chip_8_object->V[decoded->x] = chip_8_object->V[decoded->y] >> 1;
+        chip_8_object->V[15] = chip_8_object->V[decoded->y] & 0b00000001;
+    }
+
+    if (PROFILE_DEBUG){
+        printf("Shifted V[%d] by 1 bit to the right, shifted out %d into V[F]\n", decoded->x, chip_8_object->V[15]);
+    }
+}
+
+// 8XY7 - VX = VY - VX, VF = NOT borrow
+static void OP(subtract_reversed)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    u8 temporary_u8 = (chip_8_object->V[decoded->y] >= chip_8_object->V[decoded->x]) ? 1 : 0;
+    chip_8_object->V[decoded->x] = chip_8_object->V[decoded->y] - chip_8_object->V[decoded->x];
+    chip_8_object->V[15] = temporary_u8;
+    if (PROFILE_DEBUG){
+        printf("Substracted V[%d] from V[%d] placed in V[%d] carry flag: %s\n", decoded->x, decoded->y, decoded->x, (chip_8_object->V[15] == 1) ? "1" : "0");
+    }
+}
+
+// 8XYE Shift V[X] by 1 bit (left) if the bit shifted out was 1 set V[F] to 1 else set it to 0
+static void OP(shift_left)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    u8 temporary_u8 = (chip_8_object->V[decoded->x] & 0b10000000) ? 1 : 0;
+    if (SHIFTING_QUIRK) {
+        chip_8_object->V[decoded->x] = chip_8_object->V[decoded->x] << 1;
+        chip_8_object->V[15] = temporary_u8;
+    }
+    else {
+        chip_8_object->V[decoded->x] = chip_8_object->V[decoded->y] << 1;
+        chip_8_object->V[15] = (chip_8_object->V[decoded->y] & 0b10000000) >> 7;
+    }
+
+    if (PROFILE_DEBUG){
+        printf("Shifted V[%d] by 1 bit to the left, shifted out %d into V[F]\n", decoded->x, chip_8_object->V[15]);
+    }
+}
+
+// 9XY0 Skip 1 instruction if Vx and Vy are not equal
+static void OP(skip_if_not_equal_register)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    if (chip_8_object->V[decoded->x] != chip_8_object->V[decoded->y]){
+        chip_8_object->PC += 2;
+    }
+    if (PROFILE_DEBUG){
+        printf("If V[%d] = 0x%02X is not equal to V[%d] = 0x%02X skip an instruction\n", decoded->x, chip_8_object->V[decoded->x], decoded->y, chip_8_object->V[decoded->y]);
+    }
+}
+
+// ANNN Set the index register to NNN
+static void OP(set_index)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    chip_8_object->I = decoded->nnn;
+    if (PROFILE_DEBUG){
+        printf("Set I to 0x%03X\n", chip_8_object->I);
+    }
+}
+
+// BNNN Jump with an offset (original implementation)
+static void OP(jump_offset)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    if (JUMPING_QUIRK) {
+        chip_8_object->PC = decoded->nnn + chip_8_object->V[decoded->x];
+    }
+    else {
+        chip_8_object->PC = decoded->nnn + chip_8_object->V[0];
+    }
+    if (PROFILE_DEBUG){
+        printf("Jump to %d\n", chip_8_object->PC);
+    }
+}
+
+// CXNN Get a random value (0 - 255 inclusive) then binary and it with the two last nibbles of the instruction
+static void OP(random)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    // Top byte of the output, the debug print shows the same draw rather than taking another
+    u8 random = next_random(chip_8_object) >> 24;
+    chip_8_object->V[decoded->x] = random & decoded->nn;
+    if (PROFILE_DEBUG){
+        printf("Got a random int: %d\n", chip_8_object->V[decoded->x]);
+    }
+}
+
+// DXYN Case of us writting a sprite to the screen
+// Each sprite row is lined up with its column in a single word then XORed into the display row at once
+static void OP(draw)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    if (chip_8_object->display_wait_timer == 0){
+
+        // set the X coordinate to the value in VX (V register N number) modulo 64
+        u8 x_coordinate = chip_8_object->V[decoded->x] & 63;
+        u8 y_coordinate = chip_8_object->V[decoded->y] & 31;
+        u8 collision = 0;
+        int pixels = 0;
+
+        for (int i = 0; i < decoded->n; i++) {
+            // if we're not supposed to wrap stop at the bottom edge
+            if (CLIPPING_QUIRK && (y_coordinate + i) >= chip_8_screen_height) {
+                break;
+            }
+
+            // Leftmost sprite pixel in the top bit then moved over to column x, anything past the
+            // right edge is either dropped (clipping) or rotated back around to the left (wrapping)
+            u64 sprite_row = (u64)chip_8_object->memory[(chip_8_object->I + i) & chip_8_object->memory_mask] << 56;
+            if (CLIPPING_QUIRK) {
+                sprite_row >>= x_coordinate;
+            }
+            else {
+                sprite_row = rotate_right(sprite_row, x_coordinate);
+            }
+
+            int row = (y_coordinate + i) % chip_8_screen_height;
+            u64 *display_row = &chip_8_object->display[0][row][0];
+            if (CHIP8_PROFILER) {
+                pixels += __builtin_popcountll(sprite_row);
+            }
+            collision |= (*display_row & sprite_row) != 0;
+            *display_row ^= sprite_row;
+            // XORing in a blank sprite row leaves the display row as it was
+            if (sprite_row) {
+                chip_8_object->dirty_rows |= (u64)1 << row;
+            }
+        }
+        chip_8_object->V[15] = collision;
+        chip_8_object->sprites_drawn++;
+        if (CHIP8_PROFILER && chip_8_object->profiler) {
+            count_draw(chip_8_object->profiler, pixels, collision);
+        }
+
+        if (DISPLAY_WAIT_QUIRK) {
+            chip_8_object->display_wait_timer += 1;
+        }
+
+        if (PROFILE_DEBUG){
+            printf("Wrote %d tall sprite at X = %d and Y = %d\n", decoded->n, decoded->x, decoded->y);
+        }
+    }
+    else {
+        chip_8_object->PC -= 2;
+        if (CHIP8_PROFILER && chip_8_object->profiler) {
+            chip_8_object->profiler->draw_waits++;
+        }
+    }
+}
+
+// DXYN in SUPER-CHIP and XO-CHIP at either resolution, DXY0 draws a 16x16 sprite (two bytes a row) and XO-CHIP
+// draws into every selected plane with each plane's rows following the last one's in memory
+// Each sprite row is lined up with its column as the two words of a display row and XORed in at once
+static void OP(extended_draw)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    if (chip_8_object->display_wait_timer != 0){
+        chip_8_object->PC -= 2;
+        if (CHIP8_PROFILER && chip_8_object->profiler){
+            chip_8_object->profiler->draw_waits++;
+        }
+        return;
+    }
+
+    const u8 *memory = chip_8_object->memory;
+    u32 mask = chip_8_object->memory_mask;
+    int width = chip8_display_width(chip_8_object);
+    int height = chip8_display_height(chip_8_object);
+    int x_coordinate = chip_8_object->V[decoded->x] & (width - 1);
+    int y_coordinate = chip_8_object->V[decoded->y] & (height - 1);
+    bool wide = decoded->n == 0;
+    int rows = wide ? 16 : decoded->n;
+    u32 address = chip_8_object->I;
+    u8 collision = 0;
+    int pixels = 0;
+
+    for (int plane = 0; plane < CHIP8_PLANES; plane++){
+        if (!(chip_8_object->planes & (1 << plane))){
+            continue;
+        }
+        for (int i = 0; i < rows; i++){
+            u16 bits = memory[address & mask] << 8;
+            if (wide){
+                bits |= memory[(address + 1) & mask];
+            }
+            address += wide ? 2 : 1;
+
+            // if we're not supposed to wrap skip the rows past the bottom edge (their bytes still belong to this plane)
+            if (CLIPPING_QUIRK && (y_coordinate + i) >= height){
+                continue;
+            }
+
+            int row = (y_coordinate + i) & (height - 1);
+            u64 left;
+            u64 right;
+            place_sprite_row(bits, x_coordinate, width, CLIPPING_QUIRK, &left, &right);
+
+            u64 *display_row = chip_8_object->display[plane][row];
+            if (CHIP8_PROFILER){
+                pixels += __builtin_popcountll(left) + __builtin_popcountll(right);
+            }
+            collision |= ((display_row[0] & left) | (display_row[1] & right)) != 0;
+            display_row[0] ^= left;
+            display_row[1] ^= right;
+            if (left | right){
+                chip_8_object->dirty_rows |= (u64)1 << row;
+            }
+        }
+    }
+    chip_8_object->V[15] = collision;
+    chip_8_object->sprites_drawn++;
+    if (CHIP8_PROFILER && chip_8_object->profiler){
+        count_draw(chip_8_object->profiler, pixels, collision);
+    }
+
+    if (DISPLAY_WAIT_QUIRK){
+        chip_8_object->display_wait_timer += 1;
+    }
+
+    if (PROFILE_DEBUG){
+        printf("Wrote %dx%d sprite at X = %d and Y = %d to planes %d\n", wide ? 16 : 8, rows, x_coordinate, y_coordinate, chip_8_object->planes);
+    }
+}
+
+// EX9E Skip if key in Vx is pressed
+static void OP(skip_if_key)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    u8 temporary_u8 = chip_8_object->V[decoded->x];
+
+    if (chip8_key_down(chip_8_object, temporary_u8)) {
+        chip_8_object->PC += 2;
+    }
+
+    if (PROFILE_DEBUG){
+        printf("Skip if key 0x%01X is down (keys down 0x%04X)\n", temporary_u8 & 0xF, chip_8_object->keys_down);
+    }
+}
+
+// EXA1 Skip if key in Vx is NOT pressed
+static void OP(skip_if_not_key)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    u8 temporary_u8 = chip_8_object->V[decoded->x];
+
+    if (!chip8_key_down(chip_8_object, temporary_u8)) {
+        chip_8_object->PC += 2;
+    }
+
+    if (PROFILE_DEBUG){
+        printf("Skip if key 0x%01X is up (keys down 0x%04X)\n", temporary_u8 & 0xF, chip_8_object->keys_down);
+    }
+}
+
+// A skip followed by F000 NNNN, skips all 4 bytes of it (XO-CHIP)
+static void OP(long_skip)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    u16 next = chip_8_object->PC;
+    switch (decoded->skipped_opcode){
+        case OPCODE_SKIP_IF_EQUAL_IMMEDIATE: OP(skip_if_equal_immediate)(chip_8_object, decoded); break;
+        case OPCODE_SKIP_IF_NOT_EQUAL_IMMEDIATE: OP(skip_if_not_equal_immediate)(chip_8_object, decoded); break;
+        case OPCODE_SKIP_IF_EQUAL_REGISTER: OP(skip_if_equal_register)(chip_8_object, decoded); break;
+        case OPCODE_SKIP_IF_NOT_EQUAL_REGISTER: OP(skip_if_not_equal_register)(chip_8_object, decoded); break;
+        case OPCODE_SKIP_IF_KEY: OP(skip_if_key)(chip_8_object, decoded); break;
+        case OPCODE_SKIP_IF_NOT_KEY: OP(skip_if_not_key)(chip_8_object, decoded); break;
+    }
+    if (chip_8_object->PC != next){
+        chip_8_object->PC += 2;
+    }
+}
+
+// F000 NNNN Set the index register to the 16 bit address in the next two bytes (XO-CHIP)
+static void OP(long_index)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    (void)decoded;
+    u32 mask = chip_8_object->memory_mask;
+    chip_8_object->I = (chip_8_object->memory[chip_8_object->PC & mask] << 8) | chip_8_object->memory[(chip_8_object->PC + 1) & mask];
+    chip_8_object->PC += 2;
+    if (PROFILE_DEBUG){
+        printf("Set I to 0x%04X\n", chip_8_object->I);
+    }
+}
+
+// FN01 Select which bit planes drawing, clearing and scrolling act on (XO-CHIP)
+static void OP(select_planes)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    chip_8_object->planes = decoded->x & 3;
+    if (PROFILE_DEBUG){
+        printf("Selected planes %d\n", chip_8_object->planes);
+    }
+}
+
+// F002 Load the 16 byte audio pattern from memory at I (XO-CHIP)
+static void OP(audio_pattern)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    (void)decoded;
+    for (int i = 0; i < 16; i++){
+        chip_8_object->audio_pattern[i] = chip_8_object->memory[(chip_8_object->I + i) & chip_8_object->memory_mask];
+    }
+    if (PROFILE_DEBUG){
+        printf("Loaded the audio pattern from 0x%04X\n", chip_8_object->I);
+    }
+}
+
+// FX07 Set V[X] to the current value of our delay_register (timer)
+static void OP(read_delay)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    chip_8_object->V[decoded->x] = chip_8_object->delay_register;
+    if (PROFILE_DEBUG){
+        printf("Set %d to the delay_registers value of %d\n", decoded->x, chip_8_object->delay_register);
+    }
+}
+
+// FX0A Get a key blocking until a key is recieved
+// Only a key that goes down after the wait starts counts, a key already held when we got here has to be pressed again
+static void OP(wait_for_key)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    u8 temporary_u8 = 0xFF;
+    if (chip_8_object->waiting_for_key){
+        temporary_u8 = chip8_next_key_press(chip_8_object);
+    }
+    else {
+        chip_8_object->waiting_for_key = true;
+        chip_8_object->key_press_count = 0;
+    }
+
+    if (temporary_u8 != 0xFF){
+        chip_8_object->V[decoded->x] = temporary_u8;
+        chip_8_object->waiting_for_key = false;
+        chip_8_object->key_press_count = 0;
+        if (PROFILE_DEBUG){
+            printf("Got input: 0x%01X\n", temporary_u8);
+        }
+    }
+    else{
+        chip_8_object->PC -= 2;
+        if (PROFILE_DEBUG){
+            printf("Waiting for input\n");
+        }
+    }
+}
+
+// FX15 Set the delay_register (timer) to V[X]
+static void OP(set_delay)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    chip_8_object->delay_register = chip_8_object->V[decoded->x];
+    if (PROFILE_DEBUG){
+        printf("Set delay register to V[%d] = %d\n", decoded->x, chip_8_object->V[decoded->x]);
+    }
+}
+
+// FX18 Set the sound_register (timer for sound) to V[X]
+static void OP(set_sound)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    chip_8_object->sound_register = chip_8_object->V[decoded->x];
+    if (PROFILE_DEBUG){
+        printf("Set sound register to V[%d] = %d\n", decoded->x, chip_8_object->V[decoded->x]);
+    }
+}
+
+// FX1E Add V[X] to our index register (ambiguous behavior)
+static void OP(add_index)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    chip_8_object->I += chip_8_object->V[decoded->x];
+    if (PROFILE_DEBUG){
+        printf("Add V[%d] to index register\n", decoded->x);
+    }
+}
+
+// FX29 Set our index register to the requested font V[X]
+static void OP(font)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    chip_8_object->I = FONT_START + (chip_8_object->V[decoded->x] * 5);
+    if (PROFILE_DEBUG){
+        printf("Setting index register to font: 0x%01X\n", chip_8_object->V[decoded->x]);
+    }
+}
+
+// FX30 Set our index register to the requested big font V[X] (SUPER-CHIP)
+static void OP(big_font)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    chip_8_object->I = BIG_FONT_START + ((chip_8_object->V[decoded->x] & 0xF) * 10);
+    if (PROFILE_DEBUG){
+        printf("Setting index register to big font: 0x%01X\n", chip_8_object->V[decoded->x] & 0xF);
+    }
+}
+
+// FX3A Set the audio pattern's pitch to V[X] (XO-CHIP)
+static void OP(pitch)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    chip_8_object->pitch = chip_8_object->V[decoded->x];
+    if (PROFILE_DEBUG){
+        printf("Set pitch to V[%d] = %d\n", decoded->x, chip_8_object->pitch);
+    }
+}
+
+// FX33 Binary-Coded decimal conversion i = (V[X] / 100), i + 1 = (V[X] % 100) / 10, i + 2 = (V[X] % 10)
+// AKA we take each digit of of V[X] and place them individually in I incrementing for each digit
+static void OP(bcd)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    u8 temporary_u8 = chip_8_object->V[decoded->x];
+    u32 mask = chip_8_object->memory_mask;
+    chip_8_object->memory[chip_8_object->I & mask] = temporary_u8 / 100;
+    chip_8_object->memory[(chip_8_object->I + 1) & mask] = (temporary_u8 % 100) / 10;
+    chip_8_object->memory[(chip_8_object->I + 2) & mask] = (temporary_u8 % 10);
+    invalidate_decoded_instructions(chip_8_object, chip_8_object->I, 3);
+
+    if (PROFILE_DEBUG){
+        printf("BCD - Start\n");
+        printf("Memory address[%d] = (V[%d] / 100) = %d\n", chip_8_object->I, decoded->x, chip_8_object->memory[chip_8_object->I & mask]);
+        printf("Memory address[%d] = (V[%d] %% 100) / 10 = %d\n", chip_8_object->I + 1, decoded->x, chip_8_object->memory[(chip_8_object->I + 1) & mask]);
+        printf("Memmory address[%d] = (V[%d] %% 10) = %d\n", chip_8_object->I + 2, decoded->x, chip_8_object->memory[(chip_8_object->I + 2) & mask]);
+        printf("BCD - End\n");
+    }
+}
+
+// FX55 We change our emulated memory to the registers from 0 to X
+// AKA overwrite our emulated memory starting at i with V[0] till i + x = V[X]
+static void OP(store_registers)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    u8 temporary_u8 = decoded->x;
+    // Stores through memory could alias the mask as far as the compiler knows so it's read once up front
+    u32 mask = chip_8_object->memory_mask;
+    for( u8 i = 0; i <= temporary_u8; i++){
+        chip_8_object->memory[(chip_8_object->I + i) & mask] = chip_8_object->V[i];
+        if (PROFILE_DEBUG) {
+            printf("Overwriting memory address[%d] with %d\n", chip_8_object->I + i,  chip_8_object->V[i]);
+        }
+    }
+    invalidate_decoded_instructions(chip_8_object, chip_8_object->I, temporary_u8 + 1);
+    if (MEMORY_QUIRK){
+        chip_8_object->I += 1;
+    }
+}
+
+// FX65 We change our emulated registers to the memory from 0 to X
+// AKA Overwrite our registers starting at V[0] with memory[i] till V[X] = memory[i] + x
+static void OP(load_registers)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    u8 temporary_u8 = decoded->x;
+    u32 mask = chip_8_object->memory_mask;
+    for( u8 i = 0; i <= temporary_u8; i++){
+        chip_8_object->V[i] = chip_8_object->memory[(chip_8_object->I + i) & mask];
+        if (PROFILE_DEBUG) {
+            printf("Overwriting V[%x] with memory address[%d]\n", i, chip_8_object->I);
+        }
+    }
+    if (MEMORY_QUIRK){
+        chip_8_object->I += 1;
+    }
+}
+
+// FX75 Save V[0] through V[X] to the RPL user flags (SUPER-CHIP)
+static void OP(save_flags)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    memcpy(chip_8_object->rpl_flags, chip_8_object->V, decoded->x + 1);
+    if (PROFILE_DEBUG){
+        printf("Saved V[0] through V[%d] to the RPL flags\n", decoded->x);
+    }
+}
+
+// FX85 Load V[0] through V[X] from the RPL user flags (SUPER-CHIP)
+static void OP(load_flags)(chip_8 *chip_8_object, const decoded_instruction *decoded){
+    memcpy(chip_8_object->V, chip_8_object->rpl_flags, decoded->x + 1);
+    if (PROFILE_DEBUG){
+        printf("Loaded V[0] through V[%d] from the RPL flags\n", decoded->x);
+    }
+}
+
+// Handlers indexed by chip8_opcode
+#define OPCODE_HANDLER(name, handler) [OPCODE_##name] = OP(handler),
+static const opcode_handler PROFILE_CONCAT(opcode_handlers, PROFILE_NAME)[OPCODE_COUNT] = {
+    CHIP8_OPCODE_LIST(OPCODE_HANDLER)
+};
+#undef OPCODE_HANDLER
+
+/*
+ * run_<profile> function
+ * Expects: chip_8_object to be decoding with this profile's handlers
+ * Does: chip8_run for this profile, a handler call per instruction or with CHIP8_DISPATCH_GOTO every opcode body
+ * jumps straight to the next opcode's body instead of returning to one shared indirect call, giving the branch
+ * predictor one indirect jump per opcode to learn
+ *
+ */
+static uint64_t PROFILE_CONCAT(run, PROFILE_NAME)(chip_8 *chip_8_object, uint64_t cycles){
+
+    uint64_t executed = 0;
+    decoded_instruction *decoded;
+
+#if CHIP8_DISPATCH_GOTO
+    #define OPCODE_LABEL(name, handler) [OPCODE_##name] = &&execute_##name,
+    static const void *const opcode_labels[OPCODE_COUNT] = {
+        CHIP8_OPCODE_LIST(OPCODE_LABEL)
+    };
+    #undef OPCODE_LABEL
+#endif
+
+    while (executed < cycles && chip8_is_running(chip_8_object)){
+
+        // Run up to the next timer tick (or the end of the budget) with nothing but instructions in the loop
+        uint64_t slice_start = executed;
+        uint64_t slice_end = executed + chip_8_object->cycles_until_tick;
+        if (slice_end > cycles){
+            slice_end = cycles;
+        }
+
+        // A program spinning in an idle loop is fast forwarded to whenever it could next see a change
+        if (!PROFILE_DEBUG){
+            uint64_t skipped = chip8_skip_idle(chip_8_object, slice_end - executed, cycles - executed);
+            if (CHIP8_PROFILER && chip_8_object->profiler){
+                chip_8_object->profiler->idle_skipped += skipped;
+            }
+            executed += skipped;
+        }
+
+#if CHIP8_DISPATCH_GOTO
+        #define DISPATCH_NEXT() \
+            if (executed >= slice_end || !chip8_is_running(chip_8_object)) { \
+                goto slice_done; \
+            } \
+            decoded = fetch_instruction(chip_8_object, PROFILE_DEBUG); \
+            if (CHIP8_PROFILER && chip_8_object->profiler) { \
+                count_instruction(chip_8_object->profiler, decoded, chip_8_object->PC - 2); \
+            } \
+            goto *opcode_labels[decoded->opcode];
+
+        DISPATCH_NEXT();
+
+        #define OPCODE_BODY(name, handler) \
+            execute_##name: \
+                OP(handler)(chip_8_object, decoded); \
+                executed++; \
+                DISPATCH_NEXT();
+        CHIP8_OPCODE_LIST(OPCODE_BODY)
+        #undef OPCODE_BODY
+        #undef DISPATCH_NEXT
+    slice_done:
+#else
+        while (executed < slice_end && chip8_is_running(chip_8_object)){
+            decoded = fetch_instruction(chip_8_object, PROFILE_DEBUG);
+            if (CHIP8_PROFILER && chip_8_object->profiler){
+                count_instruction(chip_8_object->profiler, decoded, chip_8_object->PC - 2);
+            }
+            decoded->handler(chip_8_object, decoded);
+            executed++;
+        }
+#endif
+
+        update_time_registers(chip_8_object, executed - slice_start);
+    }
+
+    return executed;
+
+}
+
+#ifndef PROFILE_GENERIC
+// What chip8_init matches the quirk globals against to pick this profile
+static const quirk_profile PROFILE_CONCAT(profile, PROFILE_NAME) = {
+    PROFILE_STRING(PROFILE_NAME),
+    VF_RESET_QUIRK, MEMORY_QUIRK, DISPLAY_WAIT_QUIRK, CLIPPING_QUIRK, SHIFTING_QUIRK, JUMPING_QUIRK,
+    PROFILE_CONCAT(opcode_handlers, PROFILE_NAME),
+    PROFILE_CONCAT(run, PROFILE_NAME)
+};
+#endif
+
+#undef OP
+#undef PROFILE_STRING
+#undef PROFILE_STRING_
+#undef PROFILE_CONCAT
+#undef PROFILE_CONCAT_
+#undef PROFILE_NAME
+#undef PROFILE_GENERIC
+#undef PROFILE_DEBUG
+#undef VF_RESET_QUIRK
+#undef MEMORY_QUIRK
+#undef DISPLAY_WAIT_QUIRK
+#undef CLIPPING_QUIRK
+#undef SHIFTING_QUIRK
+#undef JUMPING_QUIRK
@@ -0,0 +1,249 @@
+#include "chip_8_profiler.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Width of the longest bar in the text report's hot address histogram
+#define REPORT_BAR_WIDTH 40
+
+// Opcode names indexed by chip8_opcode
+#define OPCODE_NAME(name, handler) [OPCODE_##name] = #name,
+static const char *const opcode_names[OPCODE_COUNT] = {
+    CHIP8_OPCODE_LIST(OPCODE_NAME)
+};
+#undef OPCODE_NAME
+
+/*
+ * chip8_profiler_create function
+ * Expects: NA
+ * Does: Allocates a profiler with every count at zero, returns NULL if out of memory or if the core was built
+ * without CHIP8_PROFILER
+ *
+ */
+chip8_profiler *chip8_profiler_create(void){
+    if (!CHIP8_PROFILER){
+        return NULL;
+    }
+    return calloc(1, sizeof(chip8_profiler));
+}
+
+/*
+ * chip8_profiler_destroy function
+ * Expects: profiler to have come from chip8_profiler_create (or be NULL)
+ * Does: Frees the profiler
+ *
+ */
+void chip8_profiler_destroy(chip8_profiler *profiler){
+    free(profiler);
+}
+
+/*
+ * chip8_profiler_attach function
+ * Expects: chip_8_object to be initialized
+ * Does: Starts counting every instruction chip_8_object runs into profiler (NULL detaches)
+ *
+ */
+void chip8_profiler_attach(chip_8 *chip_8_object, chip8_profiler *profiler){
+    chip_8_object->profiler = profiler;
+}
+
+/*
+ * chip8_profiler_add_frame function
+ * Expects: execute_ns and sleep_ns to be how long one frontend frame spent running instructions and sleeping
+ * Does: Adds the frame to the main loop's totals
+ *
+ */
+void chip8_profiler_add_frame(chip8_profiler *profiler, uint64_t execute_ns, uint64_t sleep_ns){
+    profiler->frames++;
+    profiler->execute_ns += execute_ns;
+    profiler->sleep_ns += sleep_ns;
+}
+
+/*
+ * total_instructions function
+ * Expects: NA
+ * Does: Returns how many instructions were counted across every opcode
+ *
+ */
+static uint64_t total_instructions(const chip8_profiler *profiler){
+    uint64_t total = 0;
+    for (int i = 0; i < OPCODE_COUNT; i++){
+        total += profiler->opcode_counts[i];
+    }
+    return total;
+}
+
+/*
+ * hottest_addresses function
+ * Expects: addresses to hold CHIP8_PROFILER_HOT_ADDRESSES entries
+ * Does: Fills addresses with the most executed addresses, most executed first, and returns how many were executed
+ * at all (up to CHIP8_PROFILER_HOT_ADDRESSES)
+ *
+ */
+static int hottest_addresses(const chip8_profiler *profiler, int *addresses){
+
+    // Insertion into a short sorted list, one pass over memory
+    int found = 0;
+    for (int address = 0; address < MEMORY_SIZE; address++){
+        uint64_t count = profiler->address_counts[address];
+        if (count == 0 || (found == CHIP8_PROFILER_HOT_ADDRESSES &&
+                           count <= profiler->address_counts[addresses[found - 1]])){
+            continue;
+        }
+        int i = found < CHIP8_PROFILER_HOT_ADDRESSES ? found++ : found - 1;
+        while (i > 0 && profiler->address_counts[addresses[i - 1]] < count){
+            addresses[i] = addresses[i - 1];
+            i--;
+        }
+        addresses[i] = address;
+    }
+    return found;
+
+}
+
+/*
+ * instruction_at function
+ * Expects: address to be inside memory
+ * Does: Returns the instruction word at address as it is now
+ *
+ */
+static u16 instruction_at(const chip_8 *chip_8_object, int address){
+    u32 mask = chip_8_object->memory_mask;
+    return (chip_8_object->memory[address & mask] << 8) | chip_8_object->memory[(address + 1) & mask];
+}
+
+/*
+ * percent function
+ * Expects: NA
+ * Does: Returns part as a percentage of whole (0 when whole is 0)
+ *
+ */
+static double percent(uint64_t part, uint64_t whole){
+    return whole ? 100.0 * part / whole : 0.0;
+}
+
+/*
+ * chip8_profiler_write_report function
+ * Expects: out to be open for writing, chip_8_object to be the chip 8 that was profiled
+ * Does: Writes a readable report of everything counted
+ *
+ */
+void chip8_profiler_write_report(const chip8_profiler *profiler, const chip_8 *chip_8_object, FILE *out){
+
+    uint64_t total = total_instructions(profiler);
+    fprintf(out, "Profile: %llu instructions executed, %llu more fast forwarded as idle\n",
+            (unsigned long long)total, (unsigned long long)profiler->idle_skipped);
+
+    // Opcodes most executed first
+    int order[OPCODE_COUNT];
+    for (int i = 0; i < OPCODE_COUNT; i++){
+        order[i] = i;
+    }
+    for (int i = 1; i < OPCODE_COUNT; i++){
+        int opcode = order[i];
+        int j = i;
+        while (j > 0 && profiler->opcode_counts[order[j - 1]] < profiler->opcode_counts[opcode]){
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = opcode;
+    }
+    fprintf(out, "\nInstructions per opcode\n");
+    for (int i = 0; i < OPCODE_COUNT && profiler->opcode_counts[order[i]]; i++){
+        uint64_t count = profiler->opcode_counts[order[i]];
+        fprintf(out, "  %-26s %14llu  %6.2f%%\n", opcode_names[order[i]], (unsigned long long)count,
+                percent(count, total));
+    }
+
+    // Bars are scaled to the hottest address
+    int addresses[CHIP8_PROFILER_HOT_ADDRESSES];
+    int found = hottest_addresses(profiler, addresses);
+    fprintf(out, "\nHottest addresses\n");
+    for (int i = 0; i < found; i++){
+        uint64_t count = profiler->address_counts[addresses[i]];
+        int bar = (int)(count * REPORT_BAR_WIDTH / profiler->address_counts[addresses[0]]);
+        fprintf(out, "  0x%04X %04X %14llu  %6.2f%% %.*s\n", addresses[i], instruction_at(chip_8_object, addresses[i]),
+                (unsigned long long)count, percent(count, total), bar > 0 ? bar : 1,
+                "########################################");
+    }
+
+    fprintf(out, "\nDXYN: %llu sprites, %.1f pixels per sprite, %.2f%% collided, %llu held back by display wait\n",
+            (unsigned long long)profiler->draws,
+            profiler->draws ? (double)profiler->draw_pixels / profiler->draws : 0.0,
+            percent(profiler->draw_collisions, profiler->draws), (unsigned long long)profiler->draw_waits);
+
+    if (profiler->frames){
+        uint64_t frame_ns = profiler->execute_ns + profiler->sleep_ns;
+        fprintf(out, "Main loop: %llu frames, %.3f s executing (%.2f%%), %.3f s sleeping (%.2f%%)\n",
+                (unsigned long long)profiler->frames, profiler->execute_ns / 1e9,
+                percent(profiler->execute_ns, frame_ns), profiler->sleep_ns / 1e9,
+                percent(profiler->sleep_ns, frame_ns));
+    }
+
+}
+
+/*
+ * chip8_profiler_write_json function
+ * Expects: chip_8_object to be the chip 8 that was profiled
+ * Does: Writes the report as JSON to path, returns 0 on success else 1
+ *
+ */
+int chip8_profiler_write_json(const chip8_profiler *profiler, const chip_8 *chip_8_object, const char *path){
+
+    FILE *out = fopen(path, "w");
+    if (!out){
+        printf("Error: Can't write profile %s\n", path);
+        return 1;
+    }
+
+    fprintf(out, "{\n  \"instructions\": %llu,\n  \"idle_skipped\": %llu,\n",
+            (unsigned long long)total_instructions(profiler), (unsigned long long)profiler->idle_skipped);
+
+    fprintf(out, "  \"opcodes\": {");
+    bool first = true;
+    for (int i = 0; i < OPCODE_COUNT; i++){
+        if (profiler->opcode_counts[i]){
+            fprintf(out, "%s\n    \"%s\": %llu", first ? "" : ",", opcode_names[i],
+                    (unsigned long long)profiler->opcode_counts[i]);
+            first = false;
+        }
+    }
+    fprintf(out, "\n  },\n");
+
+    int addresses[CHIP8_PROFILER_HOT_ADDRESSES];
+    int found = hottest_addresses(profiler, addresses);
+    fprintf(out, "  \"hot_addresses\": [");
+    for (int i = 0; i < found; i++){
+        fprintf(out, "%s\n    {\"address\": %d, \"instruction\": %d, \"count\": %llu}", i ? "," : "", addresses[i],
+                instruction_at(chip_8_object, addresses[i]), (unsigned long long)profiler->address_counts[addresses[i]]);
+    }
+    fprintf(out, "\n  ],\n");
+
+    // Whole histogram at page granularity, keyed by the page's first address
+    fprintf(out, "  \"pages\": {");
+    first = true;
+    for (int page = 0; page < MEMORY_SIZE; page += 256){
+        uint64_t count = 0;
+        for (int i = page; i < page + 256; i++){
+            count += profiler->address_counts[i];
+        }
+        if (count){
+            fprintf(out, "%s\n    \"%d\": %llu", first ? "" : ",", page, (unsigned long long)count);
+            first = false;
+        }
+    }
+    fprintf(out, "\n  },\n");
+
+    fprintf(out, "  \"draw\": {\"sprites\": %llu, \"pixels\": %llu, \"collisions\": %llu, \"display_waits\": %llu},\n",
+            (unsigned long long)profiler->draws, (unsigned long long)profiler->draw_pixels,
+            (unsigned long long)profiler->draw_collisions, (unsigned long long)profiler->draw_waits);
+    fprintf(out, "  \"main_loop\": {\"frames\": %llu, \"execute_ns\": %llu, \"sleep_ns\": %llu}\n}\n",
+            (unsigned long long)profiler->frames, (unsigned long long)profiler->execute_ns,
+            (unsigned long long)profiler->sleep_ns);
+
+    if (fclose(out) != 0){
+        printf("Error: Can't write profile %s\n", path);
+        return 1;
+    }
+    return 0;
+
+}
@@ -0,0 +1,90 @@
+#ifndef chip8_profiler_h
+#define chip8_profiler_h
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "chip_8_core.h"
+
+// Hot addresses listed in the reports (the JSON also has every page's total)
+#define CHIP8_PROFILER_HOT_ADDRESSES 32
+
+/*
+ * chip8_profiler struct
+ * Expects: N/A
+ * Does: Everything counted while a profiler is attached, the core bumps these directly from its run loop and
+ * opcode handlers (only in builds with CHIP8_PROFILER=1, otherwise none of the counting is compiled in)
+ */
+struct chip8_profiler {
+
+    // Instructions executed per chip8_opcode and per address they were fetched from
+    uint64_t opcode_counts[OPCODE_COUNT];
+    uint64_t address_counts[MEMORY_SIZE];
+
+    // Instructions the idle loop detector fast forwarded instead of running
+    uint64_t idle_skipped;
+
+    // DXYN: sprites drawn, sprite pixels XORed in, draws that collided and draws held back by display wait
+    uint64_t draws;
+    uint64_t draw_pixels;
+    uint64_t draw_collisions;
+    uint64_t draw_waits;
+
+    // Frontend main loop: frames run and how long was spent running instructions vs sleeping for the next frame
+    uint64_t frames;
+    uint64_t execute_ns;
+    uint64_t sleep_ns;
+
+};
+
+/*
+ * chip8_profiler_create function
+ * Expects: NA
+ * Does: Allocates a profiler with every count at zero, returns NULL if out of memory or if the core was built
+ * without CHIP8_PROFILER (make PROFILER=1)
+ *
+ */
+chip8_profiler *chip8_profiler_create(void);
+
+/*
+ * chip8_profiler_destroy function
+ * Expects: profiler to have come from chip8_profiler_create (or be NULL) and not be attached to a running chip 8
+ * Does: Frees the profiler
+ *
+ */
+void chip8_profiler_destroy(chip8_profiler *profiler);
+
+/*
+ * chip8_profiler_attach function
+ * Expects: chip_8_object to be initialized
+ * Does: Starts counting every instruction chip_8_object runs into profiler (NULL detaches), chip8_run uses the
+ * interpreter while a profiler is attached so nothing runs uncounted in compiled blocks
+ *
+ */
+void chip8_profiler_attach(chip_8 *chip_8_object, chip8_profiler *profiler);
+
+/*
+ * chip8_profiler_add_frame function
+ * Expects: execute_ns and sleep_ns to be how long one frontend frame spent running instructions and sleeping
+ * Does: Adds the frame to the main loop's totals
+ *
+ */
+void chip8_profiler_add_frame(chip8_profiler *profiler, uint64_t execute_ns, uint64_t sleep_ns);
+
+/*
+ * chip8_profiler_write_report function
+ * Expects: out to be open for writing, chip_8_object to be the chip 8 that was profiled (for the instruction words)
+ * Does: Writes a readable report: instructions per opcode, the hottest addresses as a histogram, DXYN stats and
+ * the main loop's execute vs sleep time
+ *
+ */
+void chip8_profiler_write_report(const chip8_profiler *profiler, const chip_8 *chip_8_object, FILE *out);
+
+/*
+ * chip8_profiler_write_json function
+ * Expects: chip_8_object to be the chip 8 that was profiled
+ * Does: Writes the same report as JSON (plus instructions per 256 byte page) to path, returns 0 on success else 1
+ *
+ */
+int chip8_profiler_write_json(const chip8_profiler *profiler, const chip_8 *chip_8_object, const char *path);
+
+#endif /* chip8_profiler_h */
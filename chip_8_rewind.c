@@ -0,0 +1,309 @@
+#include "chip_8_rewind.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chip_8_state.h"
+
+/*
+ * How frames are kept
+ *
+ * The newest frame is held as a full save state (the keyframe). Every older frame is stored as the XOR of it and
+ * the frame after it, so stepping back one frame is XORing one delta into the keyframe, and because no delta
+ * depends on anything older than itself the oldest frames can be dropped at any time. Frames barely change from
+ * one to the next so the deltas are almost all zeros and are run length encoded as
+ *     [zeros to skip][bytes that follow][those bytes XORed]   (both counts as 7 bit varints)
+ * repeated until the end of the state. The deltas live back to back in a ring arena, newest after oldest.
+ */
+
+// Shortest run of zeros worth ending a literal run for (a shorter gap costs more as a new header than as literals)
+#define REWIND_MIN_ZERO_RUN 3
+
+// Worst case encoded delta: every byte literal plus the run headers
+#define REWIND_MAX_DELTA (CHIP8_STATE_MAX_SIZE + 64)
+
+/*
+ * rewind_frame struct
+ * Expects: N/A
+ * Does: Where one encoded delta sits in the arena
+ */
+typedef struct rewind_frame {
+    uint32_t offset;
+    uint32_t length;
+} rewind_frame;
+
+struct chip8_rewind {
+
+    // Encoded deltas, back to back and wrapping round to the start
+    u8 *arena;
+    size_t arena_size;
+    size_t write_position;
+
+    // Ring of stored deltas, oldest first
+    rewind_frame *frames;
+    int frame_capacity;
+    int oldest;
+    int count;
+
+    // The newest frame in full, and room to build the next one (state_size bytes of each are used, it depends
+    // on the mode)
+    u8 keyframe[CHIP8_STATE_MAX_SIZE];
+    bool has_keyframe;
+    size_t state_size;
+    u8 next_frame[CHIP8_STATE_MAX_SIZE];
+    u8 delta[REWIND_MAX_DELTA];
+
+};
+
+/*
+ * put_varint function
+ * Expects: out to have room for 3 bytes
+ * Does: Writes value 7 bits at a time (high bit set on every byte but the last), returns the bytes written
+ *
+ */
+static inline int put_varint(u8 *out, uint32_t value){
+    int length = 0;
+    while (value >= 0x80){
+        out[length++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    out[length++] = value;
+    return length;
+}
+
+/*
+ * get_varint function
+ * Expects: in to hold a varint written by put_varint
+ * Does: Reads the varint at *position and moves *position past it
+ *
+ */
+static inline uint32_t get_varint(const u8 *in, size_t *position){
+    uint32_t value = 0;
+    int shift = 0;
+    u8 byte;
+    do {
+        byte = in[(*position)++];
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return value;
+}
+
+/*
+ * encode_delta function
+ * Expects: newer and older to be size byte states and out to hold REWIND_MAX_DELTA bytes
+ * Does: Run length encodes newer XOR older into out, returns the encoded length
+ *
+ */
+static size_t encode_delta(const u8 *newer, const u8 *older, size_t size, u8 *out){
+
+    size_t length = 0;
+    size_t i = 0;
+
+    while (i < size){
+        size_t zeros_start = i;
+        while (i < size && newer[i] == older[i]){
+            i++;
+        }
+
+        // Literals run until a gap of unchanged bytes long enough to be worth skipping
+        size_t literal_start = i;
+        size_t literal_end = i;
+        while (i < size){
+            if (newer[i] != older[i]){
+                i++;
+                literal_end = i;
+            }
+            else if (i - literal_end + 1 >= REWIND_MIN_ZERO_RUN){
+                break;
+            }
+            else {
+                i++;
+            }
+        }
+        i = literal_end;
+
+        length += put_varint(&out[length], literal_start - zeros_start);
+        length += put_varint(&out[length], literal_end - literal_start);
+        for (size_t j = literal_start; j < literal_end; j++){
+            out[length++] = newer[j] ^ older[j];
+        }
+    }
+
+    return length;
+
+}
+
+/*
+ * apply_delta function
+ * Expects: delta to have come from encode_delta
+ * Does: XORs the delta into state, turning either of the two states it was made from into the other
+ *
+ */
+static void apply_delta(u8 *state, const u8 *delta, size_t length){
+
+    size_t position = 0;
+    size_t i = 0;
+    while (position < length){
+        i += get_varint(delta, &position);
+        uint32_t literals = get_varint(delta, &position);
+        for (uint32_t j = 0; j < literals; j++){
+            state[i++] ^= delta[position++];
+        }
+    }
+
+}
+
+/*
+ * drop_oldest function
+ * Expects: rewind_buffer to hold at least one delta
+ * Does: Forgets the oldest stored delta
+ *
+ */
+static inline void drop_oldest(chip8_rewind *rewind_buffer){
+    rewind_buffer->oldest = (rewind_buffer->oldest + 1) % rewind_buffer->frame_capacity;
+    rewind_buffer->count--;
+}
+
+/*
+ * chip8_rewind_create function
+ * Expects: arena_size to be at least a few KB
+ * Does: Allocates a rewind buffer that keeps as many frames as fit in arena_size bytes, returns NULL if out of memory
+ *
+ */
+chip8_rewind *chip8_rewind_create(size_t arena_size){
+
+    if (arena_size < REWIND_MAX_DELTA){
+        arena_size = REWIND_MAX_DELTA;
+    }
+
+    chip8_rewind *rewind_buffer = calloc(1, sizeof(chip8_rewind));
+    if (!rewind_buffer){
+        return NULL;
+    }
+
+    // An unchanged frame still costs a few bytes so the arena runs out long before this many frames
+    rewind_buffer->frame_capacity = arena_size / 32;
+    rewind_buffer->arena_size = arena_size;
+    rewind_buffer->arena = malloc(arena_size);
+    rewind_buffer->frames = malloc(rewind_buffer->frame_capacity * sizeof(rewind_frame));
+    if (!rewind_buffer->arena || !rewind_buffer->frames){
+        chip8_rewind_destroy(rewind_buffer);
+        return NULL;
+    }
+
+    return rewind_buffer;
+
+}
+
+/*
+ * chip8_rewind_destroy function
+ * Expects: rewind_buffer to have come from chip8_rewind_create (or be NULL)
+ * Does: Frees the rewind buffer
+ *
+ */
+void chip8_rewind_destroy(chip8_rewind *rewind_buffer){
+    if (!rewind_buffer){
+        return;
+    }
+    free(rewind_buffer->arena);
+    free(rewind_buffer->frames);
+    free(rewind_buffer);
+}
+
+/*
+ * chip8_rewind_push function
+ * Expects: to be called once per frame after the frame's instructions ran
+ * Does: Records the chip 8 as the newest frame, the oldest frames are dropped once the arena is full
+ *
+ */
+void chip8_rewind_push(chip8_rewind *rewind_buffer, const chip_8 *chip_8_object){
+
+    // The very first frame only becomes the keyframe
+    if (!rewind_buffer->has_keyframe){
+        rewind_buffer->state_size = chip8_save_state(chip_8_object, rewind_buffer->keyframe, sizeof(rewind_buffer->keyframe));
+        rewind_buffer->has_keyframe = true;
+        return;
+    }
+
+    chip8_save_state(chip_8_object, rewind_buffer->next_frame, sizeof(rewind_buffer->next_frame));
+    size_t length = encode_delta(rewind_buffer->next_frame, rewind_buffer->keyframe, rewind_buffer->state_size,
+                                 rewind_buffer->delta);
+
+    // Deltas never wrap, one that won't fit before the end starts over at the front of the arena. Anything
+    // between here and the end is older than what's at the front so it goes first
+    size_t position = rewind_buffer->write_position;
+    if (position + length > rewind_buffer->arena_size){
+        while (rewind_buffer->count > 0 && rewind_buffer->frames[rewind_buffer->oldest].offset >= position){
+            drop_oldest(rewind_buffer);
+        }
+        position = 0;
+    }
+
+    // Make room by dropping the oldest deltas the new one would overwrite
+    while (rewind_buffer->count > 0){
+        rewind_frame *oldest = &rewind_buffer->frames[rewind_buffer->oldest];
+        bool overlaps = oldest->offset < position + length && position < oldest->offset + oldest->length;
+        if (!overlaps && rewind_buffer->count < rewind_buffer->frame_capacity){
+            break;
+        }
+        drop_oldest(rewind_buffer);
+    }
+
+    memcpy(&rewind_buffer->arena[position], rewind_buffer->delta, length);
+    rewind_frame *frame = &rewind_buffer->frames[(rewind_buffer->oldest + rewind_buffer->count) % rewind_buffer->frame_capacity];
+    frame->offset = position;
+    frame->length = length;
+    rewind_buffer->count++;
+    rewind_buffer->write_position = position + length;
+
+    memcpy(rewind_buffer->keyframe, rewind_buffer->next_frame, rewind_buffer->state_size);
+
+}
+
+/*
+ * chip8_rewind_pop function
+ * Expects: chip_8_object to be the chip 8 that was pushed and to not have run since the last push or pop
+ * Does: Puts chip_8_object back to the frame before the newest one and forgets the newest, returns 0 on success
+ * else 1 when there is nothing older left to go back to
+ *
+ */
+int chip8_rewind_pop(chip8_rewind *rewind_buffer, chip_8 *chip_8_object){
+
+    if (rewind_buffer->count == 0){
+        return 1;
+    }
+
+    rewind_buffer->count--;
+    rewind_frame *newest = &rewind_buffer->frames[(rewind_buffer->oldest + rewind_buffer->count) % rewind_buffer->frame_capacity];
+    apply_delta(rewind_buffer->keyframe, &rewind_buffer->arena[newest->offset], newest->length);
+
+    // The popped delta's space is free again
+    rewind_buffer->write_position = newest->offset;
+
+    return chip8_load_state(chip_8_object, rewind_buffer->keyframe, rewind_buffer->state_size);
+
+}
+
+/*
+ * chip8_rewind_frames function
+ * Expects: NA
+ * Does: Returns how many frames back the buffer can currently go
+ *
+ */
+int chip8_rewind_frames(const chip8_rewind *rewind_buffer){
+    return rewind_buffer->count;
+}
+
+/*
+ * chip8_rewind_bytes_used function
+ * Expects: NA
+ * Does: Returns how many bytes of the arena the stored frames take up
+ *
+ */
+size_t chip8_rewind_bytes_used(const chip8_rewind *rewind_buffer){
+    size_t used = 0;
+    for (int i = 0; i < rewind_buffer->count; i++){
+        used += rewind_buffer->frames[(rewind_buffer->oldest + i) % rewind_buffer->frame_capacity].length;
+    }
+    return used;
+}
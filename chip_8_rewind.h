@@ -0,0 +1,60 @@
+#ifndef chip8_rewind_h
+#define chip8_rewind_h
+#include <stddef.h>
+#include "chip_8_core.h"
+
+// Default arena size, enough for well over a minute of typical gameplay at 60 frames a second
+#define CHIP8_REWIND_DEFAULT_ARENA (512 * 1024)
+
+typedef struct chip8_rewind chip8_rewind;
+
+/*
+ * chip8_rewind_create function
+ * Expects: arena_size to be at least a few KB
+ * Does: Allocates a rewind buffer that keeps as many frames as fit in arena_size bytes, returns NULL if out of memory
+ *
+ */
+chip8_rewind *chip8_rewind_create(size_t arena_size);
+
+/*
+ * chip8_rewind_destroy function
+ * Expects: rewind_buffer to have come from chip8_rewind_create (or be NULL)
+ * Does: Frees the rewind buffer
+ *
+ */
+void chip8_rewind_destroy(chip8_rewind *rewind_buffer);
+
+/*
+ * chip8_rewind_push function
+ * Expects: to be called once per frame after the frame's instructions ran
+ * Does: Records the chip 8 as the newest frame, the oldest frames are dropped once the arena is full
+ *
+ */
+void chip8_rewind_push(chip8_rewind *rewind_buffer, const chip_8 *chip_8_object);
+
+/*
+ * chip8_rewind_pop function
+ * Expects: chip_8_object to be the chip 8 that was pushed and to not have run since the last push or pop
+ * Does: Puts chip_8_object back to the frame before the newest one and forgets the newest, returns 0 on success
+ * else 1 when there is nothing older left to go back to
+ *
+ */
+int chip8_rewind_pop(chip8_rewind *rewind_buffer, chip_8 *chip_8_object);
+
+/*
+ * chip8_rewind_frames function
+ * Expects: NA
+ * Does: Returns how many frames back the buffer can currently go
+ *
+ */
+int chip8_rewind_frames(const chip8_rewind *rewind_buffer);
+
+/*
+ * chip8_rewind_bytes_used function
+ * Expects: NA
+ * Does: Returns how many bytes of the arena the stored frames take up
+ *
+ */
+size_t chip8_rewind_bytes_used(const chip8_rewind *rewind_buffer);
+
+#endif /* chip8_rewind_h */
@@ -0,0 +1,342 @@
+#include "chip_8_state.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * Layout of a C8ST save state, every multi byte value is big endian
+ *
+ *   0  "C8ST"          4  version        6  flags (0)
+ *   8  PC             10  I             12  rom end (4 bytes)
+ *  16  SP             17  stack depth   18  16 stack entries
+ *  50  delay timer    51  sound timer   52  display wait timer   53  input flags (bit 0 = Fx0A waiting)
+ *  54  rng state (8)  62  V0 - VF       78  instructions until the next timer tick
+ *  82  mode           83  display flags (bit 0 = hires)          84  selected planes   85  pitch
+ *  86  RPL flags     102  audio pattern
+ * 118  display, per plane 64 rows of 16 bytes (leftmost pixel in the top bit)
+ * 2166  memory (4096 bytes, 65536 for XO-CHIP)
+ */
+enum {
+    STATE_MAGIC = 0,
+    STATE_VERSION = 4,
+    STATE_FLAGS = 6,
+    STATE_PC = 8,
+    STATE_I = 10,
+    STATE_ROM_END = 12,
+    STATE_SP = 16,
+    STATE_STACK_DEPTH = 17,
+    STATE_STACK = 18,
+    STATE_DELAY = 50,
+    STATE_SOUND = 51,
+    STATE_DISPLAY_WAIT = 52,
+    STATE_INPUT_FLAGS = 53,
+    STATE_RNG_STATE = 54,
+    STATE_V = 62,
+    STATE_CYCLES_UNTIL_TICK = 78,
+    STATE_MODE = 82,
+    STATE_DISPLAY_FLAGS = 83,
+    STATE_PLANES = 84,
+    STATE_PITCH = 85,
+    STATE_RPL_FLAGS = 86,
+    STATE_AUDIO_PATTERN = 102,
+    STATE_DISPLAY = 118,
+    STATE_MEMORY = STATE_DISPLAY + CHIP8_PLANES * CHIP8_HIRES_HEIGHT * 16,
+    STATE_END = STATE_MEMORY + MEMORY_SIZE
+};
+_Static_assert(STATE_MEMORY == CHIP8_STATE_HEADER_SIZE, "CHIP8_STATE_HEADER_SIZE doesn't match the state layout");
+_Static_assert(STATE_END == CHIP8_STATE_MAX_SIZE, "CHIP8_STATE_MAX_SIZE doesn't match the state layout");
+
+static const u8 state_magic[4] = { 'C', '8', 'S', 'T' };
+
+/* Big endian helpers so a state moves between hosts unchanged */
+
+static inline void put_u16(u8 *out, u16 value){
+    out[0] = value >> 8;
+    out[1] = value;
+}
+
+static inline void put_u32(u8 *out, uint32_t value){
+    put_u16(out, value >> 16);
+    put_u16(out + 2, value);
+}
+
+static inline void put_u64(u8 *out, u64 value){
+    put_u32(out, value >> 32);
+    put_u32(out + 4, value);
+}
+
+static inline u16 get_u16(const u8 *in){
+    return (in[0] << 8) | in[1];
+}
+
+static inline uint32_t get_u32(const u8 *in){
+    return ((uint32_t)get_u16(in) << 16) | get_u16(in + 2);
+}
+
+static inline u64 get_u64(const u8 *in){
+    return ((u64)get_u32(in) << 32) | get_u32(in + 4);
+}
+
+/*
+ * chip8_state_size function
+ * Expects: chip_8_object to be initialized
+ * Does: Returns how many bytes chip8_save_state writes for chip_8_object
+ *
+ */
+size_t chip8_state_size(const chip_8 *chip_8_object){
+    return STATE_MEMORY + chip_8_object->memory_mask + 1;
+}
+
+/*
+ * chip8_save_state function
+ * Expects: buffer to hold at least size bytes
+ * Does: Writes the chip 8 into buffer in the C8ST format, returns the bytes written or 0 if it doesn't fit
+ *
+ */
+size_t chip8_save_state(const chip_8 *chip_8_object, u8 *buffer, size_t size){
+
+    size_t state_size = chip8_state_size(chip_8_object);
+    if (size < state_size){
+        return 0;
+    }
+
+    memcpy(&buffer[STATE_MAGIC], state_magic, sizeof(state_magic));
+    put_u16(&buffer[STATE_VERSION], CHIP8_STATE_VERSION);
+    put_u16(&buffer[STATE_FLAGS], 0);
+
+    put_u16(&buffer[STATE_PC], chip_8_object->PC);
+    put_u16(&buffer[STATE_I], chip_8_object->I);
+    put_u32(&buffer[STATE_ROM_END], chip_8_object->rom_end);
+    buffer[STATE_SP] = chip_8_object->SP;
+
+    // Only the entries below the top are live but the whole stack is kept so a restore is exact
+    buffer[STATE_STACK_DEPTH] = chip_8_object->emulated_stack.top + 1;
+    for (int i = 0; i < 16; i++){
+        put_u16(&buffer[STATE_STACK + i * 2], chip_8_object->emulated_stack.emulated_stack_array[i]);
+    }
+
+    buffer[STATE_DELAY] = chip_8_object->delay_register;
+    buffer[STATE_SOUND] = chip_8_object->sound_register;
+    buffer[STATE_DISPLAY_WAIT] = chip_8_object->display_wait_timer;
+    buffer[STATE_INPUT_FLAGS] = chip_8_object->waiting_for_key;
+    put_u64(&buffer[STATE_RNG_STATE], chip_8_object->rng_state);
+
+    memcpy(&buffer[STATE_V], chip_8_object->V, 16);
+
+    put_u32(&buffer[STATE_CYCLES_UNTIL_TICK], chip_8_object->cycles_until_tick);
+
+    buffer[STATE_MODE] = chip_8_object->mode;
+    buffer[STATE_DISPLAY_FLAGS] = chip_8_object->hires;
+    buffer[STATE_PLANES] = chip_8_object->planes;
+    buffer[STATE_PITCH] = chip_8_object->pitch;
+    memcpy(&buffer[STATE_RPL_FLAGS], chip_8_object->rpl_flags, 16);
+    memcpy(&buffer[STATE_AUDIO_PATTERN], chip_8_object->audio_pattern, 16);
+
+    u8 *display = &buffer[STATE_DISPLAY];
+    for (int plane = 0; plane < CHIP8_PLANES; plane++){
+        for (int i = 0; i < CHIP8_HIRES_HEIGHT; i++){
+            put_u64(display, chip_8_object->display[plane][i][0]);
+            put_u64(display + 8, chip_8_object->display[plane][i][1]);
+            display += 16;
+        }
+    }
+
+    memcpy(&buffer[STATE_MEMORY], chip_8_object->memory, chip_8_object->memory_mask + 1);
+
+    return state_size;
+
+}
+
+/*
+ * chip8_load_state function
+ * Expects: chip_8_object to be initialized with chip8_init
+ * Does: Restores the chip 8 from a C8ST state, returns 0 on success else 1 leaving chip_8_object untouched
+ *
+ */
+int chip8_load_state(chip_8 *chip_8_object, const u8 *buffer, size_t size){
+
+    // Validate everything before touching the chip 8
+    if (size < STATE_MEMORY || memcmp(&buffer[STATE_MAGIC], state_magic, sizeof(state_magic)) != 0){
+        printf("Error: Not a chip 8 save state\n");
+        return 1;
+    }
+    if (get_u16(&buffer[STATE_VERSION]) != CHIP8_STATE_VERSION){
+        printf("Error: Save state version %d isn't supported (expected %d)\n",
+               get_u16(&buffer[STATE_VERSION]), CHIP8_STATE_VERSION);
+        return 1;
+    }
+    // Memory size, fonts and decoding all hang off the mode so a state only goes back into the mode it came from
+    if (buffer[STATE_MODE] != chip_8_object->mode){
+        printf("Error: Save state is from %s mode but this is running in %s mode\n",
+               buffer[STATE_MODE] <= CHIP8_MODE_XOCHIP ? chip8_mode_name(buffer[STATE_MODE]) : "an unknown",
+               chip8_mode_name(chip_8_object->mode));
+        return 1;
+    }
+    int memory_length = chip_8_object->memory_mask + 1;
+    if (size < chip8_state_size(chip_8_object) || buffer[STATE_STACK_DEPTH] > 16 ||
+        get_u32(&buffer[STATE_ROM_END]) > (uint32_t)memory_length){
+        printf("Error: Save state is corrupt\n");
+        return 1;
+    }
+
+    // Only memory that differs invalidates decoded instructions and compiled blocks, rewinding a frame
+    // usually changes a handful of bytes and the rest of the caches stay warm
+    const u8 *memory = &buffer[STATE_MEMORY];
+    int run_start = -1;
+    for (int i = 0; i <= memory_length; i += 8){
+        bool differs = i < memory_length && memcmp(&chip_8_object->memory[i], &memory[i], 8) != 0;
+        if (differs && run_start < 0){
+            run_start = i;
+        }
+        else if (!differs && run_start >= 0){
+            memcpy(&chip_8_object->memory[run_start], &memory[run_start], i - run_start);
+            chip8_memory_written(chip_8_object, run_start, i - run_start);
+            run_start = -1;
+        }
+    }
+
+    // Same for the display, only rows that change need redrawing (all of them if the resolution changes)
+    bool hires = buffer[STATE_DISPLAY_FLAGS] & 1;
+    if (hires != chip_8_object->hires){
+        chip_8_object->hires = hires;
+        chip_8_object->dirty_rows = ~(u64)0;
+    }
+    const u8 *display = &buffer[STATE_DISPLAY];
+    for (int plane = 0; plane < CHIP8_PLANES; plane++){
+        for (int i = 0; i < CHIP8_HIRES_HEIGHT; i++){
+            u64 *row = chip_8_object->display[plane][i];
+            u64 left = get_u64(display);
+            u64 right = get_u64(display + 8);
+            if (left != row[0] || right != row[1]){
+                row[0] = left;
+                row[1] = right;
+                chip_8_object->dirty_rows |= (u64)1 << i;
+            }
+            display += 16;
+        }
+    }
+
+    chip_8_object->PC = get_u16(&buffer[STATE_PC]);
+    chip_8_object->I = get_u16(&buffer[STATE_I]);
+    chip_8_object->rom_end = get_u32(&buffer[STATE_ROM_END]);
+    chip_8_object->SP = buffer[STATE_SP];
+
+    chip_8_object->emulated_stack.top = buffer[STATE_STACK_DEPTH] - 1;
+    for (int i = 0; i < 16; i++){
+        chip_8_object->emulated_stack.emulated_stack_array[i] = get_u16(&buffer[STATE_STACK + i * 2]);
+    }
+
+    chip_8_object->delay_register = buffer[STATE_DELAY];
+    chip_8_object->sound_register = buffer[STATE_SOUND];
+    chip_8_object->display_wait_timer = buffer[STATE_DISPLAY_WAIT];
+
+    // Queued key presses belong to the frames being left behind
+    chip_8_object->waiting_for_key = buffer[STATE_INPUT_FLAGS] & 1;
+    chip_8_object->key_press_count = 0;
+    chip_8_object->rng_state = get_u64(&buffer[STATE_RNG_STATE]);
+
+    memcpy(chip_8_object->V, &buffer[STATE_V], 16);
+
+    chip_8_object->planes = buffer[STATE_PLANES] & 3;
+    chip_8_object->pitch = buffer[STATE_PITCH];
+    memcpy(chip_8_object->rpl_flags, &buffer[STATE_RPL_FLAGS], 16);
+    memcpy(chip_8_object->audio_pattern, &buffer[STATE_AUDIO_PATTERN], 16);
+
+    // Timers pick up exactly where they were, as long as that's within the tick length in use now
+    u32 cycles_until_tick = get_u32(&buffer[STATE_CYCLES_UNTIL_TICK]);
+    if (cycles_until_tick == 0 || cycles_until_tick > chip_8_object->cycles_per_tick){
+        cycles_until_tick = chip_8_object->cycles_per_tick;
+    }
+    chip_8_object->cycles_until_tick = cycles_until_tick;
+
+    return 0;
+
+}
+
+/*
+ * chip8_save_state_file function
+ * Expects: path to be somewhere writable
+ * Does: Saves the chip 8 to path through path.tmp and a rename, returns 0 on success else 1
+ *
+ */
+int chip8_save_state_file(const chip_8 *chip_8_object, const char *path){
+
+    // XO-CHIP states are too big to comfortably put on the stack
+    size_t state_size = chip8_state_size(chip_8_object);
+    u8 *buffer = malloc(state_size);
+    if (!buffer){
+        printf("Error: Can't write save state %s\n", path);
+        return 1;
+    }
+    chip8_save_state(chip_8_object, buffer, state_size);
+
+    size_t path_length = strlen(path);
+    char *temporary_path = malloc(path_length + 5);
+    if (!temporary_path){
+        printf("Error: Can't write save state %s\n", path);
+        free(buffer);
+        return 1;
+    }
+    memcpy(temporary_path, path, path_length);
+    memcpy(temporary_path + path_length, ".tmp", 5);
+
+    FILE *file = fopen(temporary_path, "wb");
+    if (!file){
+        printf("Error: Can't write save state %s\n", temporary_path);
+        free(temporary_path);
+        free(buffer);
+        return 1;
+    }
+
+    bool written = fwrite(buffer, 1, state_size, file) == state_size;
+    written = (fclose(file) == 0) && written;
+    free(buffer);
+    if (!written || rename(temporary_path, path) != 0){
+        printf("Error: Can't write save state %s\n", path);
+        remove(temporary_path);
+        free(temporary_path);
+        return 1;
+    }
+
+    free(temporary_path);
+    return 0;
+
+}
+
+/*
+ * chip8_load_state_file function
+ * Expects: chip_8_object to be initialized with chip8_init and path to be a state saved by chip8_save_state_file
+ * Does: Maps the file and restores the chip 8 straight out of the mapping, returns 0 on success else 1
+ *
+ */
+int chip8_load_state_file(chip_8 *chip_8_object, const char *path){
+
+    int file = open(path, O_RDONLY);
+    if (file < 0){
+        printf("Error: Can't open save state %s\n", path);
+        return 1;
+    }
+
+    struct stat file_stat;
+    if (fstat(file, &file_stat) != 0 || file_stat.st_size < CHIP8_STATE_HEADER_SIZE){
+        printf("Error: %s is too small to be a save state\n", path);
+        close(file);
+        return 1;
+    }
+
+    const u8 *mapped = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (mapped == MAP_FAILED){
+        printf("Error: Can't map save state %s\n", path);
+        return 1;
+    }
+
+    int status = chip8_load_state(chip_8_object, mapped, file_stat.st_size);
+    munmap((void *)mapped, file_stat.st_size);
+    return status;
+
+}
@@ -0,0 +1,61 @@
+#ifndef chip8_state_h
+#define chip8_state_h
+#include <stddef.h>
+#include "chip_8_core.h"
+
+// Current version of the save state format, bumped whenever the layout changes
+#define CHIP8_STATE_VERSION 4
+
+// Bytes in a version 4 save state before memory: header, registers, stack, timers, rng, mode and the bit packed
+// display (1 bit per pixel, both planes at 128x64)
+#define CHIP8_STATE_HEADER_SIZE 2166
+
+// Bytes in the largest save state (XO-CHIP's 64 KB of memory), CHIP-8 and SUPER-CHIP states are 6262 bytes
+#define CHIP8_STATE_MAX_SIZE (CHIP8_STATE_HEADER_SIZE + MEMORY_SIZE)
+
+/*
+ * chip8_state_size function
+ * Expects: chip_8_object to be initialized
+ * Does: Returns how many bytes chip8_save_state writes for chip_8_object (it depends on the mode's memory size)
+ *
+ */
+size_t chip8_state_size(const chip_8 *chip_8_object);
+
+/*
+ * chip8_save_state function
+ * Expects: buffer to hold at least size bytes
+ * Does: Writes the chip 8 (memory, registers, stack, timers, display and rng) into buffer in the C8ST format,
+ * returns the number of bytes written or 0 if size is smaller than chip8_state_size
+ *
+ */
+size_t chip8_save_state(const chip_8 *chip_8_object, u8 *buffer, size_t size);
+
+/*
+ * chip8_load_state function
+ * Expects: chip_8_object to be initialized with chip8_init
+ * Does: Restores the chip 8 from a state written by chip8_save_state, only throwing away decoded instructions
+ * and compiled blocks for memory the state actually changes and marking only the display rows that differ,
+ * returns 0 on success else 1 (after printing why, including a state from another mode) leaving chip_8_object
+ * untouched
+ *
+ */
+int chip8_load_state(chip_8 *chip_8_object, const u8 *buffer, size_t size);
+
+/*
+ * chip8_save_state_file function
+ * Expects: path to be somewhere writable
+ * Does: Saves the chip 8 to path (written to path.tmp then renamed so a crash never leaves half a state behind),
+ * returns 0 on success else 1
+ *
+ */
+int chip8_save_state_file(const chip_8 *chip_8_object, const char *path);
+
+/*
+ * chip8_load_state_file function
+ * Expects: chip_8_object to be initialized with chip8_init and path to be a state saved by chip8_save_state_file
+ * Does: Maps the file and restores the chip 8 straight out of the mapping, returns 0 on success else 1
+ *
+ */
+int chip8_load_state_file(chip_8 *chip_8_object, const char *path);
+
+#endif /* chip8_state_h */
@@ -0,0 +1,65 @@
+#include "chip_8_triple_buffer.h"
+#include <string.h>
+
+// Set on the middle index while the frame in it hasn't been taken by the reader
+#define TRIPLE_BUFFER_FRESH 4u
+
+/*
+ * chip8_triple_buffer_init function
+ * Expects: buffer to point at writable memory
+ * Does: Starts the buffer with three blank frames and nothing published
+ *
+ */
+void chip8_triple_buffer_init(chip8_triple_buffer *buffer){
+
+    memset(buffer, 0, sizeof(*buffer));
+    buffer->front = 0;
+    atomic_init(&buffer->middle, 1);
+    buffer->back = 2;
+
+}
+
+/*
+ * chip8_triple_buffer_publish function
+ * Expects: to be called from the writer thread only, nothing else to be consuming chip_8_object's dirty_rows
+ * Does: Copies the display into the back frame, clears dirty_rows and swaps the back frame into the middle
+ *
+ */
+void chip8_triple_buffer_publish(chip8_triple_buffer *buffer, chip_8 *chip_8_object){
+
+    chip8_frame *frame = &buffer->frames[buffer->back];
+    memcpy(frame->display, chip_8_object->display, sizeof(frame->display));
+    frame->width = chip8_display_width(chip_8_object);
+    frame->height = chip8_display_height(chip_8_object);
+    u64 dirty_rows = chip_8_object->dirty_rows;
+    u64 published_dirty_rows = dirty_rows | buffer->unseen_dirty_rows;
+    frame->dirty_rows = published_dirty_rows;
+    chip_8_object->dirty_rows = 0;
+
+    // Release hands the reader the frame's contents, acquire takes back a frame the reader is done with
+    unsigned int old = atomic_exchange_explicit(&buffer->middle, buffer->back | TRIPLE_BUFFER_FRESH,
+                                                memory_order_acq_rel);
+    buffer->back = old & ~TRIPLE_BUFFER_FRESH;
+
+    // A middle frame still fresh was replaced before the reader saw it so everything it changed has to come along
+    // with later frames, otherwise the reader has taken every frame before this one
+    buffer->unseen_dirty_rows = old & TRIPLE_BUFFER_FRESH ? published_dirty_rows : dirty_rows;
+
+}
+
+/*
+ * chip8_triple_buffer_take function
+ * Expects: to be called from the reader thread only
+ * Does: Swaps the middle frame to the front if it's newer than the front one and returns it, else returns NULL
+ *
+ */
+const chip8_frame *chip8_triple_buffer_take(chip8_triple_buffer *buffer){
+
+    if (!(atomic_load_explicit(&buffer->middle, memory_order_relaxed) & TRIPLE_BUFFER_FRESH)){
+        return NULL;
+    }
+    unsigned int old = atomic_exchange_explicit(&buffer->middle, buffer->front, memory_order_acq_rel);
+    buffer->front = old & ~TRIPLE_BUFFER_FRESH;
+    return &buffer->frames[buffer->front];
+
+}
@@ -0,0 +1,72 @@
+#ifndef chip8_triple_buffer_h
+#define chip8_triple_buffer_h
+#include <stdatomic.h>
+#include "chip_8_core.h"
+
+/*
+ * chip8_frame struct
+ * Expects: N/A
+ * Does: A finished frame's display as the emulation thread published it
+ */
+typedef struct chip8_frame {
+
+    u64 display[2][CHIP8_HIRES_HEIGHT][CHIP8_HIRES_WIDTH / 64];
+
+    // Rows that changed since the last frame the reader took (frames it never saw are folded in)
+    u64 dirty_rows;
+
+    // Size of the display in the resolution it was in
+    int width;
+    int height;
+
+} chip8_frame;
+
+/*
+ * chip8_triple_buffer struct
+ * Expects: N/A
+ * Does: Hands finished frames from one writer thread to one reader thread without either waiting on the other.
+ * The writer fills its back frame and swaps it with the middle one, the reader swaps the middle one with its front
+ * frame when there's a newer one, so the reader always gets the newest frame and the writer never stalls on it
+ */
+typedef struct chip8_triple_buffer {
+
+    chip8_frame frames[3];
+
+    // Index of the middle frame, plus TRIPLE_BUFFER_FRESH while the reader hasn't taken it yet
+    _Alignas(64) atomic_uint middle;
+
+    // Writer's frame being filled and the rows changed since the last frame the reader is known to have taken
+    _Alignas(64) unsigned int back;
+    u64 unseen_dirty_rows;
+
+    // Reader's frame
+    _Alignas(64) unsigned int front;
+
+} chip8_triple_buffer;
+
+/*
+ * chip8_triple_buffer_init function
+ * Expects: buffer to point at writable memory
+ * Does: Starts the buffer with three blank frames and nothing published
+ *
+ */
+void chip8_triple_buffer_init(chip8_triple_buffer *buffer);
+
+/*
+ * chip8_triple_buffer_publish function
+ * Expects: to be called from the writer thread only, nothing else to be consuming chip_8_object's dirty_rows
+ * Does: Copies the display into the back frame, clears dirty_rows and makes it the newest frame, never waits
+ *
+ */
+void chip8_triple_buffer_publish(chip8_triple_buffer *buffer, chip_8 *chip_8_object);
+
+/*
+ * chip8_triple_buffer_take function
+ * Expects: to be called from the reader thread only
+ * Does: Returns the newest frame published since the last call (valid until the next call) or NULL if there
+ * isn't a new one
+ *
+ */
+const chip8_frame *chip8_triple_buffer_take(chip8_triple_buffer *buffer);
+
+#endif /* chip8_triple_buffer_h */
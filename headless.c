@@ -0,0 +1,826 @@
+#include "headless.h"
+#include "chip_8_core.h"
+#include "chip_8_analysis.h"
+#include "chip_8_jit.h"
+#include "chip_8_movie.h"
+#include "chip_8_profiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+/*
+ * rom_image struct
+ * Expects: N/A
+ * Does: A rom read into memory once so every instance of it can be loaded without touching the disk
+ */
+typedef struct rom_image {
+    char *path;
+    u8 *data;
+    size_t size;
+    chip8_mode mode;
+    // Static analysis every instance of the rom shares, NULL without --analysis_cache
+    chip8_analysis *analysis;
+} rom_image;
+
+/*
+ * headless_job struct
+ * Expects: N/A
+ * Does: One emulator instance to run along with the state it finished in
+ */
+typedef struct headless_job {
+
+    // What to run
+    const rom_image *rom;
+    unsigned int seed;
+
+    // How it finished
+    uint64_t executed;
+    u8 V[16];
+    u16 I;
+    u16 PC;
+    u8 delay_register;
+    u8 sound_register;
+    bool hires;
+    uint64_t display_rows[CHIP8_PLANES][CHIP8_HIRES_HEIGHT][2];
+
+    // Exporting was asked for and some (or all) of the frames never got written
+    bool export_failed;
+
+} headless_job;
+
+/*
+ * work_queue struct
+ * Expects: head <= tail
+ * Does: A per worker deque of job indexes, the owner takes from the tail and thieves take from the head
+ */
+typedef struct work_queue {
+    pthread_mutex_t lock;
+    int *job_indexes;
+    int head;
+    int tail;
+} work_queue;
+
+/*
+ * thread_pool struct
+ * Expects: N/A
+ * Does: Everything the workers share
+ */
+typedef struct thread_pool {
+    headless_job *jobs;
+    work_queue *queues;
+    int worker_count;
+} thread_pool;
+
+/*
+ * worker_args struct
+ * Expects: N/A
+ * Does: What each worker thread is started with
+ */
+typedef struct worker_args {
+    thread_pool *pool;
+    int id;
+    uint64_t cycles;
+    bool jit;
+    unsigned int cycles_per_tick;
+    const chip8_export_options *export_options;
+} worker_args;
+
+/*
+ * headless_default_options function
+ * Expects: NA
+ * Does: Returns the options used when the user doesn't override them
+ *
+ */
+headless_options headless_default_options(void){
+    headless_options options;
+    options.jobs = 0;
+    options.seeds = 1;
+    options.cycles = 1000000;
+    options.results_path = "headless_results.txt";
+    options.jit = false;
+    options.cycles_per_tick = CHIP8_DEFAULT_CYCLES_PER_TICK;
+    options.mode = -1;
+    options.export = chip8_export_default_options();
+    options.analysis_cache = NULL;
+    return options;
+}
+
+/*
+ * take_job function
+ * Expects: pool to be filled with queues
+ * Does: Returns the next job index for worker id, stealing from the other workers when its own queue is empty
+ * or -1 when there is no work left anywhere
+ *
+ */
+static int take_job(thread_pool *pool, int id){
+
+    int job_index = -1;
+
+    // Our own queue first, newest job first
+    work_queue *own = &pool->queues[id];
+    pthread_mutex_lock(&own->lock);
+    if (own->tail > own->head){
+        own->tail -= 1;
+        job_index = own->job_indexes[own->tail];
+    }
+    pthread_mutex_unlock(&own->lock);
+    if (job_index >= 0){
+        return job_index;
+    }
+
+    // Otherwise steal the oldest job from whoever still has some
+    for (int i = 1; i < pool->worker_count; i++){
+        work_queue *victim = &pool->queues[(id + i) % pool->worker_count];
+        pthread_mutex_lock(&victim->lock);
+        if (victim->tail > victim->head){
+            job_index = victim->job_indexes[victim->head];
+            victim->head += 1;
+        }
+        pthread_mutex_unlock(&victim->lock);
+        if (job_index >= 0){
+            return job_index;
+        }
+    }
+
+    return -1;
+
+}
+
+/*
+ * open_job_exporter function
+ * Expects: export_options->path to be the export directory, chip_8_object to have the job's rom loaded
+ * Does: Starts exporting the job's frames to export_options->path/rom.ch8_seed.ext, returns NULL if that can't be
+ * written
+ *
+ */
+static chip8_exporter *open_job_exporter(const chip8_export_options *export_options, const headless_job *job,
+                                         const chip_8 *chip_8_object){
+
+    // Named after the rom file (extension and all, a directory can hold game.ch8 and game.xo8) and the seed
+    const char *name = strrchr(job->rom->path, '/');
+    name = name ? name + 1 : job->rom->path;
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s_%u%s", export_options->path, name, job->seed,
+             chip8_export_extension(export_options->format));
+    chip8_export_options job_options = *export_options;
+    job_options.path = path;
+    return chip8_export_open(&job_options, chip_8_object);
+
+}
+
+/*
+ * run_job function
+ * Expects: chip_8_object (and jit if not NULL) to be scratch space owned by the calling worker
+ * Does: Runs one instance from boot (exporting every frame if export_options->path is set) and records the state
+ * it finished in
+ *
+ */
+static void run_job(chip_8 *chip_8_object, chip8_jit *jit, headless_job *job, uint64_t cycles,
+                    unsigned int cycles_per_tick, const chip8_export_options *export_options){
+
+    chip8_init(chip_8_object);
+    chip8_set_mode(chip_8_object, job->rom->mode);
+    chip8_set_cycles_per_tick(chip_8_object, cycles_per_tick);
+    if (jit){
+        chip8_jit_attach(chip_8_object, jit);
+    }
+    chip8_seed_rng(chip_8_object, job->seed);
+    chip8_load_rom_bytes(chip_8_object, job->rom->data, job->rom->size);
+    if (job->rom->analysis){
+        chip8_analysis_attach(chip_8_object, job->rom->analysis);
+    }
+
+    // A job whose frames can't be written still runs so its results are there, run_headless reports the failure
+    chip8_exporter *exporter = export_options->path ? open_job_exporter(export_options, job, chip_8_object) : NULL;
+    job->export_failed = export_options->path && !exporter;
+    if (exporter){
+        // A frame at a time, each a timer tick's worth of instructions like the window runs at -SPEED=1
+        job->executed = 0;
+        while (job->executed < cycles && chip8_is_running(chip_8_object)){
+            uint64_t frame_cycles = cycles - job->executed < cycles_per_tick ? cycles - job->executed : cycles_per_tick;
+            uint64_t executed = chip8_run(chip_8_object, frame_cycles);
+            job->executed += executed;
+            job->export_failed |= chip8_export_frame(exporter, chip_8_object) != 0;
+            if (executed == 0){
+                break;
+            }
+        }
+        job->export_failed |= chip8_export_close(exporter) != 0;
+    }
+    else {
+        job->executed = chip8_run(chip_8_object, cycles);
+    }
+
+    memcpy(job->V, chip_8_object->V, sizeof(job->V));
+    job->I = chip_8_object->I;
+    job->PC = chip_8_object->PC;
+    job->delay_register = chip_8_object->delay_register;
+    job->sound_register = chip_8_object->sound_register;
+
+    // Display rows are already packed with the leftmost pixel as the highest bit
+    job->hires = chip_8_object->hires;
+    memcpy(job->display_rows, chip_8_object->display, sizeof(job->display_rows));
+
+}
+
+/*
+ * worker_main function
+ * Expects: arg to be a worker_args
+ * Does: Keeps taking jobs until there are none left
+ *
+ */
+static void *worker_main(void *arg){
+
+    worker_args *args = (worker_args *)arg;
+    // The chip 8 struct is reused for every job this worker runs
+    chip_8 *chip_8_object = malloc(sizeof(chip_8));
+    if (!chip_8_object){
+        printf("Error: worker %d could not allocate a chip 8\n", args->id);
+        return NULL;
+    }
+
+    // Each worker compiles into its own recompiler, NULL (interpreter) if unsupported
+    chip8_jit *jit = args->jit ? chip8_jit_create() : NULL;
+
+    int job_index;
+    while ((job_index = take_job(args->pool, args->id)) >= 0){
+        run_job(chip_8_object, jit, &args->pool->jobs[job_index], args->cycles, args->cycles_per_tick,
+                args->export_options);
+    }
+
+    chip8_jit_destroy(jit);
+    free(chip_8_object);
+    return NULL;
+
+}
+
+/*
+ * read_rom_image function
+ * Expects: path to point at a rom file, mode to be a chip8_mode or -1 to go by the file extension
+ * Does: Reads the rom into image, returns 0 on success else 1
+ *
+ */
+static int read_rom_image(const char *path, int mode, rom_image *image){
+
+    FILE *rom = fopen(path, "rb");
+    if (!rom) {
+        printf("Failed to open ROM file: %s\n", path);
+        return 1;
+    }
+
+    // Sized for the biggest memory, loading cuts it down to what the mode has room for
+    image->path = strdup(path);
+    image->mode = mode >= 0 ? (chip8_mode)mode : chip8_mode_for_path(path);
+    image->data = malloc(MEMORY_SIZE - rom_start_address);
+    if (!image->path || !image->data){
+        printf("Error: Out of memory reading %s\n", path);
+        free(image->path);
+        free(image->data);
+        fclose(rom);
+        return 1;
+    }
+    image->size = fread(image->data, 1, MEMORY_SIZE - rom_start_address, rom);
+    fclose(rom);
+    image->analysis = NULL;
+    return 0;
+
+}
+
+/*
+ * analyze_roms function
+ * Expects: roms to hold rom_count roms read by read_rom_image
+ * Does: Loads every rom's analysis from cache_dir or builds and caches it, returns 0 on success else 1
+ *
+ */
+static int analyze_roms(rom_image *roms, int rom_count, const char *cache_dir){
+
+    // Built once here before any worker starts, the workers only ever read them
+    chip_8 *chip_8_object = malloc(sizeof(chip_8));
+    if (!chip_8_object){
+        printf("Error: Out of memory for the analysis\n");
+        return 1;
+    }
+    for (int i = 0; i < rom_count; i++){
+        chip8_init(chip_8_object);
+        chip8_set_mode(chip_8_object, roms[i].mode);
+        chip8_load_rom_bytes(chip_8_object, roms[i].data, roms[i].size);
+        roms[i].analysis = chip8_analysis_load_or_build(chip_8_object, cache_dir);
+        if (!roms[i].analysis){
+            printf("Error: Out of memory for the analysis of %s\n", roms[i].path);
+            free(chip_8_object);
+            return 1;
+        }
+    }
+    free(chip_8_object);
+    return 0;
+
+}
+
+/*
+ * compare_paths helper function - collect_roms
+ * Expects: a and b to point at char pointers
+ * Does: Orders paths alphabetically so results files are stable between runs
+ *
+ */
+static int compare_paths(const void *a, const void *b){
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/*
+ * free_paths helper function - collect_roms
+ * Expects: paths to hold count paths from malloc (or be NULL)
+ * Does: Frees every path and the array holding them
+ *
+ */
+static void free_paths(char **paths, int count){
+    for (int i = 0; i < count; i++){
+        free(paths[i]);
+    }
+    free(paths);
+}
+
+/*
+ * collect_roms function
+ * Expects: rom_path to be a rom or a directory of roms
+ * Does: Reads every rom into *roms and returns how many there are (0 on failure)
+ *
+ */
+static int collect_roms(const char *rom_path, int mode, rom_image **roms){
+
+    struct stat info;
+    if (stat(rom_path, &info) != 0){
+        printf("Failed to open ROM file: %s\n", rom_path);
+        return 0;
+    }
+
+    // A single rom
+    if (!S_ISDIR(info.st_mode)){
+        *roms = calloc(1, sizeof(rom_image));
+        if (!*roms){
+            printf("Error: Out of memory reading %s\n", rom_path);
+            return 0;
+        }
+        return read_rom_image(rom_path, mode, *roms) ? 0 : 1;
+    }
+
+    // A directory so gather every .ch8, .sc8 and .xo8 inside of it
+    DIR *directory = opendir(rom_path);
+    if (!directory){
+        printf("Failed to open ROM directory: %s\n", rom_path);
+        return 0;
+    }
+
+    char **paths = NULL;
+    int path_count = 0;
+    struct dirent *entry;
+    while ((entry = readdir(directory)) != NULL){
+        size_t length = strlen(entry->d_name);
+        const char *extension = length >= 4 ? entry->d_name + length - 4 : "";
+        if (strcasecmp(extension, ".ch8") != 0 && strcasecmp(extension, ".sc8") != 0 &&
+            strcasecmp(extension, ".xo8") != 0){
+            continue;
+        }
+        // The old array is still ours (and freed below) if it can't grow
+        char **grown = realloc(paths, (path_count + 1) * sizeof(char *));
+        char *path = grown ? malloc(strlen(rom_path) + length + 2) : NULL;
+        if (grown){
+            paths = grown;
+        }
+        if (!path){
+            printf("Error: Out of memory reading roms from %s\n", rom_path);
+            closedir(directory);
+            free_paths(paths, path_count);
+            return 0;
+        }
+        sprintf(path, "%s/%s", rom_path, entry->d_name);
+        paths[path_count++] = path;
+    }
+    closedir(directory);
+
+    qsort(paths, path_count, sizeof(char *), compare_paths);
+
+    *roms = calloc(path_count > 0 ? path_count : 1, sizeof(rom_image));
+    if (!*roms){
+        printf("Error: Out of memory reading roms from %s\n", rom_path);
+        free_paths(paths, path_count);
+        return 0;
+    }
+    int rom_count = 0;
+    for (int i = 0; i < path_count; i++){
+        if (read_rom_image(paths[i], mode, &(*roms)[rom_count]) == 0){
+            rom_count++;
+        }
+        free(paths[i]);
+    }
+    free(paths);
+
+    if (rom_count == 0){
+        printf("No .ch8, .sc8 or .xo8 roms found in: %s\n", rom_path);
+    }
+    return rom_count;
+
+}
+
+/*
+ * write_results function
+ * Expects: jobs to have all been run
+ * Does: Writes one line per instance with its registers and packed display rows (one word per row for a 64x32
+ * display, two for 128x64 and the second XO-CHIP plane after plane2=), returns 0 on success else 1
+ *
+ */
+static int write_results(const char *results_path, headless_job *jobs, int job_count){
+
+    FILE *results = fopen(results_path, "w");
+    if (!results){
+        printf("Failed to open results file: %s\n", results_path);
+        return 1;
+    }
+
+    for (int i = 0; i < job_count; i++){
+        headless_job *job = &jobs[i];
+        fprintf(results, "rom=%s seed=%u executed=%llu PC=0x%04X I=0x%04X DT=%u ST=%u V=",
+                job->rom->path, job->seed, (unsigned long long)job->executed, job->PC, job->I,
+                job->delay_register, job->sound_register);
+        for (int j = 0; j < 16; j++){
+            fprintf(results, "%02X", job->V[j]);
+        }
+        // CHIP-8 lines stay exactly as they were before the other modes existed
+        int planes = job->rom->mode == CHIP8_MODE_XOCHIP ? 2 : 1;
+        int height = job->hires ? CHIP8_HIRES_HEIGHT : chip_8_screen_height;
+        int words = job->hires ? 2 : 1;
+        for (int plane = 0; plane < planes; plane++){
+            fprintf(results, plane ? " plane2=" : " display=");
+            for (int y = 0; y < height; y++){
+                for (int word = 0; word < words; word++){
+                    fprintf(results, "%s%016llX", y || word ? "," : "",
+                            (unsigned long long)job->display_rows[plane][y][word]);
+                }
+            }
+        }
+        fprintf(results, "\n");
+    }
+
+    fclose(results);
+    return 0;
+
+}
+
+/*
+ * free_roms function
+ * Expects: roms to hold rom_count roms read by read_rom_image (or be NULL)
+ * Does: Frees every rom, its analysis and the array holding them
+ *
+ */
+static void free_roms(rom_image *roms, int rom_count){
+    for (int i = 0; i < rom_count; i++){
+        chip8_analysis_destroy(roms[i].analysis);
+        free(roms[i].path);
+        free(roms[i].data);
+    }
+    free(roms);
+}
+
+/*
+ * destroy_pool function
+ * Expects: pool to have come from create_pool (its worker_count queues all set up)
+ * Does: Frees every queue
+ *
+ */
+static void destroy_pool(thread_pool *pool){
+    for (int i = 0; i < pool->worker_count; i++){
+        pthread_mutex_destroy(&pool->queues[i].lock);
+        free(pool->queues[i].job_indexes);
+    }
+    free(pool->queues);
+    pool->queues = NULL;
+    pool->worker_count = 0;
+}
+
+/*
+ * create_pool function
+ * Expects: jobs to hold job_count jobs, 1 <= worker_count <= job_count
+ * Does: Gives each of worker_count workers a queue and deals the jobs out between them round robin, returns 0 on
+ * success else 1 (after printing why, with nothing left allocated)
+ *
+ */
+static int create_pool(thread_pool *pool, headless_job *jobs, int job_count, int worker_count){
+
+    pool->jobs = jobs;
+    pool->worker_count = 0;
+    pool->queues = calloc(worker_count, sizeof(work_queue));
+    if (!pool->queues){
+        printf("Error: Out of memory for the work queues\n");
+        return 1;
+    }
+    for (int i = 0; i < worker_count; i++){
+        work_queue *queue = &pool->queues[i];
+        queue->job_indexes = malloc(((job_count / worker_count) + 1) * sizeof(int));
+        if (!queue->job_indexes || pthread_mutex_init(&queue->lock, NULL) != 0){
+            printf("Error: Out of memory for the work queues\n");
+            free(queue->job_indexes);
+            queue->job_indexes = NULL;
+            destroy_pool(pool);
+            return 1;
+        }
+        pool->worker_count++;
+    }
+
+    // Stealing evens out whatever imbalance is left
+    for (int i = 0; i < job_count; i++){
+        work_queue *queue = &pool->queues[i % worker_count];
+        queue->job_indexes[queue->tail++] = i;
+    }
+    return 0;
+
+}
+
+/*
+ * run_headless function
+ * Expects: options to be valid and rom_path to be a rom or a directory of .ch8, .sc8 and .xo8 roms
+ * Does: Runs every instance on a work stealing thread pool without a window or audio then writes the
+ * final display and register state of each instance to options->results_path, returns 0 on success else 1 (an instance failing to export counts)
+ *
+ */
+int run_headless(const headless_options *options, const char *rom_path){
+
+    rom_image *roms = NULL;
+    int rom_count = collect_roms(rom_path, options->mode, &roms);
+    if (rom_count == 0){
+        free(roms);
+        return 1;
+    }
+
+    // Each instance exports into its own file in the export directory
+    bool failed = options->export.path && mkdir(options->export.path, 0755) != 0 && errno != EEXIST;
+    if (failed){
+        printf("Error: Can't create export directory %s\n", options->export.path);
+    }
+    // Every rom is analysed once up front and shared by all of its instances
+    if (!failed && options->analysis_cache){
+        failed = analyze_roms(roms, rom_count, options->analysis_cache) != 0;
+    }
+    if (failed){
+        free_roms(roms, rom_count);
+        return 1;
+    }
+
+    // Every rom is run once per seed, job indexes are ints so the batch has to fit in one
+    unsigned int seeds = options->seeds > 0 ? options->seeds : 1;
+    uint64_t total_jobs = (uint64_t)rom_count * seeds;
+    if (total_jobs > INT_MAX){
+        printf("Error: %llu instances is more than one batch can run\n", (unsigned long long)total_jobs);
+        free_roms(roms, rom_count);
+        return 1;
+    }
+    int job_count = (int)total_jobs;
+    headless_job *jobs = calloc(job_count, sizeof(headless_job));
+    if (!jobs){
+        printf("Error: Out of memory for %d instances\n", job_count);
+        free_roms(roms, rom_count);
+        return 1;
+    }
+    for (int i = 0; i < job_count; i++){
+        jobs[i].rom = &roms[i / seeds];
+        jobs[i].seed = i % seeds;
+    }
+
+    // One worker per core unless told otherwise but never more workers than jobs
+    int worker_count = options->jobs > 0 ? options->jobs : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (worker_count < 1){
+        worker_count = 1;
+    }
+    if (worker_count > job_count){
+        worker_count = job_count;
+    }
+
+    thread_pool pool;
+    pthread_t *threads = malloc(worker_count * sizeof(pthread_t));
+    worker_args *args = malloc(worker_count * sizeof(worker_args));
+    if (!threads || !args || create_pool(&pool, jobs, job_count, worker_count)){
+        if (!threads || !args){
+            printf("Error: Out of memory for %d worker threads\n", worker_count);
+        }
+        free(threads);
+        free(args);
+        free(jobs);
+        free_roms(roms, rom_count);
+        return 1;
+    }
+
+    printf("Running %d instance(s) of %d rom(s) on %d thread(s)\n", job_count, rom_count, worker_count);
+
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // Workers steal from every queue so the ones that did start still run every job
+    int started = 0;
+    for (int i = 0; i < worker_count; i++){
+        args[i].pool = &pool;
+        args[i].id = i;
+        args[i].cycles = options->cycles;
+        args[i].jit = options->jit;
+        args[i].cycles_per_tick = options->cycles_per_tick;
+        args[i].export_options = &options->export;
+        if (pthread_create(&threads[started], NULL, worker_main, &args[i]) != 0){
+            printf("Could not start worker thread %d, the others run its jobs\n", i);
+            continue;
+        }
+        started++;
+    }
+    for (int i = 0; i < started; i++){
+        pthread_join(threads[i], NULL);
+    }
+    if (started == 0){
+        printf("Error: Could not start any worker threads\n");
+        destroy_pool(&pool);
+        free(threads);
+        free(args);
+        free(jobs);
+        free_roms(roms, rom_count);
+        return 1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    uint64_t total_executed = 0;
+    for (int i = 0; i < job_count; i++){
+        total_executed += jobs[i].executed;
+    }
+    printf("Executed %llu instructions in %.3f s (%.0f instructions per second)\n",
+           (unsigned long long)total_executed, elapsed, elapsed > 0 ? total_executed / elapsed : 0.0);
+
+    int status = write_results(options->results_path, jobs, job_count);
+    if (status == 0){
+        printf("Results written to %s\n", options->results_path);
+    }
+    if (options->export.path){
+        int export_failures = 0;
+        for (int i = 0; i < job_count; i++){
+            export_failures += jobs[i].export_failed;
+        }
+        if (export_failures){
+            printf("Error: %d instance(s) failed to export their frames to %s\n", export_failures, options->export.path);
+            status = 1;
+        }
+        else {
+            printf("Frames exported to %s\n", options->export.path);
+        }
+    }
+
+    // Clean up
+    destroy_pool(&pool);
+    free(threads);
+    free(args);
+    free(jobs);
+    free_roms(roms, rom_count);
+    return status;
+
+}
+
+/*
+ * run_replay function
+ * Expects: movie_path to be a movie recorded on rom_path
+ * Does: Replays the movie on rom_path without a window, audio or frame cap then prints how fast it ran and the
+ * state it finished in (and a profile written to profiler_path as JSON unless it's NULL, every frame exported as
+ * export_options says unless it's NULL, the rom's analysis cached in analysis_cache unless it's NULL), returns 0 if
+ * that's the state the recording finished in else 1
+ *
+ */
+int run_replay(const char *movie_path, const char *rom_path, bool jit, const char *profiler_path,
+               const chip8_export_options *export_options, const char *analysis_cache){
+
+    // Profiling a replay is the same run every time, ideal for comparing changes
+    chip8_profiler *profiler = NULL;
+    if (profiler_path){
+        profiler = chip8_profiler_create();
+        if (!profiler){
+            printf("Error: -profiler needs the core built with make PROFILER=1\n");
+            return 1;
+        }
+    }
+
+
+    // The movie knows which mode it was recorded in
+    rom_image rom;
+    if (read_rom_image(rom_path, CHIP8_MODE_CHIP8, &rom)){
+        chip8_profiler_destroy(profiler);
+        return 1;
+    }
+    chip8_movie *movie = chip8_movie_open(movie_path);
+    if (!movie){
+        chip8_profiler_destroy(profiler);
+        free(rom.path);
+        free(rom.data);
+        return 1;
+    }
+
+    chip_8 *chip_8_object = malloc(sizeof(chip_8));
+    if (!chip_8_object){
+        printf("Error: Could not allocate a chip 8\n");
+        chip8_movie_close(movie);
+        chip8_profiler_destroy(profiler);
+        free(rom.path);
+        free(rom.data);
+        return 1;
+    }
+    chip8_init(chip_8_object);
+    chip8_jit *recompiler = jit ? chip8_jit_create() : NULL;
+    if (recompiler){
+        chip8_jit_attach(chip_8_object, recompiler);
+    }
+    chip8_profiler_attach(chip_8_object, profiler);
+
+    int status = chip8_movie_start_replay(movie, chip_8_object, rom.data, rom.size);
+
+    // The replay loaded the rom so it can be analysed now
+    chip8_analysis *analysis = NULL;
+    if (status == 0 && analysis_cache){
+        analysis = chip8_analysis_load_or_build(chip_8_object, analysis_cache);
+        status = analysis ? chip8_analysis_attach(chip_8_object, analysis) : 1;
+        if (!analysis){
+            printf("Error: Out of memory for the analysis\n");
+        }
+    }
+
+    // The replay set the mode so the frame size is known now
+    chip8_exporter *exporter = NULL;
+    if (status == 0 && export_options){
+        exporter = chip8_export_open(export_options, chip_8_object);
+        status = exporter ? 0 : 1;
+    }
+
+    if (status == 0){
+        struct timespec start;
+        struct timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        // Exactly what the frontend did each frame while recording, just without waiting for the next one
+        uint64_t executed = 0;
+        u16 keys;
+        uint32_t cycles;
+        while (chip8_is_running(chip_8_object) && chip8_movie_next_frame(movie, &keys, &cycles)){
+            chip8_set_keys(chip_8_object, keys);
+            executed += chip8_run(chip_8_object, cycles);
+            if (exporter){
+                chip8_export_frame(exporter, chip_8_object);
+            }
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+        printf("Replayed %u frames, %llu instructions in %.3f s (%.0f instructions per second)\n",
+               chip8_movie_frames(movie), (unsigned long long)executed, elapsed,
+               elapsed > 0 ? executed / elapsed : 0.0);
+        printf("Finished at PC=0x%04X I=0x%04X DT=%u ST=%u V=", chip_8_object->PC, chip_8_object->I,
+               chip_8_object->delay_register, chip_8_object->sound_register);
+        for (int i = 0; i < 16; i++){
+            printf("%02X", chip_8_object->V[i]);
+        }
+        printf("\n");
+
+        status = chip8_movie_verify(movie, chip_8_object);
+        if (status == 0){
+            printf("Final state matches the recording\n");
+        }
+
+        if (exporter){
+            uint32_t frames = chip8_export_frames_written(exporter);
+            int export_status = chip8_export_close(exporter);
+            exporter = NULL;
+            if (export_status == 0){
+                printf("Exported %u frames to %s\n", frames, export_options->path);
+            }
+            status |= export_status;
+        }
+
+        if (profiler){
+            chip8_profiler_write_report(profiler, chip_8_object, stdout);
+            if (chip8_profiler_write_json(profiler, chip_8_object, profiler_path) == 0){
+                printf("Profile written to %s\n", profiler_path);
+            }
+        }
+    }
+
+    chip8_export_close(exporter);
+    chip8_movie_close(movie);
+    chip8_jit_destroy(recompiler);
+    chip8_profiler_destroy(profiler);
+    free(chip_8_object);
+    chip8_analysis_destroy(analysis);
+    free(rom.path);
+    free(rom.data);
+    return status;
+
+}
@@ -0,0 +1,74 @@
+#ifndef headless_h
+#define headless_h
+#include <stdbool.h>
+#include <stdint.h>
+#include "chip_8_export.h"
+
+/*
+ * headless_options struct
+ * Expects: N/A
+ * Does: Holds how a headless batch run should be carried out
+ */
+typedef struct headless_options {
+
+    // Number of worker threads (0 = one per online core)
+    int jobs;
+
+    // Number of instances (each with its own seed) to run when given a single rom
+    unsigned int seeds;
+
+    // Maximum number of instructions each instance executes
+    uint64_t cycles;
+
+    // File the final state of every instance is written to
+    const char *results_path;
+
+    // Run instances through the recompiler when the host supports it
+    bool jit;
+
+    // Instructions per 60hz timer tick
+    unsigned int cycles_per_tick;
+
+    // Machine to emulate (a chip8_mode), -1 picks it per rom from the file extension
+    int mode;
+
+    // Frames of every instance exported to the directory in export.path (NULL exports nothing), a frame is a
+    // timer tick's worth of instructions
+    chip8_export_options export;
+
+    // Directory every rom's static analysis is cached in (see chip_8_analysis.h), NULL runs without one
+    const char *analysis_cache;
+
+} headless_options;
+
+/*
+ * headless_default_options function
+ * Expects: NA
+ * Does: Returns the options used when the user doesn't override them
+ *
+ */
+headless_options headless_default_options(void);
+
+/*
+ * run_headless function
+ * Expects: options to be valid and rom_path to be a rom or a directory of .ch8, .sc8 and .xo8 roms
+ * Does: Runs every instance on a work stealing thread pool without a window or audio then writes the
+ * final display and register state of each instance to options->results_path (and every frame of each instance to
+ * export.path/rom.ch8_seed.ext when exporting), returns 0 on success else 1 (an instance failing to export counts)
+ *
+ */
+int run_headless(const headless_options *options, const char *rom_path);
+
+/*
+ * run_replay function
+ * Expects: movie_path to be a movie recorded on rom_path
+ * Does: Replays the movie on rom_path without a window, audio or frame cap then prints how fast it ran and the
+ * state it finished in (and a profile written to profiler_path as JSON unless it's NULL, every frame exported as
+ * export_options says unless it's NULL, the rom's analysis cached in analysis_cache unless it's NULL), returns 0 if
+ * that's the state the recording finished in else 1
+ *
+ */
+int run_replay(const char *movie_path, const char *rom_path, bool jit, const char *profiler_path,
+               const chip8_export_options *export_options, const char *analysis_cache);
+
+#endif /* headless_h */
@@ -16,6 +16,18 @@ unsigned long current_ms() {
     return (tv.tv_sec * 1000UL) + (tv.tv_usec / 1000UL);
 }
 
+/*
+ * monotonic_ns function
+ * Expects: NA
+ * Does: Returns CLOCK_MONOTONIC in nanoseconds, only good for measuring how long something took
+ *
+ */
+unsigned long long monotonic_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
 /*
  * pretty_timer function
  * Expects: NA
@@ -42,34 +54,41 @@ void pretty_timer(bool reset) {
 }
 
 /*
- * sleep_for_instruction function
- * Expects: time_per_instruction_ms to be a valid float
- * Does: Accounts for the entire time since it was last called (minus time it slept) and sleeps for a delta
- * time that accounts for variance
+ * sleep_until_next_frame function
+ * Expects: deadline to hold the absolute CLOCK_MONOTONIC time the current frame should end at
+ * Does: Sleeps (once) until deadline then pushes deadline forward by frame_ns. Deadlines are absolute so
+ * oversleeping one frame is made up on the next instead of drifting, and if we've fallen more than a frame
+ * behind the schedule restarts from now rather than racing to catch up. Returns how many ns past the deadline
+ * it woke up (or already was when it had no time left to sleep)
  */
-void sleep_for_instruction(float time_per_instruction_ms) {
-    static struct timespec last_time = {0, 0};
+long sleep_until_next_frame(struct timespec *deadline, long frame_ns) {
     struct timespec now;
     clock_gettime(CLOCK_MONOTONIC, &now);
 
-    if (last_time.tv_sec == 0 && last_time.tv_nsec == 0) {
-        last_time = now;  // first call
-    }
-
-    long elapsed_ns = (now.tv_sec - last_time.tv_sec) * 1000000000L
-                    + (now.tv_nsec - last_time.tv_nsec);
+    long remaining_ns = (deadline->tv_sec - now.tv_sec) * 1000000000L
+                      + (deadline->tv_nsec - now.tv_nsec);
+    long overshoot_ns = -remaining_ns;
 
-    long target_ns = (long)(time_per_instruction_ms * 1000000L);
-    long sleep_ns = target_ns - elapsed_ns;
-
-    if (sleep_ns > 0) {
+    if (remaining_ns > 0) {
         struct timespec ts;
-        ts.tv_sec = sleep_ns / 1000000000L;
-        ts.tv_nsec = sleep_ns % 1000000000L;
+        ts.tv_sec = remaining_ns / 1000000000L;
+        ts.tv_nsec = remaining_ns % 1000000000L;
         nanosleep(&ts, NULL);
+
+        // How late the OS woke us up
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        overshoot_ns = (now.tv_sec - deadline->tv_sec) * 1000000000L + (now.tv_nsec - deadline->tv_nsec);
+    }
+    else if (remaining_ns < -frame_ns) {
+        *deadline = now;
     }
 
-    clock_gettime(CLOCK_MONOTONIC, &last_time);
+    deadline->tv_nsec += frame_ns;
+    if (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec += deadline->tv_nsec / 1000000000L;
+        deadline->tv_nsec %= 1000000000L;
+    }
+    return overshoot_ns;
 
 }
 
@@ -107,51 +126,3 @@ bool time_has_passed(struct timespec *target) {
     return false;
 
 }
-
-/*
- * track_instruction function
- * Expects: NA
- * Does: Counts how many times its called per second and prints that out every second
- * as instructions per second
- *
- */
-int track_instructions() {
-    static int instruction_count = 0;
-    static struct timespec last_time = {0};
-    int temp;
-
-    struct timespec now;
-    clock_gettime(CLOCK_MONOTONIC, &now);
-
-    if (last_time.tv_sec == 0) last_time = now; // init first call
-
-    instruction_count++;
-
-    double elapsed = (now.tv_sec - last_time.tv_sec) +
-                     (now.tv_nsec - last_time.tv_nsec) / 1e9;
-
-    if (elapsed >= 1.0) {
-        printf("Instructions per second: %d\n", instruction_count);
-        temp = instruction_count;
-        instruction_count = 0;
-        last_time = now;
-        return(temp);
-    }
-    return 0;
-
-}
-
-/*
- * millis_since helper function - get_most_recent_input
- * Expects: the start timespec struct to be correctly initialized with a time
- * Does: returns how many milliseconds (int) have passed since the given timespec struct
- *
- */
-int millis_since(struct timespec start) {
-    struct timespec now;
-    clock_gettime(CLOCK_MONOTONIC, &now);
-    long diff_ms = (now.tv_sec - start.tv_sec) * 1000;
-    diff_ms += (now.tv_nsec - start.tv_nsec) / 1000000;
-    return (int)diff_ms;
-
-}
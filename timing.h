@@ -1,6 +1,7 @@
 #ifndef timing_h
 #define timing_h
 #include <sys/time.h>
+#include <time.h>
 #include <stdbool.h>
 #include <stdio.h>
 
@@ -12,6 +13,14 @@
  */
 unsigned long current_ms();
 
+/*
+ * monotonic_ns function
+ * Expects: NA
+ * Does: Returns CLOCK_MONOTONIC in nanoseconds, only good for measuring how long something took
+ *
+ */
+unsigned long long monotonic_ns(void);
+
 /*
  * pretty_timer function
  * Expects: NA
@@ -21,12 +30,14 @@ unsigned long current_ms();
 void pretty_timer(bool reset);
 
 /*
- * sleep_for_instruction function
- * Expects: time_per_instruction_ms to be a valid float
- * Does: Accounts for the entire time since it was last called (minus time it slept) and sleeps for a delta
- * time that accounts for variance
+ * sleep_until_next_frame function
+ * Expects: deadline to hold the absolute CLOCK_MONOTONIC time the current frame should end at
+ * Does: Sleeps (once) until deadline then pushes deadline forward by frame_ns. Deadlines are absolute so
+ * oversleeping one frame is made up on the next instead of drifting, and if we've fallen more than a frame
+ * behind the schedule restarts from now rather than racing to catch up. Returns how many ns past the deadline
+ * it woke up (or already was when it had no time left to sleep)
  */
-void sleep_for_instruction(float time_per_instruction_ms);
+long sleep_until_next_frame(struct timespec *deadline, long frame_ns);
 
 /*
  * make_future_time function
@@ -43,21 +54,4 @@ struct timespec make_future_time(double ms);
  */
 bool time_has_passed(struct timespec *target);
 
-/*
- * track_instruction function
- * Expects: NA
- * Does: Counts how many times its called per second and prints that out every second
- * as instructions per second
- *
- */
-int track_instructions();
-
-/*
- * millis_since helper function - get_most_recent_input
- * Expects: the start timespec struct to be correctly initialized with a time
- * Does: returns how many milliseconds (int) have passed since the given timespec struct
- *
- */
-int millis_since(struct timespec start);
-
 #endif /* timing_h */